@@ -0,0 +1,182 @@
+/**
+ * @file BatchExecutor.hpp
+ * @brief Automatic batching of many small graphs.
+ *
+ * Models over trees or sequences build a differently shaped graph per sample out of tiny operations, so the per-node
+ * overhead (closure call, allocation, kernel launch) dominates. `BatchExecutor` captures the graphs of many samples and
+ * schedules their nodes by depth, the length of the longest path from the leaves. Nodes of the same depth don't depend on
+ * each other, so nodes of one depth produced by the same module and having the same shape are evaluated with one call
+ * of the backend's batched kernel, in forward and in backward.
+ *
+ * Usage:
+ * \code
+ *     NodePtrVector<double> losses;
+ *     {
+ *         ReplayRecordingScope recording;
+ *         for (const auto& tree : dataset) {
+ *             losses.push_back(Encode(tree, params));  // per-sample graphs, shapes differ
+ *         }
+ *     }
+ *     BatchExecutor<double> executor(losses);
+ *     for (...) {
+ *         executor.Forward();   // one kernel call per depth and module
+ *         executor.Backward();  // gradients of the sum of the losses
+ *         ...;                  // update params
+ *     }
+ * \endcode
+ *
+ * Backends opt in by providing `ForwardBatch` and `BackwardBatch` kernels (see IModule.hpp), `MatrixBackend` does so for
+ * `MatMul`. Nodes of other modules, including all modules with params, are evaluated one by one in the same schedule.
+ *
+ * @note Graphs are recorded eagerly once. The executor batches every later evaluation of them, which is where the time
+ * goes when the same samples are visited for many epochs.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <ranges>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Graph.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class BatchExecutor
+     * @brief Evaluates many graphs level by level, grouping nodes into batched kernel calls.
+     *
+     * @tparam T The data type of the nodes. Must satisfy NodeT concept
+     */
+    template <NodeT T>
+    class BatchExecutor {
+     public:
+        explicit BatchExecutor(NodePtrVector<T> roots) : m_graph(std::move(roots)) { Schedule(); }
+
+        /// Recomputes `data` of all non-leaf nodes.
+        auto Forward() -> void {
+            ++Node<T>::replayPass;
+            for (Node<T>* node : m_graph.Nodes()) {
+                node->Unpack();
+            }
+            for (const auto& level : m_levels) {
+                for (const auto& batch : level) {
+                    if (batch.kernels) {
+                        batch.kernels->forward(batch.nodes);
+                        continue;
+                    }
+                    for (Node<T>* node : batch.nodes) {
+                        node->Replay();
+                    }
+                }
+            }
+            for (Node<T>* node : m_graph.Nodes()) {
+                node->stale = false;
+            }
+        }
+
+        /// Resets all gradients and backpropagates the sum of the roots.
+        auto Backward() -> void {
+            for (Node<T>* node : m_graph.Nodes()) {
+                node->Unpack();
+                if (node->requiresGrad) {
+                    node->grad = node->data;
+                    node->grad = 0;
+                }
+            }
+            for (const auto& root : m_graph.Roots()) {
+                if (root->requiresGrad) {
+                    root->grad = 1;
+                }
+            }
+            for (const auto& level : m_levels | std::views::reverse) {
+                for (const auto& batch : level) {
+                    if (batch.kernels) {
+                        if (!batch.gradNodes.empty()) {
+                            batch.kernels->backward(batch.gradNodes);
+                        }
+                        continue;
+                    }
+                    for (Node<T>* node : batch.gradNodes) {
+                        if (node->backwardFn) {
+                            node->backwardFn();
+                        }
+                    }
+                }
+            }
+        }
+
+        /// Number of kernel calls and unbatched nodes evaluated by one `Forward`.
+        [[nodiscard]] auto NumForwardCalls() const -> size_t {
+            size_t calls = 0;
+            for (const auto& level : m_levels) {
+                for (const auto& batch : level) {
+                    calls += batch.kernels ? 1 : batch.nodes.size();
+                }
+            }
+            return calls;
+        }
+
+        [[nodiscard]] auto GetGraph() const noexcept -> const Graph<T>& { return m_graph; }
+
+     private:
+        struct Batch {
+            const BatchKernels<T>* kernels{nullptr};
+            std::vector<Node<T>*> nodes;
+            /// Nodes of the batch that require grad.
+            std::vector<Node<T>*> gradNodes;
+        };
+
+        Graph<T> m_graph;
+        /// Batches of every depth, starting with depth one. Leaves are not scheduled.
+        std::vector<std::vector<Batch>> m_levels;
+
+        auto Schedule() -> void {
+            std::unordered_map<const Node<T>*, size_t> depths;
+            // batches of every depth keyed by kernels and shape, unbatched nodes are collected under `nullptr`
+            std::vector<std::map<std::pair<const BatchKernels<T>*, size_t>, Batch>> levels;
+            for (Node<T>* node : m_graph.Nodes()) {
+                size_t depth = 0;
+                for (const auto& parent : node->parents) {
+                    depth = std::max(depth, depths[parent.get()] + 1);
+                }
+                depths[node] = depth;
+                if (depth == 0) continue;
+
+                if (levels.size() < depth) {
+                    levels.resize(depth);
+                }
+                auto& batch = levels[depth - 1][{node->batchKernels, Shape(node->data)}];
+                batch.kernels = node->batchKernels;
+                batch.nodes.push_back(node);
+                if (node->requiresGrad) {
+                    batch.gradNodes.push_back(node);
+                }
+            }
+
+            for (auto& level : levels) {
+                std::vector<Batch> batches;
+                batches.reserve(level.size());
+                for (auto& [key, batch] : level) {
+                    batches.push_back(std::move(batch));
+                }
+                m_levels.push_back(std::move(batches));
+            }
+        }
+
+        /// Number of elements of sized ranges, zero for other types.
+        [[nodiscard]] static auto Shape(const T& value) -> size_t {
+            if constexpr (std::ranges::sized_range<const T>) {
+                return std::ranges::size(value);
+            } else {
+                return 0;
+            }
+        }
+    };
+
+}  // namespace auto_diff
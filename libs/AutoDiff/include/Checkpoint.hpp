@@ -0,0 +1,429 @@
+/**
+ * @file Checkpoint.hpp
+ * @brief Versioned binary checkpoints of parameters and optimizer state with zero-copy loading.
+ *
+ * Layout of a checkpoint file, integers are little-endian:
+ * \code
+ *     header  64 bytes    magic "ADCKPT\0\0", uint32 version, uint32 number of tensors, uint64 index offset, uint64 index size
+ *     blobs               raw row-major elements of every tensor, each starting at a multiple of 64 bytes
+ *     index               for every tensor: uint32 name length, uint32 element type, uint64 rows, cols, offset, size, name
+ * \endcode
+ *
+ * `SaveCheckpoint` computes the layout first and then writes the blobs in parallel straight from the tensors' memory with
+ * `pwrite`, without a staging buffer. The file is written under a unique temporary name next to `path`, synced and renamed
+ * when complete, and the directory is synced after the rename, so a crash never leaves a truncated checkpoint at `path`
+ * and concurrent saves to the same path don't write into each other's file.
+ *
+ * `Checkpoint::Open` maps the file and reads only the header and the index, so opening doesn't depend on the size of
+ * the model. `View` returns a `MappedTensor` pointing into the mapping, pages are read on first access:
+ * \code
+ *     SaveCheckpoint("model.ckpt", {CheckpointTensor("w", w->data), CheckpointTensor("adam.m", m)});
+ *     auto checkpoint = Checkpoint::Open("model.ckpt");
+ *     MappedTensor<float> table = checkpoint.View<float>("embeddings");  // zero-copy
+ *     checkpoint.Load("w", w->data);                                      // Matrix owns its memory, so it is copied
+ * \endcode
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Float16.hpp"
+#include "MappedTensor.hpp"
+#include "Matrix.hpp"
+
+namespace auto_diff {
+
+    static_assert(std::endian::native == std::endian::little, "Checkpoint: only little-endian hosts are supported");
+
+    /// `INT64` must stay the last value, tags above it are rejected when a checkpoint is opened.
+    enum class ElementType : uint32_t { FLOAT32, FLOAT64, FLOAT16, BFLOAT16, INT8, INT32, INT64 };
+
+    namespace detail {
+
+        template <typename S>
+        struct ElementTypeOf;
+        template <>
+        struct ElementTypeOf<float> : std::integral_constant<ElementType, ElementType::FLOAT32> {};
+        template <>
+        struct ElementTypeOf<double> : std::integral_constant<ElementType, ElementType::FLOAT64> {};
+        template <>
+        struct ElementTypeOf<Float16> : std::integral_constant<ElementType, ElementType::FLOAT16> {};
+        template <>
+        struct ElementTypeOf<BFloat16> : std::integral_constant<ElementType, ElementType::BFLOAT16> {};
+        template <>
+        struct ElementTypeOf<int8_t> : std::integral_constant<ElementType, ElementType::INT8> {};
+        template <>
+        struct ElementTypeOf<int32_t> : std::integral_constant<ElementType, ElementType::INT32> {};
+        template <>
+        struct ElementTypeOf<int64_t> : std::integral_constant<ElementType, ElementType::INT64> {};
+
+        constexpr char CHECKPOINT_MAGIC[8] = {'A', 'D', 'C', 'K', 'P', 'T', '\0', '\0'};
+        constexpr uint32_t CHECKPOINT_VERSION = 1;
+        constexpr size_t CHECKPOINT_ALIGNMENT = 64;
+        /// Unit of work of the parallel writers.
+        constexpr size_t CHECKPOINT_CHUNK_SIZE = size_t{16} << 20;
+
+        [[nodiscard]] constexpr auto ElementSize(ElementType type) -> size_t {
+            switch (type) {
+                case ElementType::INT8:
+                    return 1;
+                case ElementType::FLOAT16:
+                case ElementType::BFLOAT16:
+                    return 2;
+                case ElementType::FLOAT32:
+                case ElementType::INT32:
+                    return 4;
+                case ElementType::FLOAT64:
+                case ElementType::INT64:
+                    return 8;
+            }
+            return 0;
+        }
+
+        struct CheckpointHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t count;
+            uint64_t indexOffset;
+            uint64_t indexSize;
+            uint8_t reserved[32];
+        };
+        static_assert(sizeof(CheckpointHeader) == CHECKPOINT_ALIGNMENT);
+
+        struct CheckpointIndexEntry {
+            uint32_t nameLength;
+            uint32_t type;
+            uint64_t rows;
+            uint64_t cols;
+            uint64_t offset;
+            uint64_t size;
+        };
+        static_assert(sizeof(CheckpointIndexEntry) == 40);
+
+        [[nodiscard]] constexpr auto AlignUp(size_t value) -> size_t {
+            return (value + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+        }
+
+        inline auto WriteAll(int fd, const std::byte* data, size_t size, size_t offset) -> void {
+            for (size_t done = 0; done < size;) {
+                const ssize_t written = ::pwrite(fd, data + done, size - done, static_cast<off_t>(offset + done));
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written < 0) {
+                    throw std::system_error(errno, std::generic_category(), "SaveCheckpoint: write failed");
+                }
+                // no progress would otherwise loop forever
+                if (written == 0) {
+                    throw std::system_error(EIO, std::generic_category(), "SaveCheckpoint: write made no progress");
+                }
+                done += static_cast<size_t>(written);
+            }
+        }
+
+        /// Makes a rename in `directory` durable.
+        inline auto SyncDirectory(const std::filesystem::path& directory) -> void {
+            const std::filesystem::path name = directory.empty() ? std::filesystem::path(".") : directory;
+            const int fd = ::open(name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "SaveCheckpoint: can't open " + name.string());
+            }
+            const int result = ::fsync(fd);
+            const int error = errno;
+            ::close(fd);
+            if (result != 0) {
+                throw std::system_error(error, std::generic_category(), "SaveCheckpoint: fsync of " + name.string() + " failed");
+            }
+        }
+
+    }  // namespace detail
+
+    /// Tensor to be saved. Refers to the memory of the source, which must be alive until `SaveCheckpoint` returns.
+    struct CheckpointTensor {
+        std::string name;
+        ElementType type;
+        size_t rows;
+        size_t cols;
+        std::span<const std::byte> bytes;
+
+        template <typename S>
+        CheckpointTensor(std::string tensorName, const Matrix<S>& matrix)
+            : name(std::move(tensorName)),
+              type(detail::ElementTypeOf<S>::value),
+              rows(matrix.rows),
+              cols(matrix.cols),
+              bytes(std::as_bytes(std::span(matrix.values))) {}
+
+        /// A vector is saved as a single row, e.g. optimizer state.
+        template <typename S>
+        CheckpointTensor(std::string tensorName, const std::vector<S>& vector)
+            : name(std::move(tensorName)),
+              type(detail::ElementTypeOf<S>::value),
+              rows(1),
+              cols(vector.size()),
+              bytes(std::as_bytes(std::span(vector))) {}
+
+        template <typename S>
+        CheckpointTensor(std::string tensorName, const MappedTensor<S>& tensor)
+            : name(std::move(tensorName)),
+              type(detail::ElementTypeOf<S>::value),
+              rows(tensor.Rows()),
+              cols(tensor.Cols()),
+              bytes(rows == 0 ? std::span<const std::byte>() : std::as_bytes(std::span<const S>(tensor.Row(0).data(), rows * cols))) {}
+    };
+
+    /**
+     * @brief Writes `tensors` to `path` with `numThreads` parallel writers.
+     *
+     * @throws std::invalid_argument If names are not unique
+     */
+    inline auto SaveCheckpoint(const std::filesystem::path& path,
+                               const std::vector<CheckpointTensor>& tensors,
+                               size_t numThreads = std::max(1U, std::thread::hardware_concurrency())) -> void {
+        std::vector<size_t> offsets(tensors.size());
+        std::vector<std::byte> index;
+        std::unordered_map<std::string_view, size_t> names;
+        size_t end = sizeof(detail::CheckpointHeader);
+        for (size_t i = 0; i < tensors.size(); ++i) {
+            const CheckpointTensor& tensor = tensors[i];
+            if (!names.emplace(tensor.name, i).second) {
+                throw std::invalid_argument("SaveCheckpoint: duplicate tensor " + tensor.name);
+            }
+            offsets[i] = detail::AlignUp(end);
+            end = offsets[i] + tensor.bytes.size();
+            const detail::CheckpointIndexEntry entry{static_cast<uint32_t>(tensor.name.size()),
+                                                     static_cast<uint32_t>(tensor.type),
+                                                     tensor.rows,
+                                                     tensor.cols,
+                                                     offsets[i],
+                                                     tensor.bytes.size()};
+            const auto* entryBytes = reinterpret_cast<const std::byte*>(&entry);
+            index.insert(index.end(), entryBytes, entryBytes + sizeof(entry));
+            const auto* nameBytes = reinterpret_cast<const std::byte*>(tensor.name.data());
+            index.insert(index.end(), nameBytes, nameBytes + tensor.name.size());
+        }
+        const size_t indexOffset = detail::AlignUp(end);
+
+        detail::CheckpointHeader header{};
+        std::memcpy(header.magic, detail::CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = detail::CHECKPOINT_VERSION;
+        header.count = static_cast<uint32_t>(tensors.size());
+        header.indexOffset = indexOffset;
+        header.indexSize = index.size();
+
+        // in the directory of path, so that the rename doesn't cross file systems
+        std::string temporaryName = path.string() + ".XXXXXX";
+        const int fd = ::mkostemp(temporaryName.data(), O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "SaveCheckpoint: can't create " + temporaryName);
+        }
+        const std::filesystem::path temporary = temporaryName;
+        try {
+            // mkostemp creates the file readable by the owner only
+            if (::fchmod(fd, 0644) != 0) {
+                throw std::system_error(errno, std::generic_category(), "SaveCheckpoint: can't set permissions of " + temporaryName);
+            }
+            if (::ftruncate(fd, static_cast<off_t>(indexOffset + index.size())) != 0) {
+                throw std::system_error(errno, std::generic_category(), "SaveCheckpoint: can't resize " + temporary.string());
+            }
+            // tensors are split into chunks, so that large tensors are written by several threads at once
+            std::vector<std::pair<std::span<const std::byte>, size_t>> chunks;
+            for (size_t i = 0; i < tensors.size(); ++i) {
+                for (size_t begin = 0; begin < tensors[i].bytes.size(); begin += detail::CHECKPOINT_CHUNK_SIZE) {
+                    const size_t size = std::min(detail::CHECKPOINT_CHUNK_SIZE, tensors[i].bytes.size() - begin);
+                    chunks.emplace_back(tensors[i].bytes.subspan(begin, size), offsets[i] + begin);
+                }
+            }
+            std::atomic<size_t> next{0};
+            std::exception_ptr error;
+            std::mutex errorMutex;
+            auto writer = [&]() {
+                for (size_t i = next++; i < chunks.size(); i = next++) {
+                    try {
+                        detail::WriteAll(fd, chunks[i].first.data(), chunks[i].first.size(), chunks[i].second);
+                    } catch (...) {
+                        std::lock_guard lock(errorMutex);
+                        error = std::current_exception();
+                    }
+                }
+            };
+            std::vector<std::thread> threads;
+            for (size_t t = 1; t < std::min(numThreads, chunks.size()); ++t) {
+                threads.emplace_back(writer);
+            }
+            writer();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            detail::WriteAll(fd, index.data(), index.size(), indexOffset);
+            detail::WriteAll(fd, reinterpret_cast<const std::byte*>(&header), sizeof(header), 0);
+            if (::fsync(fd) != 0) {
+                throw std::system_error(errno, std::generic_category(), "SaveCheckpoint: fsync failed");
+            }
+        } catch (...) {
+            ::close(fd);
+            std::filesystem::remove(temporary);
+            throw;
+        }
+        ::close(fd);
+        std::filesystem::rename(temporary, path);
+        // the rename itself is only durable once the directory entry is on disk
+        detail::SyncDirectory(path.parent_path());
+    }
+
+    /**
+     * @class Checkpoint
+     * @brief Mapped checkpoint file.
+     */
+    class Checkpoint {
+     public:
+        struct Entry {
+            ElementType type;
+            size_t rows;
+            size_t cols;
+            size_t offset;
+        };
+
+        /**
+         * @brief Maps the checkpoint at `path` and reads its index.
+         *
+         * @param options Mapping options of the views, read-only by default. A writable mapping writes through to the file.
+         * @throws std::runtime_error If the file is not a checkpoint of a supported version
+         */
+        [[nodiscard]] static auto Open(const std::filesystem::path& path, MappingOptions options = {.writable = false}) -> Checkpoint {
+            options.access = AccessPattern::NORMAL;
+            Checkpoint checkpoint(MappedFile::Open(path, options));
+            checkpoint.ReadIndex(path);
+            return checkpoint;
+        }
+
+        [[nodiscard]] auto Contains(const std::string& name) const -> bool { return m_entries.contains(name); }
+        [[nodiscard]] auto Entries() const noexcept -> const std::unordered_map<std::string, Entry>& { return m_entries; }
+
+        /// Tensor `name` pointing into the mapped file without copying.
+        template <typename S>
+        [[nodiscard]] auto View(const std::string& name) const -> MappedTensor<S> {
+            const Entry& entry = Find<S>(name);
+            return MappedTensor<S>(m_file, entry.offset, entry.rows, entry.cols);
+        }
+
+        /// Copies tensor `name` into `matrix`, which owns its memory.
+        template <typename S>
+        auto Load(const std::string& name, Matrix<S>& matrix) const -> void {
+            const Entry& entry = Find<S>(name);
+            matrix = Matrix<S>(entry.rows, entry.cols);
+            std::memcpy(matrix.values.data(), m_file->Data() + entry.offset, matrix.values.size() * sizeof(S));
+        }
+
+        /// Copies tensor `name` saved from a vector.
+        template <typename S>
+        auto Load(const std::string& name, std::vector<S>& vector) const -> void {
+            const Entry& entry = Find<S>(name);
+            const auto* begin = reinterpret_cast<const S*>(m_file->Data() + entry.offset);
+            vector.assign(begin, begin + entry.rows * entry.cols);
+        }
+
+     private:
+        std::shared_ptr<MappedFile> m_file;
+        std::unordered_map<std::string, Entry> m_entries;
+
+        explicit Checkpoint(std::shared_ptr<MappedFile> file) : m_file(std::move(file)) {}
+
+        auto ReadIndex(const std::filesystem::path& path) -> void {
+            const auto invalid = [&path](const std::string& reason) {
+                return std::runtime_error("Checkpoint: " + path.string() + " " + reason);
+            };
+            detail::CheckpointHeader header{};
+            if (m_file->Size() < sizeof(header)) throw invalid("is too small");
+            std::memcpy(&header, m_file->Data(), sizeof(header));
+            if (std::memcmp(header.magic, detail::CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+                throw invalid("is not a checkpoint");
+            }
+            if (header.version != detail::CHECKPOINT_VERSION) {
+                throw invalid("has unsupported version " + std::to_string(header.version));
+            }
+            if (header.indexOffset > m_file->Size() || header.indexSize > m_file->Size() - header.indexOffset) {
+                throw invalid("has a truncated index");
+            }
+
+            size_t position = header.indexOffset;
+            const size_t indexEnd = header.indexOffset + header.indexSize;
+            // offset and size of the blob of every entry
+            std::vector<std::pair<uint64_t, uint64_t>> blobs;
+            for (uint32_t i = 0; i < header.count; ++i) {
+                detail::CheckpointIndexEntry entry{};
+                if (indexEnd - position < sizeof(entry)) throw invalid("has a truncated index");
+                std::memcpy(&entry, m_file->Data() + position, sizeof(entry));
+                position += sizeof(entry);
+                if (indexEnd - position < entry.nameLength) throw invalid("has a truncated index");
+                std::string name(reinterpret_cast<const char*>(m_file->Data() + position), entry.nameLength);
+                position += entry.nameLength;
+                if (entry.type > static_cast<uint32_t>(ElementType::INT64)) {
+                    throw invalid("has an unknown element type in entry " + name);
+                }
+                const auto type = static_cast<ElementType>(entry.type);
+                const auto elements = detail::CheckedMultiply(entry.rows, entry.cols);
+                const auto size = elements ? detail::CheckedMultiply(*elements, detail::ElementSize(type)) : std::nullopt;
+                if (entry.offset % detail::CHECKPOINT_ALIGNMENT != 0 || entry.offset < sizeof(header) ||
+                    entry.offset > header.indexOffset || entry.size > header.indexOffset - entry.offset || size != entry.size) {
+                    throw invalid("has a corrupted entry " + name);
+                }
+                if (!m_entries.emplace(name, Entry{type, entry.rows, entry.cols, entry.offset}).second) {
+                    throw invalid("has a duplicate entry " + name);
+                }
+                blobs.emplace_back(entry.offset, entry.size);
+            }
+
+            // a blob shared by two entries would alias their views
+            std::sort(blobs.begin(), blobs.end());
+            for (size_t i = 1; i < blobs.size(); ++i) {
+                if (blobs[i].first - blobs[i - 1].first < blobs[i - 1].second) {
+                    throw invalid("has overlapping entries");
+                }
+            }
+        }
+
+        template <typename S>
+        [[nodiscard]] auto Find(const std::string& name) const -> const Entry& {
+            auto it = m_entries.find(name);
+            if (it == m_entries.end()) {
+                throw std::out_of_range("Checkpoint: no tensor " + name);
+            }
+            if (it->second.type != detail::ElementTypeOf<S>::value) {
+                throw std::invalid_argument("Checkpoint: tensor " + name + " has a different element type");
+            }
+            return it->second;
+        }
+    };
+
+}  // namespace auto_diff
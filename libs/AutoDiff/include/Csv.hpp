@@ -0,0 +1,265 @@
+/**
+ * @file Csv.hpp
+ * @brief Fast loading of numeric CSV files into matrices.
+ *
+ * `LoadCsv` maps the file, splits it into one chunk per thread at line boundaries and parses the chunks in parallel
+ * straight into the rows of one contiguous `Matrix<S>`, which can be used as `data` of a leaf node:
+ * 1. every thread counts the records of its chunk, line ends are found with SSE2 16 bytes at a time;
+ * 2. prefix sums of the counts give the first row of every chunk;
+ * 3. every thread parses its records into its rows. Delimiters and line ends are found together with SSE2, one mask per
+ *    16 bytes shared by the fields within them, and every field is parsed with `std::from_chars`, which implements the
+ *    Eisel-Lemire algorithm with exact fallback, so numbers are parsed correctly rounded without locales or streams.
+ *
+ * \code
+ *     Matrix<float> table = LoadCsv<float>("train.csv", {.skipHeader = true});
+ *     auto features = std::make_shared<Node<Matrix<float>>>(std::move(table), false);
+ * \endcode
+ *
+ * Empty lines are skipped, `\r\n` line ends are accepted. The number of columns is taken from the first record.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "MappedTensor.hpp"
+#include "Matrix.hpp"
+
+namespace auto_diff {
+
+    struct CsvOptions {
+        char delimiter{','};
+        bool skipHeader{false};
+        size_t numThreads{std::max(1U, std::thread::hardware_concurrency())};
+    };
+
+    namespace detail {
+
+        /// First occurrence of `byte` in `[begin, end)` or `end`.
+        [[nodiscard]] inline auto FindByte(const char* begin, const char* end, char byte) -> const char* {
+#if defined(__SSE2__)
+            const __m128i pattern = _mm_set1_epi8(byte);
+            for (; end - begin >= 16; begin += 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)));
+                if (mask != 0) {
+                    return begin + std::countr_zero(mask);
+                }
+            }
+#endif
+            for (; begin < end; ++begin) {
+                if (*begin == byte) return begin;
+            }
+            return end;
+        }
+
+        /**
+         * @class SeparatorFinder
+         * @brief Finds delimiters and line feeds with SSE2, 16 bytes at a time.
+         *
+         * The mask of the last block is kept between calls, so the short fields of a record are found with one comparison
+         * per 16 bytes rather than one per field.
+         */
+        class SeparatorFinder {
+         public:
+            SeparatorFinder(const char* end, char delimiter) noexcept : m_end(end), m_delimiter(delimiter) {}
+
+            [[nodiscard]] auto Delimiter() const noexcept -> char { return m_delimiter; }
+
+            /// First delimiter or line feed at or after `position`, or the end.
+            [[nodiscard]] auto Next(const char* position) -> const char* {
+#if defined(__SSE2__)
+                while (true) {
+                    if (m_block == nullptr || position < m_block || position - m_block >= 16) {
+                        if (m_end - position < 16) break;
+                        m_block = position;
+                        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+                        const __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(m_delimiter)),
+                                                             _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+                        m_mask = static_cast<unsigned>(_mm_movemask_epi8(matches));
+                    }
+                    const unsigned remaining = m_mask >> (position - m_block);
+                    if (remaining != 0) {
+                        return position + std::countr_zero(remaining);
+                    }
+                    position = m_block + 16;
+                }
+#endif
+                for (; position < m_end; ++position) {
+                    if (*position == m_delimiter || *position == '\n') return position;
+                }
+                return m_end;
+            }
+
+         private:
+            const char* m_end;
+            char m_delimiter;
+#if defined(__SSE2__)
+            const char* m_block{nullptr};
+            unsigned m_mask{0};
+#endif
+        };
+
+        /// Start of the line after the one containing `position`, or `end`.
+        [[nodiscard]] inline auto NextLine(const char* position, const char* end) -> const char* {
+            const char* newline = FindByte(position, end, '\n');
+            return newline == end ? end : newline + 1;
+        }
+
+        [[nodiscard]] inline auto IsEmptyLine(const char* line) -> bool { return *line == '\n' || *line == '\r'; }
+
+        /**
+         * @brief Parses one record of `cols` numbers starting at `line`.
+         *
+         * Every field is found by `separators` first and then parsed within its bounds, spaces around a number and a `\r`
+         * before the line feed are allowed.
+         *
+         * @return End of the record, its line feed or `end`, or `nullptr` if the record is malformed
+         */
+        template <typename S>
+        [[nodiscard]] auto ParseRecord(const char* line, const char* end, size_t cols, SeparatorFinder& separators, S* out)
+            -> const char* {
+            const char* position = line;
+            for (size_t j = 0; j < cols; ++j) {
+                const char* separator = separators.Next(position);
+                const bool last = j + 1 == cols;
+                if ((separator != end && *separator == separators.Delimiter()) == last) return nullptr;
+                const char* fieldEnd = separator;
+                if (last && fieldEnd != position && fieldEnd[-1] == '\r') {
+                    --fieldEnd;
+                }
+                while (position < fieldEnd && *position == ' ') {
+                    ++position;
+                }
+                while (fieldEnd > position && fieldEnd[-1] == ' ') {
+                    --fieldEnd;
+                }
+                const auto [next, error] = std::from_chars(position, fieldEnd, out[j]);
+                if (error != std::errc() || next != fieldEnd) return nullptr;
+                if (last) return separator;
+                position = separator + 1;
+            }
+            return nullptr;
+        }
+
+        /// Parses one record of `cols` numbers starting at `line`, returns whether it is well-formed.
+        template <typename S>
+        [[nodiscard]] auto ParseRecord(const char* line, const char* end, size_t cols, char delimiter, S* out) -> bool {
+            SeparatorFinder separators(end, delimiter);
+            return ParseRecord(line, end, cols, separators, out) != nullptr;
+        }
+
+        /// Runs `task(i)` for every `i < count` on its own thread, the first exception is rethrown.
+        template <typename Task>
+        auto ParallelFor(size_t count, const Task& task) -> void {
+            std::exception_ptr error;
+            std::mutex errorMutex;
+            auto run = [&](size_t i) {
+                try {
+                    task(i);
+                } catch (...) {
+                    std::lock_guard lock(errorMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            };
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < count; ++i) {
+                threads.emplace_back(run, i);
+            }
+            if (count > 0) {
+                run(0);
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+    }  // namespace detail
+
+    /**
+     * @brief Loads a CSV file of numbers into a row-major matrix, one row per record.
+     *
+     * @throws std::runtime_error If a record is malformed or has a different number of columns
+     */
+    template <typename S>
+    [[nodiscard]] auto LoadCsv(const std::filesystem::path& path, const CsvOptions& options = {}) -> Matrix<S> {
+        auto file = MappedFile::Open(path, {.writable = false, .access = AccessPattern::SEQUENTIAL});
+        const char* begin = reinterpret_cast<const char*>(file->Data());
+        const char* end = begin + file->Size();
+        if (options.skipHeader && begin != end) {
+            begin = detail::NextLine(begin, end);
+        }
+        while (begin != end && detail::IsEmptyLine(begin)) {
+            begin = detail::NextLine(begin, end);
+        }
+        if (begin == end) {
+            return Matrix<S>();
+        }
+        const char* firstLineEnd = detail::FindByte(begin, end, '\n');
+        const size_t cols = static_cast<size_t>(std::count(begin, firstLineEnd, options.delimiter)) + 1;
+
+        // chunks start at line boundaries
+        const size_t numChunks = std::clamp<size_t>(options.numThreads, 1, static_cast<size_t>(end - begin) / 4096 + 1);
+        std::vector<const char*> bounds{begin};
+        for (size_t i = 1; i < numChunks; ++i) {
+            const char* position = begin + static_cast<ptrdiff_t>(static_cast<size_t>(end - begin) * i / numChunks);
+            bounds.push_back(std::max(bounds.back(), detail::NextLine(position - 1, end)));
+        }
+        bounds.push_back(end);
+
+        std::vector<size_t> firstRows(numChunks + 1, 0);
+        detail::ParallelFor(numChunks, [&](size_t chunk) {
+            size_t records = 0;
+            for (const char* line = bounds[chunk]; line < bounds[chunk + 1]; line = detail::NextLine(line, end)) {
+                records += detail::IsEmptyLine(line) ? 0 : 1;
+            }
+            firstRows[chunk + 1] = records;
+        });
+        for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+            firstRows[chunk + 1] += firstRows[chunk];
+        }
+
+        // Matrix keeps its values in a std::vector, which zeroes them here, the threads can only write into allocated rows
+        Matrix<S> matrix(firstRows.back(), cols);
+        detail::ParallelFor(numChunks, [&](size_t chunk) {
+            detail::SeparatorFinder separators(end, options.delimiter);
+            size_t row = firstRows[chunk];
+            for (const char* line = bounds[chunk]; line < bounds[chunk + 1];) {
+                if (detail::IsEmptyLine(line)) {
+                    line = detail::NextLine(line, end);
+                    continue;
+                }
+                // the record ends at its line feed, so the line isn't scanned again for it
+                const char* recordEnd = detail::ParseRecord(line, end, cols, separators, &matrix(row, 0));
+                if (recordEnd == nullptr) {
+                    throw std::runtime_error("LoadCsv: can't parse record " + std::to_string(row) + " of " + path.string());
+                }
+                line = recordEnd == end ? end : recordEnd + 1;
+                ++row;
+            }
+        });
+        return matrix;
+    }
+
+}  // namespace auto_diff
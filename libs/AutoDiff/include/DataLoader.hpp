@@ -0,0 +1,264 @@
+/**
+ * @file DataLoader.hpp
+ * @brief Background loading of record files into batches for leaf nodes.
+ *
+ * A `DataLoader` reads and parses batches on worker threads into a ring of `depth` batch buffers while the training
+ * thread runs `Forward` and `Backward`. `Next` hands the next batch to a leaf node by swapping buffers with the leaf's
+ * `data`: nothing is copied, and the leaf's previous buffer is reused for a later batch, so no memory is allocated in
+ * the steady state. The batch is set with `SetData`, so it is picked up by both `Graph::Forward` and `Recompute`.
+ * \code
+ *     auto source = std::make_shared<BinaryRecordSource<float>>("train.bin", numFeatures);
+ *     DataLoader<float> loader(source, {.batchSize = 256});
+ *     ReplayRecordingScope recording;
+ *     auto input = std::make_shared<Node<Matrix<float>>>(Matrix<float>(), false);
+ *     auto loss = Model(input, ...);
+ *     Graph<Matrix<float>> graph({loss});
+ *     while (loader.Next(*input)) {
+ *         graph.Forward();
+ *         loss->Backward();
+ *         ...
+ *     }
+ * \endcode
+ *
+ * Sources are random access, so workers load different batches in parallel and batches still arrive in file order.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Csv.hpp"
+#include "MappedTensor.hpp"
+#include "Matrix.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class RecordSource
+     * @brief Random access file of records with `Cols()` values each. `Read` is called concurrently.
+     */
+    template <typename S>
+    class RecordSource {
+     public:
+        virtual ~RecordSource() = default;
+        [[nodiscard]] virtual auto NumRecords() const -> size_t = 0;
+        [[nodiscard]] virtual auto Cols() const -> size_t = 0;
+        /// Writes `count` records starting with record `first` to `out`, row-major.
+        virtual auto Read(size_t first, size_t count, S* out) const -> void = 0;
+    };
+
+    /**
+     * @class BinaryRecordSource
+     * @brief File of fixed-size records, each `cols` raw values of type `S`.
+     */
+    template <typename S>
+        requires std::is_trivially_copyable_v<S>
+    class BinaryRecordSource : public RecordSource<S> {
+     public:
+        BinaryRecordSource(const std::filesystem::path& path, size_t cols)
+            : m_file(MappedFile::Open(path, {.writable = false, .access = AccessPattern::SEQUENTIAL})), m_cols(cols) {
+            if (m_cols == 0 || m_file->Size() % (m_cols * sizeof(S)) != 0) {
+                throw std::invalid_argument("BinaryRecordSource: size of " + path.string() + " is not a multiple of the record size");
+            }
+        }
+
+        [[nodiscard]] auto NumRecords() const -> size_t override { return m_file->Size() / (m_cols * sizeof(S)); }
+        [[nodiscard]] auto Cols() const -> size_t override { return m_cols; }
+
+        auto Read(size_t first, size_t count, S* out) const -> void override {
+            std::memcpy(out, m_file->Data() + first * m_cols * sizeof(S), count * m_cols * sizeof(S));
+        }
+
+     private:
+        std::shared_ptr<MappedFile> m_file;
+        size_t m_cols;
+    };
+
+    /**
+     * @class CsvRecordSource
+     * @brief Text file with one record of `cols` delimited numbers per line.
+     *
+     * Line starts are indexed once on construction, records are parsed on `Read`. See Csv.hpp for loading a whole file.
+     */
+    template <typename S>
+    class CsvRecordSource : public RecordSource<S> {
+     public:
+        CsvRecordSource(const std::filesystem::path& path, size_t cols, bool skipHeader = false, char delimiter = ',')
+            : m_file(MappedFile::Open(path, {.writable = false, .access = AccessPattern::SEQUENTIAL})),
+              m_cols(cols),
+              m_delimiter(delimiter) {
+            const char* begin = Text();
+            const char* end = begin + m_file->Size();
+            for (const char* line = begin; line < end; line = detail::NextLine(line, end)) {
+                if (!detail::IsEmptyLine(line)) {
+                    m_lines.push_back(static_cast<size_t>(line - begin));
+                }
+            }
+            if (skipHeader && !m_lines.empty()) {
+                m_lines.erase(m_lines.begin());
+            }
+        }
+
+        [[nodiscard]] auto NumRecords() const -> size_t override { return m_lines.size(); }
+        [[nodiscard]] auto Cols() const -> size_t override { return m_cols; }
+
+        auto Read(size_t first, size_t count, S* out) const -> void override {
+            const char* end = Text() + m_file->Size();
+            for (size_t i = first; i < first + count; ++i, out += m_cols) {
+                if (!detail::ParseRecord(Text() + m_lines[i], end, m_cols, m_delimiter, out)) {
+                    throw std::runtime_error("CsvRecordSource: can't parse record " + std::to_string(i));
+                }
+            }
+        }
+
+     private:
+        std::shared_ptr<MappedFile> m_file;
+        size_t m_cols;
+        char m_delimiter;
+        /// Offsets of the non-empty lines.
+        std::vector<size_t> m_lines;
+
+        [[nodiscard]] auto Text() const -> const char* { return reinterpret_cast<const char*>(m_file->Data()); }
+    };
+
+    struct DataLoaderOptions {
+        size_t batchSize{32};
+        /// Number of batch buffers, at most `depth` batches are loaded ahead of the consumer.
+        size_t depth{4};
+        size_t numWorkers{2};
+        /// Skip the last batch if it has fewer than `batchSize` records.
+        bool dropLast{false};
+    };
+
+    /**
+     * @class DataLoader
+     * @brief One pass over a `RecordSource` in batches of `batchSize x Cols()` matrices, loaded in the background.
+     */
+    template <typename S>
+    class DataLoader {
+     public:
+        DataLoader(std::shared_ptr<const RecordSource<S>> source, DataLoaderOptions options)
+            : m_source(std::move(source)), m_options(options), m_slots(std::max<size_t>(options.depth, 1)) {
+            if (m_options.batchSize == 0) {
+                throw std::invalid_argument("DataLoader: batch size must be positive");
+            }
+            const size_t records = m_source->NumRecords();
+            m_numBatches = m_options.dropLast ? records / m_options.batchSize : (records + m_options.batchSize - 1) / m_options.batchSize;
+            for (auto& slot : m_slots) {
+                slot.batch = Matrix<S>(m_options.batchSize, m_source->Cols());
+            }
+            for (size_t i = 0; i < std::max<size_t>(m_options.numWorkers, 1); ++i) {
+                m_workers.emplace_back([this]() { Work(); });
+            }
+        }
+
+        DataLoader(const DataLoader&) = delete;
+        auto operator=(const DataLoader&) -> DataLoader& = delete;
+
+        ~DataLoader() {
+            {
+                std::lock_guard lock(m_mutex);
+                m_stop = true;
+            }
+            m_changed.notify_all();
+            for (auto& worker : m_workers) {
+                worker.join();
+            }
+        }
+
+        [[nodiscard]] auto NumBatches() const noexcept -> size_t { return m_numBatches; }
+
+        /**
+         * @brief Waits for the next batch and swaps it into `leaf.data` with `SetData`, so dependents become stale.
+         *
+         * A batch that couldn't be read is skipped and `leaf.data` keeps the previous batch.
+         *
+         * @return `false` after the last batch
+         * @throws The exception of the source if the batch couldn't be read
+         */
+        auto Next(Node<Matrix<S>>& leaf) -> bool {
+            std::unique_lock lock(m_mutex);
+            if (m_nextToConsume == m_numBatches) return false;
+            Slot& slot = m_slots[m_nextToConsume % m_slots.size()];
+            m_changed.wait(lock, [&slot]() { return slot.ready; });
+            slot.ready = false;
+            ++m_nextToConsume;
+            const std::exception_ptr error = std::exchange(slot.error, nullptr);
+            Matrix<S> batch;
+            if (!error) {
+                batch = std::exchange(slot.batch, std::move(leaf.data));
+            }
+            lock.unlock();
+            // the slot is free again, a worker may be waiting for it
+            m_changed.notify_all();
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            leaf.SetData(std::move(batch));
+            return true;
+        }
+
+     private:
+        struct Slot {
+            Matrix<S> batch;
+            bool ready{false};
+            std::exception_ptr error;
+        };
+
+        std::shared_ptr<const RecordSource<S>> m_source;
+        DataLoaderOptions m_options;
+        size_t m_numBatches{0};
+        std::vector<Slot> m_slots;
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        size_t m_nextToFill{0};
+        size_t m_nextToConsume{0};
+        bool m_stop{false};
+        std::vector<std::thread> m_workers;
+
+        auto Work() -> void {
+            std::unique_lock lock(m_mutex);
+            while (m_nextToFill < m_numBatches) {
+                const size_t index = m_nextToFill++;
+                // the slot is free once the batch loaded into it `depth` batches earlier has been consumed
+                m_changed.wait(lock, [&]() { return m_stop || index < m_nextToConsume + m_slots.size(); });
+                if (m_stop) return;
+                Slot& slot = m_slots[index % m_slots.size()];
+                lock.unlock();
+
+                const size_t first = index * m_options.batchSize;
+                const size_t count = std::min(m_options.batchSize, m_source->NumRecords() - first);
+                std::exception_ptr error;
+                try {
+                    // the buffer returned by the consumer keeps its capacity, so this doesn't allocate in the steady state
+                    slot.batch.rows = count;
+                    slot.batch.cols = m_source->Cols();
+                    slot.batch.values.resize(count * m_source->Cols());
+                    m_source->Read(first, count, slot.batch.values.data());
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                lock.lock();
+                slot.error = error;
+                slot.ready = true;
+                m_changed.notify_all();
+            }
+        }
+    };
+
+}  // namespace auto_diff
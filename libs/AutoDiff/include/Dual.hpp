@@ -0,0 +1,191 @@
+/**
+ * @file Dual.hpp
+ * @brief Dual numbers and Hessian-vector products computed forward-over-reverse.
+ *
+ * `Dual<S>` carries a value and a tangent (directional derivative). A graph built on `Node<Dual<S>>` runs the usual
+ * backend functions: the forward pass propagates tangents of the data, and since the backward functions are written in
+ * terms of the same arithmetic, the backward pass propagates tangents of the gradients. Seeding the parameter tangents with
+ * `v` and running one backward gives the gradient in `grad.value` and the Hessian-vector product in `grad.tangent`
+ * \f[
+ *     \frac{d}{d\varepsilon} \nabla f(\theta + \varepsilon v) \Big|_{\varepsilon = 0} = H v
+ * \f]
+ * at a constant multiple of the cost of one gradient, without recording a second-order graph.
+ *
+ * Usage:
+ * \code
+ *     ReplayRecordingScope recording;  // `Apply` replays the graph
+ *     auto loss = Model(params);  // graph on Node<Dual<double>> built with the ordinary modules
+ *     HessianVectorProduct<double> hvp(loss, params);
+ *     for (...) {
+ *         std::vector<double> hv = hvp.Apply(direction);  // e.g. inside Newton-CG
+ *     }
+ * \endcode
+ *
+ * @note Backends must use the operators of the data type. Elementary functions are provided as overloads found by
+ * argument-dependent lookup, so backends should call them unqualified (`using std::exp; exp(x)`).
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Graph.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class Dual
+     * @brief Value with a first order tangent, `value + tangent * eps` with `eps^2 = 0`.
+     *
+     * @tparam S The scalar type of the value and the tangent
+     */
+    template <typename S>
+    struct Dual {
+        S value{};
+        S tangent{};
+
+        Dual() = default;
+        // implicit, so that constants (e.g. `grad = 0` or `2.0 * x`) are duals with zero tangent
+        Dual(S v, S dv = S{}) : value(std::move(v)), tangent(std::move(dv)) {}
+
+        auto operator+=(const Dual& other) -> Dual& {
+            value += other.value;
+            tangent += other.tangent;
+            return *this;
+        }
+        auto operator-=(const Dual& other) -> Dual& {
+            value -= other.value;
+            tangent -= other.tangent;
+            return *this;
+        }
+        auto operator*=(const Dual& other) -> Dual& { return *this = *this * other; }
+        auto operator/=(const Dual& other) -> Dual& { return *this = *this / other; }
+
+        friend auto operator+(Dual a, const Dual& b) -> Dual { return a += b; }
+        friend auto operator-(Dual a, const Dual& b) -> Dual { return a -= b; }
+        friend auto operator-(const Dual& a) -> Dual { return {-a.value, -a.tangent}; }
+        friend auto operator*(const Dual& a, const Dual& b) -> Dual {
+            return {a.value * b.value, a.tangent * b.value + a.value * b.tangent};
+        }
+        friend auto operator/(const Dual& a, const Dual& b) -> Dual {
+            return {a.value / b.value, (a.tangent * b.value - a.value * b.tangent) / (b.value * b.value)};
+        }
+
+        // comparisons see only the value, so that branches in backends take the same path as without tangents
+        friend auto operator==(const Dual& a, const Dual& b) -> bool { return a.value == b.value; }
+        friend auto operator<(const Dual& a, const Dual& b) -> bool { return a.value < b.value; }
+        friend auto operator>(const Dual& a, const Dual& b) -> bool { return a.value > b.value; }
+        friend auto operator<=(const Dual& a, const Dual& b) -> bool { return a.value <= b.value; }
+        friend auto operator>=(const Dual& a, const Dual& b) -> bool { return a.value >= b.value; }
+
+        friend auto exp(const Dual& a) -> Dual {
+            using std::exp;
+            S e = exp(a.value);
+            return {e, a.tangent * e};
+        }
+        friend auto log(const Dual& a) -> Dual {
+            using std::log;
+            return {log(a.value), a.tangent / a.value};
+        }
+        friend auto sqrt(const Dual& a) -> Dual {
+            using std::sqrt;
+            S root = sqrt(a.value);
+            return {root, a.tangent / (S{2} * root)};
+        }
+        friend auto sin(const Dual& a) -> Dual {
+            using std::cos, std::sin;
+            return {sin(a.value), a.tangent * cos(a.value)};
+        }
+        friend auto cos(const Dual& a) -> Dual {
+            using std::cos, std::sin;
+            return {cos(a.value), -(a.tangent * sin(a.value))};
+        }
+        friend auto tanh(const Dual& a) -> Dual {
+            using std::tanh;
+            S t = tanh(a.value);
+            return {t, a.tangent * (S{1} - t * t)};
+        }
+        friend auto pow(const Dual& a, const S& exponent) -> Dual {
+            using std::pow;
+            return {pow(a.value, exponent), a.tangent * exponent * pow(a.value, exponent - S{1})};
+        }
+        friend auto abs(const Dual& a) -> Dual { return a.value < S{0} ? -a : a; }
+    };
+
+    /**
+     * @class HessianVectorProduct
+     * @brief Repeated Hessian-vector products of a scalar loss with respect to the parameters.
+     *
+     * The graph is captured once, every `Apply` replays it with new tangents and runs one backward pass. Data values of
+     * the graph are left unchanged, gradients are overwritten.
+     *
+     * @tparam S The scalar type of the loss
+     */
+    template <typename S>
+    class HessianVectorProduct {
+     public:
+        HessianVectorProduct(NodePtr<Dual<S>> loss, NodePtrVector<Dual<S>> params)
+            : m_graph({loss}), m_loss(std::move(loss)), m_params(std::move(params)) {}
+
+        /**
+         * @brief Returns \f$H v\f$.
+         *
+         * @param v Direction, one component per parameter
+         */
+        [[nodiscard]] auto Apply(const std::vector<S>& v) -> std::vector<S> {
+            if (v.size() != m_params.size()) {
+                throw std::invalid_argument("HessianVectorProduct: direction size doesn't match the number of parameters");
+            }
+            for (size_t i = 0; i < m_params.size(); ++i) {
+                m_params[i]->data.tangent = v[i];
+            }
+            m_graph.Forward();
+            for (Node<Dual<S>>* node : m_graph.Nodes()) {
+                if (node->requiresGrad) {
+                    node->grad = 0;
+                }
+            }
+            m_loss->Backward();
+
+            std::vector<S> product;
+            product.reserve(m_params.size());
+            for (const auto& param : m_params) {
+                product.push_back(param->grad.tangent);
+                param->data.tangent = S{};
+            }
+            return product;
+        }
+
+        /// Gradient of the loss computed by the last `Apply`.
+        [[nodiscard]] auto Gradient() const -> std::vector<S> {
+            std::vector<S> gradient;
+            gradient.reserve(m_params.size());
+            for (const auto& param : m_params) {
+                gradient.push_back(param->grad.value);
+            }
+            return gradient;
+        }
+
+     private:
+        Graph<Dual<S>> m_graph;
+        NodePtr<Dual<S>> m_loss;
+        NodePtrVector<Dual<S>> m_params;
+    };
+
+    /**
+     * @brief Computes one Hessian-vector product forward-over-reverse.
+     *
+     * Captures the graph on every call, use `HessianVectorProduct` for repeated products of the same graph.
+     */
+    template <typename S>
+    [[nodiscard]] auto Hvp(const NodePtr<Dual<S>>& loss, const NodePtrVector<Dual<S>>& params, const std::vector<S>& v)
+        -> std::vector<S> {
+        return HessianVectorProduct<S>(loss, params).Apply(v);
+    }
+
+}  // namespace auto_diff
@@ -0,0 +1,111 @@
+/**
+ * @file ElemwiseBackend.hpp
+ * @brief Generic backend for the element-wise modules declared in Modules.hpp.
+ *
+ * The backend is written only in terms of the arithmetic operators of the data type, so the same code serves scalars,
+ * `Lanes` (every operation processes all lanes) and `Dual` (tangents flow through both passes). Tensor types work too if
+ * they provide element-wise operators. Tensor types whose operators broadcast an operand also provide `ReduceBroadcast`,
+ * found by argument-dependent lookup, which sums the gradient of a broadcast operand down to the operand's shape.
+ *
+ * Usage:
+ * \code
+ *     using Batch = Lanes<double, 4>;
+ *     ElemwiseMult<Batch, ElemwiseBackend<Batch>> mult;
+ *     auto c = mult.Forward({a, b})[0];
+ * \endcode
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class ElemwiseBackend
+     * @brief Backend of `ElemwiseAdd`, `ElemwiseSub`, `ElemwiseMult` and `ElemwiseDiv` for types with arithmetic operators.
+     *
+     * Every function takes exactly two inputs.
+     */
+    template <typename T>
+    class ElemwiseBackend {
+     public:
+        static auto ElemwiseAddForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+            outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data + inputs[1]->data));
+        }
+        static auto ElemwiseAddBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+            for (const auto& input : inputs) {
+                if (input->requiresGrad) {
+                    AddGrad(*input, output->grad);
+                }
+            }
+        }
+
+        static auto ElemwiseSubForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+            outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data - inputs[1]->data));
+        }
+        static auto ElemwiseSubBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+            if (inputs[0]->requiresGrad) {
+                AddGrad(*inputs[0], output->grad);
+            }
+            if (inputs[1]->requiresGrad) {
+                SubtractGrad(*inputs[1], output->grad);
+            }
+        }
+
+        static auto ElemwiseMultForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+            outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data * inputs[1]->data));
+        }
+        static auto ElemwiseMultBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx)
+            -> void {
+            if (inputs[0]->requiresGrad) {
+                AddGrad(*inputs[0], output->grad * inputs[1]->data);
+            }
+            if (inputs[1]->requiresGrad) {
+                AddGrad(*inputs[1], output->grad * inputs[0]->data);
+            }
+        }
+
+        static auto ElemwiseDivForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+            outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data / inputs[1]->data));
+        }
+        static auto ElemwiseDivBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+            if (inputs[0]->requiresGrad) {
+                AddGrad(*inputs[0], output->grad / inputs[1]->data);
+            }
+            if (inputs[1]->requiresGrad) {
+                // d(a / b) / db = -(a / b) / b
+                SubtractGrad(*inputs[1], output->grad * output->data / inputs[1]->data);
+            }
+        }
+
+     private:
+        /// Adds `gradient` to the gradient of `input`, summed down to the shape of `input` if it was broadcast.
+        static auto AddGrad(Node<T>& input, const T& gradient) -> void {
+            if constexpr (requires { ReduceBroadcast(gradient, input.data); }) {
+                if (std::optional<T> reduced = ReduceBroadcast(gradient, input.data)) {
+                    input.grad += *reduced;
+                    return;
+                }
+            }
+            input.grad += gradient;
+        }
+
+        /// Subtracts `gradient` from the gradient of `input`, summed down to the shape of `input` if it was broadcast.
+        static auto SubtractGrad(Node<T>& input, const T& gradient) -> void {
+            if constexpr (requires { ReduceBroadcast(gradient, input.data); }) {
+                if (std::optional<T> reduced = ReduceBroadcast(gradient, input.data)) {
+                    input.grad -= *reduced;
+                    return;
+                }
+            }
+            input.grad -= gradient;
+        }
+    };
+
+}  // namespace auto_diff
@@ -0,0 +1,260 @@
+/**
+ * @file FixedPoint.hpp
+ * @brief Defines the FixedPoint module differentiated with the implicit function theorem.
+ *
+ * The module finds \f$z^* = f(z^*, \theta)\f$ by iterating the body module \f$f\f$ without recording a graph. The backward
+ * pass doesn't go through the iterations. By the implicit function theorem the gradient of the parameters is
+ * \f$\bar\theta = w^T \partial f / \partial \theta\f$ where \f$w\f$ solves the adjoint system
+ * \f[
+ *     w = \bar z + \left(\frac{\partial f}{\partial z}\right)^T w,
+ * \f]
+ * so the cost of backward doesn't depend on the number of forward iterations. The system is solved either with the
+ * Neumann series (the adjoint fixed-point iteration) or with BiCGSTAB. Both need only vector-Jacobian products of the
+ * body, the matrix \f$I - \partial f / \partial z\f$ is not symmetric, so conjugate gradient is not applicable.
+ *
+ * Root finding \f$g(z, \theta) = 0\f$ is covered by the body \f$f = z - g\f$.
+ *
+ * Usage:
+ * \code
+ *     FixedPoint<double> equilibrium(std::make_shared<Layer>(), {.tolerance = 1e-10});
+ *     auto z = equilibrium.Forward({z0, weights})[0];
+ *     z->Backward();  // weights->grad is filled, z0->grad is not: the solution doesn't depend on the initial guess
+ * \endcode
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Functional.hpp"
+#include "IModule.hpp"
+#include "Node.hpp"
+#include "VectorSpace.hpp"
+
+namespace auto_diff {
+
+    /// Method solving the adjoint linear system of `FixedPoint`.
+    enum class AdjointSolver {
+        /// Adjoint fixed-point iteration, converges when the forward iteration does
+        NEUMANN,
+        /// Stabilized biconjugate gradient, usually needs much fewer vector-Jacobian products
+        BICGSTAB
+    };
+
+    struct FixedPointOptions {
+        /// Maximum number of forward iterations.
+        size_t maxIterations{1000};
+        /// Forward iterations stop when the maximum change of the state is below this value.
+        double tolerance{1e-10};
+        AdjointSolver adjointSolver{AdjointSolver::BICGSTAB};
+        size_t maxAdjointIterations{1000};
+        /// The adjoint solve stops when the residual is below this value times the norm of the output gradient.
+        double adjointTolerance{1e-10};
+    };
+
+    /**
+     * @class FixedPoint
+     * @brief Module finding a fixed point of a body module, differentiated implicitly.
+     *
+     * @tparam T The data type of the nodes, must form a vector space over `double`
+     *
+     * Inputs are `stateSize` components of the initial guess followed by the parameters. Outputs are the components of
+     * the fixed point. Throws `std::runtime_error` when the forward or the adjoint iterations don't converge or reach
+     * non-finite values.
+     */
+    template <VectorSpaceT T>
+    class FixedPoint : public IModule<T> {
+     public:
+        /**
+         * @param body Module computing the next iterate in its `stateSize` leading outputs from the state and the parameters
+         * @param options Stopping criteria and adjoint method
+         * @param stateSize Number of state inputs, the rest of the inputs are parameters
+         */
+        explicit FixedPoint(std::shared_ptr<IModule<T>> body, FixedPointOptions options = {}, size_t stateSize = 1)
+            : m_solver(std::make_shared<const Solver>(Solver{std::move(body), options, stateSize})) {}
+
+        [[nodiscard]] auto Forward(const std::vector<NodePtr<T>>& inputs) -> std::vector<NodePtr<T>> override {
+            if (inputs.size() < m_solver->stateSize) {
+                throw std::invalid_argument("FixedPoint: number of inputs is less than the state size");
+            }
+            return RecordOpaque<T>(
+                inputs,
+                [solver = m_solver](const NodePtrVector<T>& solveInputs) { return solver->Solve(solveInputs); },
+                [solver = m_solver](const NodePtrVector<T>& solveInputs, const std::vector<T>& solution, std::vector<T> adjoint) {
+                    solver->SolveAdjoint(solveInputs, solution, std::move(adjoint));
+                });
+        }
+
+     private:
+        using State = std::vector<T>;
+
+        /// Solver configuration, shared with the recorded nodes so that they can outlive the module.
+        struct Solver {
+            std::shared_ptr<IModule<T>> body;
+            FixedPointOptions options;
+            size_t stateSize;
+
+            [[nodiscard]] auto Solve(const NodePtrVector<T>& inputs) const -> State {
+                NodePtrVector<T> parameters = MakeLeaves(Values(Parameters(inputs)), false);
+                State z = Values(NodePtrVector<T>(inputs.begin(), inputs.begin() + Offset()));
+                for (size_t iteration = 0; iteration < options.maxIterations; ++iteration) {
+                    NodePtrVector<T> bodyInputs = MakeLeaves(z, false);
+                    bodyInputs.insert(bodyInputs.end(), parameters.begin(), parameters.end());
+                    State next = Evaluate(*body, bodyInputs, stateSize);
+                    const double change = Norm(Combine(1.0, next, -1.0, z));
+                    CheckFinite(change, "FixedPoint: forward iterations diverged");
+                    z = std::move(next);
+                    if (change <= options.tolerance) {
+                        return z;
+                    }
+                }
+                throw std::runtime_error("FixedPoint: forward iterations did not converge");
+            }
+
+            auto SolveAdjoint(const NodePtrVector<T>& inputs, const State& solution, const State& adjoint) const -> void {
+                const std::vector<T> parameterValues = Values(Parameters(inputs));
+                // J^T w at the fixed point, the gradients of the parameters are not needed inside the solver
+                NodePtrVector<T> frozenParameters = MakeLeaves(parameterValues, false);
+                auto transposedJacobianProduct = [&](const State& w) {
+                    NodePtrVector<T> stateLeaves = MakeLeaves(solution, true);
+                    NodePtrVector<T> bodyInputs = stateLeaves;
+                    bodyInputs.insert(bodyInputs.end(), frozenParameters.begin(), frozenParameters.end());
+                    VectorJacobianProduct(*body, bodyInputs, w);
+                    State product;
+                    for (const auto& leaf : stateLeaves) {
+                        product.push_back(leaf->grad);
+                    }
+                    return product;
+                };
+
+                const State w = options.adjointSolver == AdjointSolver::NEUMANN ? SolveNeumann(transposedJacobianProduct, adjoint)
+                                                                                 : SolveBiCgStab(transposedJacobianProduct, adjoint);
+
+                NodePtrVector<T> parameterLeaves = MakeLeaves(parameterValues, true);
+                NodePtrVector<T> bodyInputs = MakeLeaves(solution, false);
+                bodyInputs.insert(bodyInputs.end(), parameterLeaves.begin(), parameterLeaves.end());
+                VectorJacobianProduct(*body, bodyInputs, w);
+                for (size_t i = stateSize; i < inputs.size(); ++i) {
+                    if (inputs[i]->requiresGrad) {
+                        inputs[i]->grad += parameterLeaves[i - stateSize]->grad;
+                    }
+                }
+            }
+
+            /// Iterates `w = b + J^T w`.
+            template <typename Product>
+            [[nodiscard]] auto SolveNeumann(const Product& transposedJacobianProduct, const State& b) const -> State {
+                const double threshold = options.adjointTolerance * Norm(b);
+                State w = b;
+                for (size_t iteration = 0; iteration < options.maxAdjointIterations; ++iteration) {
+                    State next = Combine(1.0, b, 1.0, transposedJacobianProduct(w));
+                    const double change = Norm(Combine(1.0, next, -1.0, w));
+                    CheckFinite(change, "FixedPoint: adjoint iterations diverged");
+                    w = std::move(next);
+                    if (change <= threshold) {
+                        return w;
+                    }
+                }
+                throw std::runtime_error("FixedPoint: adjoint iterations did not converge");
+            }
+
+            /// Solves `(I - J^T) w = b` with BiCGSTAB.
+            template <typename Product>
+            [[nodiscard]] auto SolveBiCgStab(const Product& transposedJacobianProduct, const State& b) const -> State {
+                auto apply = [&](const State& v) { return Combine(1.0, v, -1.0, transposedJacobianProduct(v)); };
+                const double threshold = options.adjointTolerance * Norm(b);
+
+                State w = b;
+                State r = Combine(1.0, b, -1.0, apply(w));
+                double residual = Norm(r);
+                CheckFinite(residual, "FixedPoint: adjoint iterations diverged");
+                if (residual <= threshold) {
+                    return w;
+                }
+                const State shadow = r;
+                State p = r;
+                double rho = Dot(shadow, r);
+                for (size_t iteration = 0; iteration < options.maxAdjointIterations; ++iteration) {
+                    const State v = apply(p);
+                    const double alpha = rho / Dot(shadow, v);
+                    const State s = Combine(1.0, r, -alpha, v);
+                    residual = Norm(s);
+                    CheckFinite(residual, "FixedPoint: adjoint iterations diverged");
+                    if (residual <= threshold) {
+                        return Combine(1.0, w, alpha, p);
+                    }
+                    const State t = apply(s);
+                    const double omega = Dot(t, s) / Dot(t, t);
+                    w = Combine(1.0, Combine(1.0, w, alpha, p), omega, s);
+                    r = Combine(1.0, s, -omega, t);
+                    residual = Norm(r);
+                    CheckFinite(residual, "FixedPoint: adjoint iterations diverged");
+                    if (residual <= threshold) {
+                        return w;
+                    }
+                    const double nextRho = Dot(shadow, r);
+                    const double beta = (nextRho / rho) * (alpha / omega);
+                    rho = nextRho;
+                    p = Combine(1.0, r, beta, Combine(1.0, p, -omega, v));
+                }
+                throw std::runtime_error("FixedPoint: adjoint iterations did not converge");
+            }
+
+            [[nodiscard]] auto Offset() const -> std::ptrdiff_t { return static_cast<std::ptrdiff_t>(stateSize); }
+
+            [[nodiscard]] auto Parameters(const NodePtrVector<T>& inputs) const -> NodePtrVector<T> {
+                return {inputs.begin() + Offset(), inputs.end()};
+            }
+
+            /// Returns `a * x + b * y`.
+            [[nodiscard]] static auto Combine(double a, const State& x, double b, const State& y) -> State {
+                State result;
+                result.reserve(x.size());
+                for (size_t i = 0; i < x.size(); ++i) {
+                    result.push_back(static_cast<T>(a * x[i]) + static_cast<T>(b * y[i]));
+                }
+                return result;
+            }
+
+            [[nodiscard]] static auto Dot(const State& x, const State& y) -> double {
+                // unqualified, so that overloads of tensor types are found by argument-dependent lookup
+                using auto_diff::Dot;
+                double dot = 0;
+                for (size_t i = 0; i < x.size(); ++i) {
+                    dot += Dot(x[i], y[i]);
+                }
+                return dot;
+            }
+
+            /// Maximum norm of the components, NaN when a component is not finite.
+            [[nodiscard]] static auto Norm(const State& x) -> double {
+                double norm = 0;
+                for (const auto& component : x) {
+                    const double componentNorm = MaxNorm(component);
+                    if (!std::isfinite(componentNorm)) {
+                        return std::numeric_limits<double>::quiet_NaN();
+                    }
+                    norm = std::max(norm, componentNorm);
+                }
+                return norm;
+            }
+
+            /// Throws when a norm from `Norm` is NaN, the iterates are no longer finite.
+            static auto CheckFinite(double norm, const char* message) -> void {
+                if (std::isnan(norm)) {
+                    throw std::runtime_error(message);
+                }
+            }
+        };
+
+        std::shared_ptr<const Solver> m_solver;
+    };
+
+}  // namespace auto_diff
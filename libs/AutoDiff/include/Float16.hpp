@@ -0,0 +1,119 @@
+/**
+ * @file Float16.hpp
+ * @brief 16-bit floating point storage types computing in `float`.
+ *
+ * `Float16` (IEEE 754 binary16) and `BFloat16` (the upper half of binary32) store values in two bytes. They convert to
+ * `float` implicitly, so every operation is computed in single precision and rounded to nearest even only when the
+ * result is stored. `Node<Float16>` therefore halves the memory of data and gradients with the existing backends.
+ *
+ * `Float16` has 10 mantissa bits and a maximum of 65504, gradients usually need loss scaling (see `LossScaler`).
+ * `BFloat16` has the range of `float` and 7 mantissa bits.
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+namespace auto_diff {
+
+    namespace detail {
+
+        /// IEEE 754 binary16 with round to nearest even.
+        struct Binary16Format {
+            [[nodiscard]] static auto Encode(float value) noexcept -> uint16_t {
+                constexpr uint32_t INFINITY_BITS = 255U << 23;
+                // smallest float that rounds to infinity in binary16
+                constexpr uint32_t OVERFLOW_BITS = (127U + 16) << 23;
+                // adding this value aligns a subnormal binary16 mantissa with the float mantissa and rounds it
+                constexpr uint32_t DENORMAL_MAGIC_BITS = ((127U - 15) + (23 - 10) + 1) << 23;
+
+                uint32_t bits = std::bit_cast<uint32_t>(value);
+                const uint32_t sign = bits & 0x80000000U;
+                bits ^= sign;
+
+                uint32_t result = 0;
+                if (bits >= OVERFLOW_BITS) {
+                    // infinity stays infinity, NaN becomes a quiet NaN
+                    result = bits > INFINITY_BITS ? 0x7e00U : 0x7c00U;
+                } else if (bits < (113U << 23)) {
+                    // subnormal or zero, rounded by the float addition
+                    const float shifted = std::bit_cast<float>(bits) + std::bit_cast<float>(DENORMAL_MAGIC_BITS);
+                    result = std::bit_cast<uint32_t>(shifted) - DENORMAL_MAGIC_BITS;
+                } else {
+                    const uint32_t mantissaOdd = (bits >> 13) & 1U;
+                    // rebias the exponent and round the 13 dropped bits to nearest even
+                    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffU + mantissaOdd;
+                    result = bits >> 13;
+                }
+                return static_cast<uint16_t>(result | (sign >> 16));
+            }
+
+            [[nodiscard]] static auto Decode(uint16_t value) noexcept -> float {
+                constexpr uint32_t SHIFTED_EXPONENT = 0x7c00U << 13;
+                uint32_t bits = (value & 0x7fffU) << 13;
+                const uint32_t exponent = bits & SHIFTED_EXPONENT;
+                bits += (127U - 15) << 23;
+                if (exponent == SHIFTED_EXPONENT) {
+                    // infinity or NaN
+                    bits += (128U - 16) << 23;
+                } else if (exponent == 0) {
+                    // subnormal, renormalized by the float subtraction
+                    bits += 1U << 23;
+                    bits = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(113U << 23));
+                }
+                return std::bit_cast<float>(bits | (static_cast<uint32_t>(value & 0x8000U) << 16));
+            }
+        };
+
+        /// Brain floating point, the upper 16 bits of binary32 with round to nearest even.
+        struct BFloat16Format {
+            [[nodiscard]] static auto Encode(float value) noexcept -> uint16_t {
+                const uint32_t bits = std::bit_cast<uint32_t>(value);
+                if ((bits & 0x7fffffffU) > 0x7f800000U) {
+                    return static_cast<uint16_t>((bits >> 16) | 0x40U);
+                }
+                return static_cast<uint16_t>((bits + 0x7fffU + ((bits >> 16) & 1U)) >> 16);
+            }
+
+            [[nodiscard]] static auto Decode(uint16_t value) noexcept -> float {
+                return std::bit_cast<float>(static_cast<uint32_t>(value) << 16);
+            }
+        };
+
+    }  // namespace detail
+
+    /**
+     * @class PackedFloat
+     * @brief Two-byte floating point value, converted to `float` for every operation.
+     *
+     * @tparam Format Encoding between `float` and the 16-bit representation
+     */
+    template <typename Format>
+    class PackedFloat {
+     public:
+        PackedFloat() = default;
+        // implicit both ways, so that expressions are evaluated in float and rounded when stored
+        PackedFloat(float value) noexcept : m_bits(Format::Encode(value)) {}
+        operator float() const noexcept { return Format::Decode(m_bits); }
+
+        [[nodiscard]] static auto FromBits(uint16_t bits) noexcept -> PackedFloat {
+            PackedFloat result;
+            result.m_bits = bits;
+            return result;
+        }
+        [[nodiscard]] auto Bits() const noexcept -> uint16_t { return m_bits; }
+
+        auto operator+=(float other) noexcept -> PackedFloat& { return *this = static_cast<float>(*this) + other; }
+        auto operator-=(float other) noexcept -> PackedFloat& { return *this = static_cast<float>(*this) - other; }
+        auto operator*=(float other) noexcept -> PackedFloat& { return *this = static_cast<float>(*this) * other; }
+        auto operator/=(float other) noexcept -> PackedFloat& { return *this = static_cast<float>(*this) / other; }
+
+     private:
+        uint16_t m_bits{0};
+    };
+
+    using Float16 = PackedFloat<detail::Binary16Format>;
+    using BFloat16 = PackedFloat<detail::BFloat16Format>;
+
+}  // namespace auto_diff
@@ -0,0 +1,187 @@
+/**
+ * @file Functional.hpp
+ * @brief Helpers to call modules as pure functions of values.
+ *
+ * Modules that run other modules many times (loops, solvers) don't want every inner call to stay in the user's graph.
+ * These helpers evaluate a module on fresh leaves, so the temporary graph is dropped as soon as the call returns.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "IModule.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @brief Concept for Node data types whose gradients can be accumulated outside of a backend
+     */
+    template <typename T>
+    concept AccumulableT = NodeT<T> && requires(T a, T b) {
+        { a += b };
+    };
+
+    /// Returns a value of the same shape as `like` filled with zeros.
+    template <NodeT T>
+    [[nodiscard]] auto ZerosLike(const T& like) -> T {
+        T zeros = like;
+        zeros = 0;
+        return zeros;
+    }
+
+    /// Creates a leaf node for every value.
+    template <NodeT T>
+    [[nodiscard]] auto MakeLeaves(const std::vector<T>& values, bool requiresGrad) -> NodePtrVector<T> {
+        NodePtrVector<T> leaves;
+        leaves.reserve(values.size());
+        for (const auto& value : values) {
+            leaves.push_back(std::make_shared<Node<T>>(value, requiresGrad));
+        }
+        return leaves;
+    }
+
+    /// Copies `data` of every node.
+    template <NodeT T>
+    [[nodiscard]] auto Values(const NodePtrVector<T>& nodes) -> std::vector<T> {
+        std::vector<T> values;
+        values.reserve(nodes.size());
+        for (const auto& node : nodes) {
+            values.push_back(node->data);
+        }
+        return values;
+    }
+
+    /**
+     * @brief Evaluates `module` and returns the values of its outputs.
+     *
+     * Replay recording is suspended during the call, so no replay closures or `children` links are added, even inside a
+     * `ReplayRecordingScope`. The module still builds its nodes, and backward closures for inputs that require grad, but
+     * they are dropped on return.
+     *
+     * @param module Module to evaluate
+     * @param inputs Input nodes, leaves that don't require grad avoid building backward closures
+     * @param numOutputs Number of leading outputs to return, all outputs if zero
+     */
+    template <NodeT T>
+    [[nodiscard]] auto Evaluate(IModule<T>& module, const NodePtrVector<T>& inputs, size_t numOutputs = 0) -> std::vector<T> {
+        ReplayRecordingScope suspended(false);
+        NodePtrVector<T> outputs = module.Forward(inputs);
+        if (numOutputs != 0) {
+            outputs.resize(numOutputs);
+        }
+        return Values(outputs);
+    }
+
+    /**
+     * @brief Computes the vector-Jacobian product of `module` at `inputs`.
+     *
+     * The module is called on `inputs`, the leading outputs are seeded with `cotangents` and the gradients are propagated
+     * back. Gradients are accumulated into `inputs`, so a leaf can be reused across several calls to sum their products.
+     *
+     * @param module Module to differentiate
+     * @param inputs Leaves that require grad for every input the product is needed for
+     * @param cotangents Gradients of the leading outputs, the rest of the outputs get zero gradient
+     * @return Values of the leading `cotangents.size()` outputs
+     */
+    template <AccumulableT T>
+    auto VectorJacobianProduct(IModule<T>& module, const NodePtrVector<T>& inputs, const std::vector<T>& cotangents) -> std::vector<T> {
+        NodePtrVector<T> outputs = module.Forward(inputs);
+        std::vector<Node<T>*> roots;
+        // inputs passed through as outputs keep their accumulated gradient, outputs returned twice are seeded twice
+        std::unordered_set<Node<T>*> seeded;
+        for (const auto& input : inputs) {
+            seeded.insert(input.get());
+        }
+        for (size_t i = 0; i < cotangents.size(); ++i) {
+            Node<T>* output = outputs[i].get();
+            if (!output->requiresGrad) continue;
+            if (seeded.insert(output).second) {
+                output->grad = cotangents[i];
+                roots.push_back(output);
+            } else {
+                output->grad += cotangents[i];
+            }
+        }
+        Node<T>::Backpropagate(roots);
+        outputs.resize(cotangents.size());
+        return Values(outputs);
+    }
+
+    /**
+     * @brief Records a computation with several outputs as one hidden node.
+     *
+     * The hidden node has `inputs` as parents and every output is its child. Outputs collect their gradients, and
+     * `backward` runs once for the whole computation with all of them, no matter how many outputs received gradients.
+     * This is meant for modules that run other modules internally (loops, solvers).
+     *
+     * @param inputs Inputs of the computation
+     * @param forward Computes output values from the inputs, also used to replay the node
+     * @param backward Accumulates gradients into the inputs given output values and output gradients (zeros for outputs
+     * that didn't receive gradients)
+     */
+    template <AccumulableT T, typename ForwardFn, typename BackwardFn>
+    auto RecordOpaque(const NodePtrVector<T>& inputs, ForwardFn forward, BackwardFn backward) -> NodePtrVector<T> {
+        struct Results {
+            std::vector<T> values;
+            std::vector<std::optional<T>> adjoints;
+        };
+        auto results = std::make_shared<Results>();
+        auto node = std::make_shared<Node<T>>();
+        node->parents = inputs;
+        node->requiresGrad = std::any_of(inputs.begin(), inputs.end(), [](const NodePtr<T>& t) { return t->requiresGrad; });
+        const bool recording = ReplayRecordingScope::IsEnabled();
+        results->values = forward(inputs);
+        if (recording) {
+            node->forwardFn = [results, forward, out = node.get()]() { results->values = forward(out->parents); };
+        }
+        results->adjoints.resize(results->values.size());
+        if (node->requiresGrad) {
+            node->backwardFn = [results, backward, out = node.get()]() {
+                std::vector<T> adjoints;
+                adjoints.reserve(results->values.size());
+                for (size_t i = 0; i < results->values.size(); ++i) {
+                    auto& adjoint = results->adjoints[i];
+                    adjoints.push_back(adjoint ? *std::exchange(adjoint, std::nullopt) : ZerosLike(results->values[i]));
+                }
+                backward(out->parents, results->values, std::move(adjoints));
+            };
+        }
+        if (recording) {
+            for (const auto& input : inputs) {
+                input->AddChild(node);
+            }
+        }
+
+        NodePtrVector<T> outputs;
+        for (size_t i = 0; i < results->values.size(); ++i) {
+            auto output = std::make_shared<Node<T>>(results->values[i], node->requiresGrad);
+            output->parents = {node};
+            if (recording) {
+                output->forwardFn = [results, out = output.get(), i]() { out->data = results->values[i]; };
+                node->AddChild(output);
+            }
+            if (node->requiresGrad) {
+                output->backwardFn = [results, out = output.get(), i]() {
+                    auto& adjoint = results->adjoints[i];
+                    if (adjoint) {
+                        *adjoint += out->grad;
+                    } else {
+                        adjoint = out->grad;
+                    }
+                };
+            }
+            outputs.push_back(std::move(output));
+        }
+        return outputs;
+    }
+
+}  // namespace auto_diff
@@ -0,0 +1,177 @@
+/**
+ * @file Graph.hpp
+ * @brief Captured computational graphs that can be replayed and optimized.
+ *
+ * A `Graph` captures all nodes reachable from the given roots in topological order. After changing `data` of leaves the
+ * graph can be replayed with `Forward`, which recomputes every non-leaf node with its `forwardFn` without adding nodes to
+ * the graph. Modules still run their backend's Forward, which may allocate temporary outputs.
+ *
+ * Graphs must be built inside a `ReplayRecordingScope`, otherwise modules don't record the closures that replay them.
+ *
+ * Usage:
+ * \code
+ *     NodePtr<double> loss;
+ *     {
+ *         ReplayRecordingScope recording;
+ *         loss = ...;                    // build the graph once
+ *     }
+ *     Graph<double> graph({loss});
+ *     graph.FoldConstants({input});      // `input` is fed with new data on every step
+ *     for (...) {
+ *         input->data = NextSample();
+ *         graph.Forward();
+ *         loss->Backward();
+ *     }
+ * \endcode
+ *
+ * When only a few leaves change between evaluations, update them with `Node::SetData` and call `Recompute` instead of
+ * replaying the whole graph.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class Graph
+     * @brief Topologically sorted snapshot of a computational graph.
+     *
+     * @tparam T The data type of the nodes. Must satisfy NodeT concept
+     *
+     * The graph keeps its roots alive, so all captured nodes stay alive while the graph exists.
+     */
+    template <NodeT T>
+    class Graph {
+     public:
+        explicit Graph(NodePtrVector<T> roots) : m_roots(std::move(roots)) { Capture(); }
+
+        /**
+         * @brief Recomputes `data` of all non-leaf nodes in topological order.
+         *
+         * Folded constants (see `FoldConstants`) are leaves and therefore are not recomputed.
+         */
+        auto Forward() -> void {
+            ++Node<T>::replayPass;
+            for (Node<T>* node : m_nodes) {
+                node->Unpack();
+                node->Replay();
+                node->stale = false;
+            }
+        }
+
+        /**
+         * @brief Evaluates subgraphs that can not change between steps once and turns them into leaves.
+         *
+         * A non-leaf node is constant if it doesn't require grad and doesn't depend on any of `variableLeaves`. Such nodes
+         * are evaluated once, then their `forwardFn` and `parents` are dropped, so they are spliced into the graph as leaves
+         * and the subgraphs that produced them can be freed.
+         *
+         * @param variableLeaves Leaves that don't require grad but whose data is changed between steps, e.g. input batches
+         * @return Number of folded nodes
+         */
+        auto FoldConstants(const NodePtrVector<T>& variableLeaves = {}) -> size_t {
+            std::unordered_set<const Node<T>*> variable;
+            for (const auto& leaf : variableLeaves) {
+                variable.insert(leaf.get());
+            }
+
+            std::vector<Node<T>*> folded;
+            ++Node<T>::replayPass;
+            for (Node<T>* node : m_nodes) {
+                bool isVariable = node->requiresGrad || variable.count(node);
+                for (const auto& parent : node->parents) {
+                    isVariable = isVariable || variable.count(parent.get());
+                }
+                if (isVariable) {
+                    variable.insert(node);
+                } else if (!node->parents.empty()) {
+                    node->Replay();
+                    folded.push_back(node);
+                }
+            }
+
+            for (Node<T>* node : folded) {
+                node->forwardFn = nullptr;
+                node->parents.clear();
+            }
+            if (!folded.empty()) {
+                Capture();
+            }
+            return folded.size();
+        }
+
+        /// Captured nodes in topological order, parents appear before their children.
+        [[nodiscard]] auto Nodes() const noexcept -> const std::vector<Node<T>*>& { return m_nodes; }
+
+        [[nodiscard]] auto Roots() const noexcept -> const NodePtrVector<T>& { return m_roots; }
+
+     private:
+        NodePtrVector<T> m_roots;
+        std::vector<Node<T>*> m_nodes;
+
+        /// Iterative DFS, so that deep graphs don't overflow the stack.
+        auto Capture() -> void {
+            m_nodes.clear();
+            std::unordered_set<Node<T>*> visited;
+            std::vector<std::pair<Node<T>*, size_t>> stack;
+            for (const auto& root : m_roots) {
+                if (!visited.insert(root.get()).second) continue;
+                stack.emplace_back(root.get(), 0);
+                while (!stack.empty()) {
+                    auto& [node, nextParent] = stack.back();
+                    if (nextParent < node->parents.size()) {
+                        Node<T>* parent = node->parents[nextParent++].get();
+                        if (visited.insert(parent).second) {
+                            stack.emplace_back(parent, 0);
+                        }
+                    } else {
+                        m_nodes.push_back(node);
+                        stack.pop_back();
+                    }
+                }
+            }
+        }
+    };
+
+    /**
+     * @brief Brings `data` of `root` up to date after some leaves have been changed with `Node::SetData`.
+     *
+     * Only stale nodes are visited and re-executed, in topological order. All ancestors of an up to date node are up to date
+     * too, so the cost is proportional to the changed region of the graph, not to the size of the graph.
+     */
+    template <NodeT T>
+    auto Recompute(const NodePtr<T>& root) -> void {
+        if (!root->stale) return;
+        ++Node<T>::replayPass;
+        std::vector<std::pair<Node<T>*, size_t>> stack;
+        stack.emplace_back(root.get(), 0);
+        while (!stack.empty()) {
+            auto& [node, nextParent] = stack.back();
+            if (nextParent < node->parents.size()) {
+                Node<T>* parent = node->parents[nextParent++].get();
+                if (parent->stale) {
+                    stack.emplace_back(parent, 0);
+                }
+            } else {
+                // a parent shared by several stale children is recomputed once, the first visit clears the flag
+                if (node->stale) {
+                    for (auto& parent : node->parents) {
+                        parent->Unpack();
+                    }
+                    node->Unpack();
+                    node->Replay();
+                }
+                node->stale = false;
+                stack.pop_back();
+            }
+        }
+    }
+
+}  // namespace auto_diff
@@ -0,0 +1,211 @@
+/**
+ * @file HashConsing.hpp
+ * @brief Optional hash-consing (common subexpression elimination) of module calls.
+ *
+ * While a `HashConsingScope` is alive on the current thread, every module defined with `DEFINE_MODULE` or
+ * `DEFINE_MODULE_WITH_PARAMS` looks up its call in a per-module cache before running the backend. The cache is keyed on
+ * the module type (which includes the backend), the module params and the identities of the input nodes. A repeated call
+ * returns the very same output nodes, so the repeated sub-expression is computed once and backpropagated once.
+ *
+ * Usage:
+ * \code
+ *     HashConsingScope scope;
+ *     auto c = add.Forward({a, b})[0];
+ *     auto d = add.Forward({a, b})[0];  // d == c, backend is not called
+ * \endcode
+ *
+ * @note Cache entries only hold weak references, so cached nodes are destroyed as usual. The memory of a node created
+ * with `std::make_shared` is released only with its entry though: expired entries are pruned whenever a cache has doubled
+ * in size since the last pruning, and every cache of the thread is cleared when the outermost scope ends.
+ *
+ * @warning Nodes are identified by address, not by value. Do not modify `data` of the inputs while the scope is active,
+ * otherwise a cached (stale) result may be returned.
+ *
+ * @note Modules whose params are not hashable (no `std::hash` specialization or no `operator==`) are never cached.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @brief Concept for module params that can be part of a hash-consing key
+     */
+    template <typename P>
+    concept HashableParams = requires(const P& a, const P& b) {
+        { std::hash<P>{}(a) } -> std::convertible_to<size_t>;
+        { a == b } -> std::convertible_to<bool>;
+    };
+
+    /**
+     * @brief RAII scope that enables hash-consing of module calls on the current thread.
+     *
+     * Scopes can be nested, the caches are shared by nested scopes and are cleared when the outermost scope ends.
+     */
+    class HashConsingScope {
+     public:
+        using ClearCallbacks = std::list<std::function<void()>>;
+
+        HashConsingScope() noexcept { ++Depth(); }
+        ~HashConsingScope() {
+            if (--Depth() == 0) {
+                for (const auto& clear : Callbacks()) {
+                    clear();
+                }
+            }
+        }
+
+        HashConsingScope(const HashConsingScope&) = delete;
+        auto operator=(const HashConsingScope&) -> HashConsingScope& = delete;
+
+        [[nodiscard]] static auto IsEnabled() noexcept -> bool { return Depth() > 0; }
+
+        /// Calls `clear` whenever the outermost scope of the current thread ends, until `RemoveOnEnd` is called.
+        [[nodiscard]] static auto OnEnd(std::function<void()> clear) -> ClearCallbacks::iterator {
+            return Callbacks().insert(Callbacks().end(), std::move(clear));
+        }
+
+        static auto RemoveOnEnd(ClearCallbacks::iterator callback) -> void { Callbacks().erase(callback); }
+
+     private:
+        /// Callbacks of the caches of the current thread, constructed before and so destroyed after them.
+        [[nodiscard]] static auto Callbacks() -> ClearCallbacks& {
+            thread_local ClearCallbacks callbacks;
+            return callbacks;
+        }
+
+        [[nodiscard]] static auto Depth() noexcept -> size_t& {
+            thread_local size_t depth = 0;
+            return depth;
+        }
+    };
+
+    /**
+     * @brief Cache of module calls keyed on params and input node identities.
+     *
+     * @tparam T Node data type
+     * @tparam Params Module params type, `std::monostate` for modules without params
+     */
+    template <NodeT T, HashableParams Params = std::monostate>
+    class ExpressionCache {
+     public:
+        /// The cache is cleared whenever the outermost `HashConsingScope` of the constructing thread ends.
+        ExpressionCache() : m_onEnd(HashConsingScope::OnEnd([this]() { Clear(); })) {}
+        ~ExpressionCache() { HashConsingScope::RemoveOnEnd(m_onEnd); }
+
+        ExpressionCache(const ExpressionCache&) = delete;
+        auto operator=(const ExpressionCache&) -> ExpressionCache& = delete;
+
+        [[nodiscard]] auto Size() const noexcept -> size_t { return m_entries.size(); }
+
+        /// Returns outputs of a previous call with the same inputs and params if all of them are still alive.
+        [[nodiscard]] auto Find(const NodePtrVector<T>& inputs, const Params& params) -> std::optional<NodePtrVector<T>> {
+            auto [begin, end] = m_entries.equal_range(Hash(inputs, params));
+            for (auto it = begin; it != end;) {
+                if (IsExpired(it->second)) {
+                    it = m_entries.erase(it);
+                    continue;
+                }
+                if (Matches(it->second, inputs, params)) {
+                    NodePtrVector<T> outputs;
+                    outputs.reserve(it->second.outputs.size());
+                    for (const auto& output : it->second.outputs) {
+                        outputs.push_back(output.lock());
+                    }
+                    return outputs;
+                }
+                ++it;
+            }
+            return std::nullopt;
+        }
+
+        /// Adds an entry, pruning expired entries first when the cache has doubled in size since the last pruning.
+        auto Insert(const NodePtrVector<T>& inputs, const Params& params, const NodePtrVector<T>& outputs) -> void {
+            if (m_entries.size() >= m_pruneSize) {
+                std::erase_if(m_entries, [](const auto& entry) { return IsExpired(entry.second); });
+                // keep pruning amortized O(1) when most entries are alive
+                m_pruneSize = std::max(MIN_PRUNE_SIZE, 2 * m_entries.size());
+            }
+            m_entries.emplace(Hash(inputs, params), Entry{{inputs.begin(), inputs.end()}, params, {outputs.begin(), outputs.end()}});
+        }
+
+     private:
+        struct Entry {
+            std::vector<std::weak_ptr<Node<T>>> inputs;
+            Params params;
+            std::vector<std::weak_ptr<Node<T>>> outputs;
+        };
+
+        static constexpr size_t MIN_PRUNE_SIZE = 64;
+
+        std::unordered_multimap<size_t, Entry> m_entries;
+        size_t m_pruneSize{MIN_PRUNE_SIZE};
+        HashConsingScope::ClearCallbacks::iterator m_onEnd;
+
+        auto Clear() -> void {
+            m_entries.clear();
+            m_pruneSize = MIN_PRUNE_SIZE;
+        }
+
+        [[nodiscard]] static auto Hash(const NodePtrVector<T>& inputs, const Params& params) -> size_t {
+            size_t seed = std::hash<Params>{}(params);
+            for (const auto& input : inputs) {
+                // boost::hash_combine
+                seed ^= std::hash<Node<T>*>{}(input.get()) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+
+        [[nodiscard]] static auto IsExpired(const Entry& entry) -> bool {
+            auto expired = [](const std::weak_ptr<Node<T>>& node) { return node.expired(); };
+            return std::any_of(entry.inputs.begin(), entry.inputs.end(), expired) ||
+                   std::any_of(entry.outputs.begin(), entry.outputs.end(), expired);
+        }
+
+        [[nodiscard]] static auto Matches(const Entry& entry, const NodePtrVector<T>& inputs, const Params& params) -> bool {
+            if (entry.inputs.size() != inputs.size() || !(entry.params == params)) return false;
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                if (entry.inputs[i].lock() != inputs[i]) return false;
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief Runs `forward` through the hash-consing cache of `Module` if hash-consing is enabled.
+     *
+     * @tparam Module Module type, every module type has its own cache
+     * @param inputs Module inputs
+     * @param params Module params
+     * @param forward Callable creating the outputs of the module call
+     */
+    template <typename Module, NodeT T, typename Params, typename ForwardFn>
+    auto HashConsedForward(const NodePtrVector<T>& inputs, const Params& params, ForwardFn&& forward) -> NodePtrVector<T> {
+        if constexpr (HashableParams<Params>) {
+            if (HashConsingScope::IsEnabled()) {
+                thread_local ExpressionCache<T, Params> cache;
+                if (auto cached = cache.Find(inputs, params)) {
+                    return *std::move(cached);
+                }
+                NodePtrVector<T> outputs = forward();
+                cache.Insert(inputs, params, outputs);
+                return outputs;
+            }
+        }
+        return forward();
+    }
+
+}  // namespace auto_diff
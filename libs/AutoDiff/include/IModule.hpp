@@ -30,16 +30,33 @@
  *
  * @note In backend's Forward method `std::vector<NodePtr<T>>& outputs` is empty and should be filled during this method
  *
+ * @note Backend's Forward is also used to recompute `data` of the outputs when a captured graph is replayed (see `Graph`),
+ * so it must be a pure function of the inputs' data and params. It runs once per module call and replay pass, its fresh
+ * output nodes are temporary. The replay closures and the `children` links are recorded only inside a
+ * `ReplayRecordingScope`.
+ *
  * @note In backend's Backward method all original inputs are passed, even whose who doesn't require grad, so you should check
  * `requiresGrad` before computing grad
+ *
+ * @note Modules defined with the macros take part in hash-consing, see `HashConsingScope`. Params of modules defined with
+ * `DEFINE_MODULE_WITH_PARAMS` are part of the cache key when they are hashable and equality comparable.
+ *
+ * @note A backend of a `DEFINE_MODULE` module may also provide batched kernels
+ * `static void ModuleNameForwardBatch(const std::vector<Node<T>*>& outputs)` and
+ * `static void ModuleNameBackwardBatch(const std::vector<Node<T>*>& outputs)` that process many single-output nodes of the
+ * module at once, see `MatrixBackend::MatMulForwardBatch`. They are used by `BatchExecutor`. Batched kernels have no
+ * params, so backends of `DEFINE_MODULE_WITH_PARAMS` modules providing them are rejected at compile time.
  */
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <type_traits>
+#include <variant>
 #include <vector>
 
+#include "HashConsing.hpp"
 #include "Node.hpp"
 
 namespace auto_diff {
@@ -51,6 +68,46 @@ namespace auto_diff {
         virtual ~IModule() {}
     };
 
+    /**
+     * @brief Sets `forwardFn` of the outputs of one module call, used by the macros below inside a `ReplayRecordingScope`.
+     *
+     * `forward(inputs, outputs)` runs the backend's Forward, `data` of its outputs is moved into the recorded outputs. The
+     * first output replayed in a pass (see `Node::replayPass`) runs it once for all its siblings. An output replayed twice
+     * in the same pass runs it again.
+     */
+    template <typename T, typename ForwardFn>
+    auto SetReplayForward(const std::vector<NodePtr<T>>& outputs, ForwardFn forward) -> void {
+        struct Call {
+            std::vector<std::weak_ptr<Node<T>>> outputs;
+            std::vector<NodePtr<T>> recomputed;
+            uint64_t pass{0};
+            /// Outputs that have received the data of the last run.
+            std::vector<bool> delivered;
+        };
+        auto call = std::make_shared<Call>();
+        call->outputs.assign(outputs.begin(), outputs.end());
+        call->delivered.assign(outputs.size(), false);
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            outputs[i]->forwardFn = [call, forward, out = outputs[i].get(), i]() {
+                if (call->pass == Node<T>::replayPass && !call->delivered[i]) {
+                    call->delivered[i] = true;
+                    return;
+                }
+                call->recomputed.clear();
+                forward(out->parents, call->recomputed);
+                for (size_t j = 0; j < call->outputs.size(); ++j) {
+                    if (auto sibling = call->outputs[j].lock()) {
+                        sibling->data = std::move(call->recomputed[j]->data);
+                    }
+                }
+                call->recomputed.clear();
+                call->pass = Node<T>::replayPass;
+                call->delivered.assign(call->outputs.size(), false);
+                call->delivered[i] = true;
+            };
+        }
+    }
+
 #define DEFINE_CONCEPT(ModuleName)                                                                                                     \
     template <typename Backend, typename T>                                                                                            \
     concept ModuleName##Backend = requires {                                                                                           \
@@ -75,17 +132,41 @@ namespace auto_diff {
     class ModuleName : public IModule<T> {                                                                                     \
      public:                                                                                                                   \
         [[nodiscard]] auto Forward(const std::vector<NodePtr<T>>& inputs) -> std::vector<NodePtr<T>> override {                \
+            return HashConsedForward<ModuleName>(inputs, std::monostate{}, [&inputs]() { return Record(inputs); });            \
+        }                                                                                                                      \
+                                                                                                                               \
+     private:                                                                                                                  \
+        static auto Record(const std::vector<NodePtr<T>>& inputs) -> std::vector<NodePtr<T>> {                                 \
             std::vector<NodePtr<T>> outputs;                                                                                   \
             const bool requiresGrad = std::any_of(inputs.begin(), inputs.end(), [](NodePtr<T> t) { return t->requiresGrad; }); \
+            const bool recording = ReplayRecordingScope::IsEnabled();                                                          \
             Backend::ModuleName##Forward(inputs, outputs);                                                                     \
             for (size_t i = 0; i < outputs.size(); ++i) {                                                                      \
                 auto output = outputs[i];                                                                                      \
                 output->parents = inputs;                                                                                      \
+                if (recording) {                                                                                               \
+                    for (const auto& input : inputs) {                                                                         \
+                        input->AddChild(output);                                                                               \
+                    }                                                                                                          \
+                }                                                                                                              \
                 output->requiresGrad = requiresGrad;                                                                           \
                 if (requiresGrad) {                                                                                            \
                     output->backwardFn = [inputs, out = output.get(), i]() { Backend::ModuleName##Backward(inputs, out, i); }; \
                 }                                                                                                              \
             }                                                                                                                  \
+            if (recording) {                                                                                                   \
+                SetReplayForward(outputs, &Backend::ModuleName##Forward);                                                      \
+            }                                                                                                                  \
+            if constexpr (requires {                                                                                           \
+                              &Backend::ModuleName##ForwardBatch;                                                              \
+                              &Backend::ModuleName##BackwardBatch;                                                             \
+                          }) {                                                                                                 \
+                static constexpr BatchKernels<T> kernels{&Backend::ModuleName##ForwardBatch,                                   \
+                                                         &Backend::ModuleName##BackwardBatch};                                 \
+                if (outputs.size() == 1) {                                                                                     \
+                    outputs[0]->batchKernels = &kernels;                                                                       \
+                }                                                                                                              \
+            }                                                                                                                  \
             return outputs;                                                                                                    \
         }                                                                                                                      \
     };
@@ -98,12 +179,25 @@ namespace auto_diff {
      public:                                                                                                                   \
         explicit ModuleName(__VA_ARGS__ params) : m_params(params) {}                                                          \
         [[nodiscard]] auto Forward(const std::vector<NodePtr<T>>& inputs) -> std::vector<NodePtr<T>> override {                \
+            return HashConsedForward<ModuleName>(inputs, m_params, [this, &inputs]() { return Record(inputs); });              \
+        }                                                                                                                      \
+                                                                                                                               \
+     private:                                                                                                                  \
+        __VA_ARGS__ m_params;                                                                                                  \
+                                                                                                                               \
+        auto Record(const std::vector<NodePtr<T>>& inputs) const -> std::vector<NodePtr<T>> {                                  \
             std::vector<NodePtr<T>> outputs;                                                                                   \
             const bool requiresGrad = std::any_of(inputs.begin(), inputs.end(), [](NodePtr<T> t) { return t->requiresGrad; }); \
+            const bool recording = ReplayRecordingScope::IsEnabled();                                                          \
             Backend::ModuleName##Forward(inputs, outputs, m_params);                                                           \
             for (size_t i = 0; i < outputs.size(); ++i) {                                                                      \
                 auto output = outputs[i];                                                                                      \
                 output->parents = inputs;                                                                                      \
+                if (recording) {                                                                                               \
+                    for (const auto& input : inputs) {                                                                         \
+                        input->AddChild(output);                                                                               \
+                    }                                                                                                          \
+                }                                                                                                              \
                 output->requiresGrad = requiresGrad;                                                                           \
                 if (requiresGrad) {                                                                                            \
                     output->backwardFn = [inputs, out = output.get(), i, params = m_params]() {                                \
@@ -111,11 +205,15 @@ namespace auto_diff {
                     };                                                                                                         \
                 }                                                                                                              \
             }                                                                                                                  \
+            static_assert(!requires { &Backend::ModuleName##ForwardBatch; },                                                   \
+                          "batched kernels can't take params, BatchExecutor runs modules with params one by one");             \
+            if (recording) {                                                                                                   \
+                SetReplayForward(outputs, [params = m_params](const std::vector<NodePtr<T>>& parents, auto& recomputed) {      \
+                    Backend::ModuleName##Forward(parents, recomputed, params);                                                 \
+                });                                                                                                            \
+            }                                                                                                                  \
             return outputs;                                                                                                    \
         }                                                                                                                      \
-                                                                                                                               \
-     private:                                                                                                                  \
-        __VA_ARGS__ m_params;                                                                                                  \
     };
 
 }  // namespace auto_diff
\ No newline at end of file
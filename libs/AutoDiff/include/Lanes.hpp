@@ -0,0 +1,162 @@
+/**
+ * @file Lanes.hpp
+ * @brief Fixed-width batches of scalars evaluated lane by lane.
+ *
+ * `Lanes<S, N>` holds `N` independent values of the same scalar formula. A graph built on `Node<Lanes<S, N>>` has the
+ * structure of the scalar graph but evaluates `N` instances at once: every operation is a loop over a fixed number of
+ * contiguous, aligned elements that the compiler turns into SIMD instructions. Graph construction, topological sort and
+ * closure calls are paid once per `N` instances.
+ *
+ * Usage:
+ * \code
+ *     using Batch = Lanes<double, 4>;
+ *     ReplayRecordingScope recording;
+ *     auto spot = std::make_shared<Node<Batch>>(), vol = ...;
+ *     auto price = Model(spot, vol);  // the scalar formula, built once
+ *     Graph<Batch> graph({price});
+ *     for (size_t i = 0; i < count; i += Batch::size) {
+ *         spot->data = Batch::Load(spots.data() + i);
+ *         graph.Forward();
+ *         price->Backward();
+ *         spot->grad.Store(deltas.data() + i);
+ *     }
+ * \endcode
+ *
+ * Lanes compose with `Dual`: `Dual<Lanes<double, 4>>` computes four Hessian-vector products per sweep.
+ *
+ * @note Lanes have no ordering. Formulas that branch on values must be written branch-free with `Select`.
+ */
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+
+namespace auto_diff {
+
+    /**
+     * @class Lanes
+     * @brief `N` scalars processed with the same operations.
+     *
+     * @tparam S Arithmetic scalar type
+     * @tparam N Number of lanes, a power of two matching the SIMD width gives the best code. Other counts are aligned to
+     * the next power of two.
+     */
+    template <typename S, size_t N>
+    struct alignas(std::bit_ceil(sizeof(S) * N)) Lanes {
+        static constexpr size_t size = N;
+
+        std::array<S, N> lanes{};
+
+        Lanes() = default;
+        // implicit broadcast, so that constants (e.g. `grad = 0` or `2.0 * x`) work as with scalars
+        Lanes(S value) { lanes.fill(value); }
+
+        [[nodiscard]] static auto Load(const S* values) -> Lanes {
+            Lanes result;
+            for (size_t i = 0; i < N; ++i) {
+                result.lanes[i] = values[i];
+            }
+            return result;
+        }
+
+        auto Store(S* values) const -> void {
+            for (size_t i = 0; i < N; ++i) {
+                values[i] = lanes[i];
+            }
+        }
+
+        [[nodiscard]] auto operator[](size_t i) -> S& { return lanes[i]; }
+        [[nodiscard]] auto operator[](size_t i) const -> const S& { return lanes[i]; }
+
+        // ranges of arithmetic values get MaxNorm and Dot from VectorSpace.hpp
+        [[nodiscard]] auto begin() noexcept { return lanes.begin(); }
+        [[nodiscard]] auto end() noexcept { return lanes.end(); }
+        [[nodiscard]] auto begin() const noexcept { return lanes.begin(); }
+        [[nodiscard]] auto end() const noexcept { return lanes.end(); }
+
+        auto operator+=(const Lanes& other) -> Lanes& {
+            for (size_t i = 0; i < N; ++i) {
+                lanes[i] += other.lanes[i];
+            }
+            return *this;
+        }
+        auto operator-=(const Lanes& other) -> Lanes& {
+            for (size_t i = 0; i < N; ++i) {
+                lanes[i] -= other.lanes[i];
+            }
+            return *this;
+        }
+        auto operator*=(const Lanes& other) -> Lanes& {
+            for (size_t i = 0; i < N; ++i) {
+                lanes[i] *= other.lanes[i];
+            }
+            return *this;
+        }
+        auto operator/=(const Lanes& other) -> Lanes& {
+            for (size_t i = 0; i < N; ++i) {
+                lanes[i] /= other.lanes[i];
+            }
+            return *this;
+        }
+
+        friend auto operator+(Lanes a, const Lanes& b) -> Lanes { return a += b; }
+        friend auto operator-(Lanes a, const Lanes& b) -> Lanes { return a -= b; }
+        friend auto operator*(Lanes a, const Lanes& b) -> Lanes { return a *= b; }
+        friend auto operator/(Lanes a, const Lanes& b) -> Lanes { return a /= b; }
+        friend auto operator-(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return -x; });
+        }
+
+        /// Lane-wise `mask ? a : b` where `mask` is nonzero.
+        friend auto Select(const Lanes& mask, const Lanes& a, const Lanes& b) -> Lanes {
+            Lanes result;
+            for (size_t i = 0; i < N; ++i) {
+                result.lanes[i] = mask.lanes[i] != S{0} ? a.lanes[i] : b.lanes[i];
+            }
+            return result;
+        }
+
+        friend auto exp(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return std::exp(x); });
+        }
+        friend auto log(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return std::log(x); });
+        }
+        friend auto sqrt(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return std::sqrt(x); });
+        }
+        friend auto sin(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return std::sin(x); });
+        }
+        friend auto cos(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return std::cos(x); });
+        }
+        friend auto tanh(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return std::tanh(x); });
+        }
+        friend auto abs(const Lanes& a) -> Lanes {
+            return Map(a, [](S x) { return std::abs(x); });
+        }
+        friend auto pow(const Lanes& a, const Lanes& exponent) -> Lanes {
+            Lanes result;
+            for (size_t i = 0; i < N; ++i) {
+                result.lanes[i] = std::pow(a.lanes[i], exponent.lanes[i]);
+            }
+            return result;
+        }
+
+     private:
+        template <typename F>
+        [[nodiscard]] static auto Map(const Lanes& a, F f) -> Lanes {
+            Lanes result;
+            for (size_t i = 0; i < N; ++i) {
+                result.lanes[i] = f(a.lanes[i]);
+            }
+            return result;
+        }
+    };
+
+}  // namespace auto_diff
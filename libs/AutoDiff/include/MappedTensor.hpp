@@ -0,0 +1,330 @@
+/**
+ * @file MappedTensor.hpp
+ * @brief Out-of-core parameter tables backed by memory-mapped files.
+ *
+ * `MappedTensor<S>` is a row-major table stored in a file and mapped with `mmap`. Mapping is instant, pages are read from
+ * the file only when rows are touched, and the kernel evicts clean pages under memory pressure, so tables larger than the
+ * physical memory can be used. Writes through the shared mapping go back to the file.
+ *
+ * Such tables are typically embeddings: `Embedding` gathers the rows selected by an index matrix into a `Matrix<S>` node,
+ * its backward accumulates the gradient only for the selected rows, and `SparseSgd` applies it in place:
+ * \code
+ *     auto table = std::make_shared<MappedTensor<float>>(MappedTensor<float>::Open("embeddings.bin", numRows, dim));
+ *     Embedding<float> embedding(table);
+ *     auto rows = embedding.Forward({indices})[0];  // indices is an n x 1 matrix of row numbers
+ *     ...->Backward();
+ *     SparseSgd(*table, learningRate);
+ * \endcode
+ *
+ * @note `Node` holds one value type for the whole graph, so the table is a parameter of the `Embedding` module with its
+ * own sparse gradient instead of a leaf node.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "IModule.hpp"
+#include "Matrix.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    namespace detail {
+
+        /// `a * b` or nothing if it doesn't fit in size_t.
+        [[nodiscard]] constexpr auto CheckedMultiply(size_t a, size_t b) -> std::optional<size_t> {
+            if (b != 0 && a > std::numeric_limits<size_t>::max() / b) {
+                return std::nullopt;
+            }
+            return a * b;
+        }
+
+    }  // namespace detail
+
+    /// Expected order of page accesses, passed to `madvise`.
+    enum class AccessPattern {
+        NORMAL,
+        /// Read-ahead is disabled, e.g. for embedding lookups
+        RANDOM,
+        SEQUENTIAL
+    };
+
+    struct MappingOptions {
+        bool writable{true};
+        AccessPattern access{AccessPattern::RANDOM};
+        /// Asks for transparent huge pages, ignored where the kernel or the file system doesn't support them.
+        bool hugePages{false};
+    };
+
+    /**
+     * @class MappedFile
+     * @brief Whole file mapped shared into memory.
+     */
+    class MappedFile {
+     public:
+        /// Creates or truncates the file and maps `size` zero bytes.
+        [[nodiscard]] static auto Create(const std::filesystem::path& path, size_t size, MappingOptions options = {})
+            -> std::shared_ptr<MappedFile> {
+            options.writable = true;
+            const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "MappedFile: can't create " + path.string());
+            }
+            if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "MappedFile: can't resize " + path.string());
+            }
+            return std::shared_ptr<MappedFile>(new MappedFile(fd, size, options, path));
+        }
+
+        [[nodiscard]] static auto Open(const std::filesystem::path& path, MappingOptions options = {}) -> std::shared_ptr<MappedFile> {
+            const int fd = ::open(path.c_str(), (options.writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "MappedFile: can't open " + path.string());
+            }
+            struct stat status {};
+            if (::fstat(fd, &status) != 0) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "MappedFile: can't stat " + path.string());
+            }
+            return std::shared_ptr<MappedFile>(new MappedFile(fd, static_cast<size_t>(status.st_size), options, path));
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+        ~MappedFile() {
+            if (m_data != nullptr) {
+                ::munmap(m_data, m_size);
+            }
+            ::close(m_fd);
+        }
+
+        [[nodiscard]] auto Data() const noexcept -> std::byte* { return static_cast<std::byte*>(m_data); }
+        [[nodiscard]] auto Size() const noexcept -> size_t { return m_size; }
+        [[nodiscard]] auto Writable() const noexcept -> bool { return m_writable; }
+
+        /// Writes the modified pages back to the file and waits for completion.
+        auto Flush() const -> void {
+            if (m_data != nullptr && m_writable && ::msync(m_data, m_size, MS_SYNC) != 0) {
+                throw std::system_error(errno, std::generic_category(), "MappedFile: msync failed");
+            }
+        }
+
+     private:
+        int m_fd;
+        size_t m_size;
+        bool m_writable;
+        void* m_data{nullptr};
+
+        MappedFile(int fd, size_t size, const MappingOptions& options, const std::filesystem::path& path)
+            : m_fd(fd), m_size(size), m_writable(options.writable) {
+            if (m_size == 0) return;
+            const int protection = PROT_READ | (m_writable ? PROT_WRITE : 0);
+            m_data = ::mmap(nullptr, m_size, protection, MAP_SHARED, m_fd, 0);
+            if (m_data == MAP_FAILED) {
+                const int error = errno;
+                ::close(m_fd);
+                throw std::system_error(error, std::generic_category(), "MappedFile: can't map " + path.string());
+            }
+            // hints only, failures are ignored
+            const int advice = options.access == AccessPattern::RANDOM       ? MADV_RANDOM
+                               : options.access == AccessPattern::SEQUENTIAL ? MADV_SEQUENTIAL
+                                                                             : MADV_NORMAL;
+            ::madvise(m_data, m_size, advice);
+#ifdef MADV_HUGEPAGE
+            if (options.hugePages) {
+                ::madvise(m_data, m_size, MADV_HUGEPAGE);
+            }
+#endif
+        }
+    };
+
+    /**
+     * @class MappedTensor
+     * @brief Row-major `rows x cols` view of a mapped file with a sparse gradient of the touched rows.
+     *
+     * Copies share the mapping, but every copy has its own sparse gradient.
+     *
+     * @tparam S Trivially copyable element type
+     */
+    template <typename S>
+        requires std::is_trivially_copyable_v<S>
+    class MappedTensor {
+     public:
+        /// Gradient rows accumulated since the last `ZeroGrad`, by row number.
+        using SparseGrad = std::unordered_map<size_t, std::vector<S>>;
+
+        /// View of `rows x cols` elements of `file` starting at byte `offset`.
+        MappedTensor(std::shared_ptr<MappedFile> file, size_t offset, size_t rows, size_t cols)
+            : m_file(std::move(file)), m_offset(offset), m_rows(rows), m_cols(cols) {
+            if (m_offset % alignof(S) != 0) {
+                throw std::invalid_argument("MappedTensor: offset is not aligned");
+            }
+            if (m_offset > m_file->Size() || (m_file->Size() - m_offset) / sizeof(S) / std::max<size_t>(m_cols, 1) < m_rows) {
+                throw std::invalid_argument("MappedTensor: file is smaller than the tensor");
+            }
+        }
+
+        /// Creates a zero-filled file holding exactly the tensor.
+        [[nodiscard]] static auto Create(const std::filesystem::path& path, size_t rows, size_t cols, MappingOptions options = {})
+            -> MappedTensor {
+            return MappedTensor(MappedFile::Create(path, ByteSize(rows, cols), options), 0, rows, cols);
+        }
+
+        /// Maps a file holding exactly the tensor.
+        [[nodiscard]] static auto Open(const std::filesystem::path& path, size_t rows, size_t cols, MappingOptions options = {})
+            -> MappedTensor {
+            const size_t size = ByteSize(rows, cols);
+            auto file = MappedFile::Open(path, options);
+            if (file->Size() != size) {
+                throw std::invalid_argument("MappedTensor: size of " + path.string() + " doesn't match the shape");
+            }
+            return MappedTensor(std::move(file), 0, rows, cols);
+        }
+
+        [[nodiscard]] auto Rows() const noexcept -> size_t { return m_rows; }
+        [[nodiscard]] auto Cols() const noexcept -> size_t { return m_cols; }
+        [[nodiscard]] auto File() const noexcept -> const std::shared_ptr<MappedFile>& { return m_file; }
+
+        /// Row `i`. Writing requires a writable mapping.
+        [[nodiscard]] auto Row(size_t i) const -> std::span<S> {
+            if (i >= m_rows) {
+                throw std::out_of_range("MappedTensor: row " + std::to_string(i) + " is out of range");
+            }
+            return {reinterpret_cast<S*>(m_file->Data() + m_offset) + i * m_cols, m_cols};
+        }
+
+        [[nodiscard]] auto Grad() noexcept -> SparseGrad& { return m_grad; }
+        [[nodiscard]] auto Grad() const noexcept -> const SparseGrad& { return m_grad; }
+
+        auto AccumulateGrad(size_t row, std::span<const S> grad) -> void {
+            auto [it, inserted] = m_grad.try_emplace(row, m_cols, S{});
+            for (size_t j = 0; j < m_cols; ++j) {
+                it->second[j] += grad[j];
+            }
+        }
+
+        auto ZeroGrad() noexcept -> void { m_grad.clear(); }
+
+        auto Flush() const -> void { m_file->Flush(); }
+
+     private:
+        std::shared_ptr<MappedFile> m_file;
+        size_t m_offset;
+        size_t m_rows;
+        size_t m_cols;
+        SparseGrad m_grad;
+
+        /// Size of the tensor in bytes, throws if it doesn't fit in size_t.
+        [[nodiscard]] static auto ByteSize(size_t rows, size_t cols) -> size_t {
+            const auto elements = detail::CheckedMultiply(rows, cols);
+            const auto size = elements ? detail::CheckedMultiply(*elements, sizeof(S)) : std::nullopt;
+            if (!size) {
+                throw std::invalid_argument("MappedTensor: shape is too large");
+            }
+            return *size;
+        }
+    };
+
+    /**
+     * @class Embedding
+     * @brief Module gathering rows of a `MappedTensor`.
+     *
+     * The input is an `n x 1` matrix of row numbers, the output is the `n x cols` matrix of the rows. Backward accumulates
+     * the output gradient into `MappedTensor::Grad`, the input gets no gradient.
+     *
+     * @note Row numbers are stored in `S`, so for `float` they must be below 2^24.
+     */
+    template <typename S>
+    class Embedding : public IModule<Matrix<S>> {
+     public:
+        explicit Embedding(std::shared_ptr<MappedTensor<S>> table) : m_table(std::move(table)) {}
+
+        [[nodiscard]] auto Forward(const std::vector<NodePtr<Matrix<S>>>& inputs) -> std::vector<NodePtr<Matrix<S>>> override {
+            auto output = std::make_shared<Node<Matrix<S>>>(Gather(*m_table, inputs[0]->data));
+            output->parents = inputs;
+            if (ReplayRecordingScope::IsEnabled()) {
+                inputs[0]->AddChild(output);
+                output->forwardFn = [table = m_table, out = output.get()]() { out->data = Gather(*table, out->parents[0]->data); };
+            }
+            output->backwardFn = [table = m_table, out = output.get()]() {
+                const Matrix<S>& indices = out->parents[0]->data;
+                for (size_t i = 0; i < indices.rows; ++i) {
+                    table->AccumulateGrad(RowNumber(*table, indices(i, 0)), {&out->grad(i, 0), out->grad.cols});
+                }
+            };
+            return {output};
+        }
+
+     private:
+        std::shared_ptr<MappedTensor<S>> m_table;
+
+        [[nodiscard]] static auto RowNumber(const MappedTensor<S>& table, S index) -> size_t {
+            if (!(index >= 0) || index != std::floor(index) || static_cast<double>(index) >= static_cast<double>(table.Rows())) {
+                throw std::out_of_range("Embedding: invalid row number");
+            }
+            return static_cast<size_t>(index);
+        }
+
+        [[nodiscard]] static auto Gather(const MappedTensor<S>& table, const Matrix<S>& indices) -> Matrix<S> {
+            if (indices.cols != 1) {
+                throw std::invalid_argument("Embedding: indices must be a column");
+            }
+            Matrix<S> rows(indices.rows, table.Cols());
+            for (size_t i = 0; i < indices.rows; ++i) {
+                const std::span<S> row = table.Row(RowNumber(table, indices(i, 0)));
+                std::memcpy(&rows(i, 0), row.data(), row.size_bytes());
+            }
+            return rows;
+        }
+    };
+
+    /**
+     * @brief Applies `row -= learningRate * grad` to the rows with a gradient and resets the gradient.
+     *
+     * Only the touched pages are written, the rest of the file is not read.
+     *
+     * @return Number of updated rows
+     */
+    template <typename S>
+    auto SparseSgd(MappedTensor<S>& table, S learningRate) -> size_t {
+        if (!table.File()->Writable()) {
+            throw std::logic_error("SparseSgd: the table is mapped read-only");
+        }
+        for (const auto& [i, grad] : table.Grad()) {
+            const std::span<S> row = table.Row(i);
+            for (size_t j = 0; j < row.size(); ++j) {
+                row[j] -= learningRate * grad[j];
+            }
+        }
+        const size_t updated = table.Grad().size();
+        table.ZeroGrad();
+        return updated;
+    }
+
+}  // namespace auto_diff
@@ -0,0 +1,262 @@
+/**
+ * @file Matrix.hpp
+ * @brief Dense row-major matrix value type and its reference backend.
+ *
+ * `Matrix<S>` satisfies `NodeT` and provides element-wise operators, so it works with `ElemwiseBackend`.
+ * `MatrixBackend<S>` adds `MatMul` on top of the element-wise modules:
+ * \code
+ *     using Backend = MatrixBackend<float>;  // or Int8Backend for quantized inference, see Quantization.hpp
+ *     MatMul<Matrix<float>, Backend> matMul;
+ *     ElemwiseAdd<Matrix<float>, Backend> add;
+ *     auto y = add.Forward({matMul.Forward({x, w})[0], b})[0];
+ * \endcode
+ *
+ * `MatMul` has batched kernels, so under `BatchExecutor` the products of many graphs with a shared weight run as one.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ElemwiseBackend.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class Matrix
+     * @brief Dense row-major matrix. Element-wise operators broadcast a 1x1 operand.
+     *
+     * `ReduceBroadcast` lets `ElemwiseBackend` sum the gradient of a broadcast operand back to 1x1.
+     *
+     * @tparam S Arithmetic element type
+     */
+    template <typename S>
+    struct Matrix {
+        size_t rows{0};
+        size_t cols{0};
+        std::vector<S> values;
+
+        Matrix() = default;
+        Matrix(size_t numRows, size_t numCols, S value = S{}) : rows(numRows), cols(numCols), values(numRows * numCols, value) {}
+        Matrix(size_t numRows, size_t numCols, std::vector<S> elements) : rows(numRows), cols(numCols), values(std::move(elements)) {
+            if (values.size() != rows * cols) {
+                throw std::invalid_argument("Matrix: number of values doesn't match the shape");
+            }
+        }
+
+        /// Fills the matrix keeping its shape.
+        auto operator=(S value) -> Matrix& {
+            std::fill(values.begin(), values.end(), value);
+            return *this;
+        }
+
+        [[nodiscard]] auto operator()(size_t i, size_t j) -> S& { return values[i * cols + j]; }
+        [[nodiscard]] auto operator()(size_t i, size_t j) const -> const S& { return values[i * cols + j]; }
+
+        auto operator+=(const Matrix& other) -> Matrix& {
+            return Apply(other, [](S a, S b) { return a + b; });
+        }
+        auto operator-=(const Matrix& other) -> Matrix& {
+            return Apply(other, [](S a, S b) { return a - b; });
+        }
+        auto operator*=(const Matrix& other) -> Matrix& {
+            return Apply(other, [](S a, S b) { return a * b; });
+        }
+        auto operator/=(const Matrix& other) -> Matrix& {
+            return Apply(other, [](S a, S b) { return a / b; });
+        }
+
+        friend auto operator+(Matrix a, const Matrix& b) -> Matrix { return a += b; }
+        friend auto operator-(Matrix a, const Matrix& b) -> Matrix { return a -= b; }
+        friend auto operator*(Matrix a, const Matrix& b) -> Matrix { return a *= b; }
+        friend auto operator/(Matrix a, const Matrix& b) -> Matrix { return a /= b; }
+
+        /// Returns the sum of `gradient` as a 1x1 matrix if `operand` is 1x1 and was broadcast, `std::nullopt` otherwise.
+        friend auto ReduceBroadcast(const Matrix& gradient, const Matrix& operand) -> std::optional<Matrix> {
+            if (operand.values.size() != 1 || gradient.values.size() == 1) {
+                return std::nullopt;
+            }
+            return Matrix(1, 1, std::accumulate(gradient.values.begin(), gradient.values.end(), S{}));
+        }
+
+     private:
+        template <typename Op>
+        auto Apply(const Matrix& other, Op op) -> Matrix& {
+            if (values.size() == 1 && other.values.size() != 1) {
+                const S value = values[0];
+                rows = other.rows;
+                cols = other.cols;
+                values.assign(other.values.size(), value);
+            }
+            if (other.values.size() == 1) {
+                for (S& value : values) {
+                    value = op(value, other.values[0]);
+                }
+                return *this;
+            }
+            if (rows != other.rows || cols != other.cols) {
+                throw std::invalid_argument("Matrix: shapes of element-wise operands don't match");
+            }
+            for (size_t i = 0; i < values.size(); ++i) {
+                values[i] = op(values[i], other.values[i]);
+            }
+            return *this;
+        }
+    };
+
+    /**
+     * @class MatrixBackend
+     * @brief Reference backend of `MatMul` and the element-wise modules for `Matrix<S>`.
+     *
+     * `MatMul` takes `x` of shape `M x K` and `w` of shape `K x N` and returns `x w`.
+     */
+    template <typename S>
+    class MatrixBackend : public ElemwiseBackend<Matrix<S>> {
+     public:
+        using NodeType = Node<Matrix<S>>;
+
+        static auto MatMulForward(const std::vector<NodePtr<Matrix<S>>>& inputs, std::vector<NodePtr<Matrix<S>>>& outputs) -> void {
+            outputs.push_back(std::make_shared<NodeType>(Multiply(inputs[0]->data, inputs[1]->data)));
+        }
+
+        static auto MatMulBackward(const std::vector<NodePtr<Matrix<S>>>& inputs, NodeType* output, [[maybe_unused]] size_t outputIdx)
+            -> void {
+            if (inputs[0]->requiresGrad) {
+                inputs[0]->grad += MultiplyTransposed(output->grad, inputs[1]->data);
+            }
+            if (inputs[1]->requiresGrad) {
+                inputs[1]->grad += TransposedMultiply(inputs[0]->data, output->grad);
+            }
+        }
+
+        /**
+         * @brief Batched `MatMul` for `BatchExecutor`.
+         *
+         * The rows of all `x` multiplied by the same `w` are stacked, so every weight takes part in a single matrix
+         * product however many graphs use it.
+         */
+        static auto MatMulForwardBatch(const std::vector<NodeType*>& outputs) -> void {
+            for (const auto& [w, group] : GroupByWeight(outputs)) {
+                ScatterRows(group, Multiply(StackInputs(group), w->data));
+            }
+        }
+
+        /// Batched `MatMul` backward, one product per weight for the gradients of all `x` and one for the gradient of `w`.
+        static auto MatMulBackwardBatch(const std::vector<NodeType*>& outputs) -> void {
+            for (const auto& [w, group] : GroupByWeight(outputs)) {
+                const Matrix<S> g = StackRows(group, [](NodeType* output) -> auto& { return output->grad; });
+                if (std::ranges::any_of(group, [](NodeType* output) { return output->parents[0]->requiresGrad; })) {
+                    const Matrix<S> dx = MultiplyTransposed(g, w->data);
+                    const S* rows = dx.values.data();
+                    for (NodeType* output : group) {
+                        NodeType* x = output->parents[0].get();
+                        if (x->requiresGrad) {
+                            std::transform(x->grad.values.begin(), x->grad.values.end(), rows, x->grad.values.begin(), std::plus<S>());
+                        }
+                        rows += x->data.values.size();
+                    }
+                }
+                if (w->requiresGrad) {
+                    w->grad += TransposedMultiply(StackInputs(group), g);
+                }
+            }
+        }
+
+        [[nodiscard]] static auto Multiply(const Matrix<S>& x, const Matrix<S>& w) -> Matrix<S> {
+            if (x.cols != w.rows) {
+                throw std::invalid_argument("MatMul: inner dimensions don't match");
+            }
+            Matrix<S> y(x.rows, w.cols);
+            for (size_t i = 0; i < x.rows; ++i) {
+                for (size_t k = 0; k < x.cols; ++k) {
+                    const S xik = x(i, k);
+                    for (size_t j = 0; j < w.cols; ++j) {
+                        y(i, j) += xik * w(k, j);
+                    }
+                }
+            }
+            return y;
+        }
+
+     protected:
+        /// Returns `g w^T`.
+        [[nodiscard]] static auto MultiplyTransposed(const Matrix<S>& g, const Matrix<S>& w) -> Matrix<S> {
+            Matrix<S> y(g.rows, w.rows);
+            for (size_t i = 0; i < g.rows; ++i) {
+                for (size_t k = 0; k < w.rows; ++k) {
+                    S sum{};
+                    for (size_t j = 0; j < w.cols; ++j) {
+                        sum += g(i, j) * w(k, j);
+                    }
+                    y(i, k) = sum;
+                }
+            }
+            return y;
+        }
+
+        /// Returns `x^T g`.
+        [[nodiscard]] static auto TransposedMultiply(const Matrix<S>& x, const Matrix<S>& g) -> Matrix<S> {
+            Matrix<S> y(x.cols, g.cols);
+            for (size_t i = 0; i < x.rows; ++i) {
+                for (size_t k = 0; k < x.cols; ++k) {
+                    const S xik = x(i, k);
+                    for (size_t j = 0; j < g.cols; ++j) {
+                        y(k, j) += xik * g(i, j);
+                    }
+                }
+            }
+            return y;
+        }
+
+        /// Groups the outputs of a batch by their weight node.
+        [[nodiscard]] static auto GroupByWeight(const std::vector<NodeType*>& outputs)
+            -> std::unordered_map<NodeType*, std::vector<NodeType*>> {
+            std::unordered_map<NodeType*, std::vector<NodeType*>> groups;
+            for (NodeType* output : outputs) {
+                groups[output->parents[1].get()].push_back(output);
+            }
+            return groups;
+        }
+
+        /// Concatenates the rows of the matrices selected by `get` from every output.
+        template <typename Get>
+        [[nodiscard]] static auto StackRows(const std::vector<NodeType*>& outputs, Get get) -> Matrix<S> {
+            Matrix<S> stacked(0, get(outputs.front()).cols);
+            for (NodeType* output : outputs) {
+                const Matrix<S>& part = get(output);
+                if (part.cols != stacked.cols) {
+                    throw std::invalid_argument("MatMul: inner dimensions don't match");
+                }
+                stacked.values.insert(stacked.values.end(), part.values.begin(), part.values.end());
+                stacked.rows += part.rows;
+            }
+            return stacked;
+        }
+
+        /// Concatenates the rows of `x` of every output.
+        [[nodiscard]] static auto StackInputs(const std::vector<NodeType*>& outputs) -> Matrix<S> {
+            return StackRows(outputs, [](NodeType* output) -> auto& { return output->parents[0]->data; });
+        }
+
+        /// Splits the rows of the stacked product `y` into `data` of the outputs.
+        static auto ScatterRows(const std::vector<NodeType*>& outputs, const Matrix<S>& y) -> void {
+            const S* rows = y.values.data();
+            for (NodeType* output : outputs) {
+                const size_t size = output->parents[0]->data.rows * y.cols;
+                output->data = Matrix<S>(output->parents[0]->data.rows, y.cols, std::vector<S>(rows, rows + size));
+                rows += size;
+            }
+        }
+    };
+
+}  // namespace auto_diff
@@ -0,0 +1,327 @@
+/**
+ * @file MixedPrecision.hpp
+ * @brief Mixed-precision training: 16-bit tensors, dynamic loss scaling and fp32 master weights.
+ *
+ * Activations and weights are stored as `LowPrecisionTensor<Float16>` or `LowPrecisionTensor<BFloat16>`, so they take
+ * half the memory and bandwidth of `float`. Element-wise operations and reductions are computed in `float`, and gradients
+ * are accumulated in `float`: a 16-bit sum of many small contributions would lose most of them to rounding.
+ *
+ * Small gradients underflow in `Float16`. `LossScaler` multiplies the seed of the backward pass by a large scale and
+ * adjusts it dynamically: when a gradient overflows the step is skipped and the scale is reduced, after a number of good
+ * steps it is increased again, up to the largest power of two of the storage format, and it is never reduced below
+ * `minScale`. The contribution of every consumer to a gradient is still 16-bit, so overflows are detected as before.
+ * Parameter updates are applied to `float` master copies in `MasterWeights`, because updates are often below the
+ * resolution of a 16-bit weight.
+ *
+ * Usage:
+ * \code
+ *     using Tensor = LowPrecisionTensor<Float16>;
+ *     MasterWeights<Float16> master(params);
+ *     LossScaler scaler;
+ *     for (...) {
+ *         ...;  // zero gradients and build the loss
+ *         scaler.Backward(*loss);
+ *         master.Step(scaler, [lr](std::vector<float>& weight, const std::vector<float>& grad) {
+ *             for (size_t i = 0; i < weight.size(); ++i) weight[i] -= lr * grad[i];
+ *         });
+ *     }
+ * \endcode
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Float16.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class LowPrecisionTensor
+     * @brief Flat tensor stored in a 16-bit format and computed in `float`.
+     *
+     * Binary operators are element-wise and return 16-bit tensors, an operand with one element is broadcast. Operands of
+     * other different sizes throw std::invalid_argument. `ReduceBroadcast` lets `ElemwiseBackend` sum the gradient of a
+     * broadcast operand back to one element.
+     *
+     * Compound assignments accumulate: they switch the left operand to `float` storage, which it keeps from then on.
+     * `Node` sums gradients with `+=`, so gradients are accumulated in `float` over all consumers of a node, while the
+     * activations and weights, and the contribution of every consumer, stay 16-bit.
+     *
+     * @tparam Storage `Float16` or `BFloat16`
+     */
+    template <typename Storage>
+    class LowPrecisionTensor {
+     public:
+        LowPrecisionTensor() = default;
+        explicit LowPrecisionTensor(size_t size, float value = 0.0F) : m_elements(size, Storage(value)) {}
+        explicit LowPrecisionTensor(const std::vector<float>& values) : m_elements(values.begin(), values.end()) {}
+
+        /// Fills the tensor keeping its size and storage.
+        auto operator=(float value) -> LowPrecisionTensor& {
+            std::fill(m_elements.begin(), m_elements.end(), Storage(value));
+            std::fill(m_accumulator.begin(), m_accumulator.end(), value);
+            return *this;
+        }
+        auto operator=(int value) -> LowPrecisionTensor& { return *this = static_cast<float>(value); }
+
+        [[nodiscard]] auto Size() const noexcept -> size_t { return m_accumulating ? m_accumulator.size() : m_elements.size(); }
+        [[nodiscard]] auto operator[](size_t i) const -> float {
+            return m_accumulating ? m_accumulator[i] : static_cast<float>(m_elements[i]);
+        }
+        /// Whether a compound assignment has switched the tensor to `float` storage.
+        [[nodiscard]] auto IsAccumulator() const noexcept -> bool { return m_accumulating; }
+
+        [[nodiscard]] auto ToFloat() const -> std::vector<float> {
+            return m_accumulating ? m_accumulator : std::vector<float>(m_elements.begin(), m_elements.end());
+        }
+
+        /// Sum of the elements accumulated in `float`.
+        [[nodiscard]] auto Sum() const -> float {
+            float sum = 0;
+            for (size_t i = 0; i < Size(); ++i) {
+                sum += (*this)[i];
+            }
+            return sum;
+        }
+
+        auto operator+=(const LowPrecisionTensor& other) -> LowPrecisionTensor& {
+            return Apply(other, [](float a, float b) { return a + b; });
+        }
+        auto operator-=(const LowPrecisionTensor& other) -> LowPrecisionTensor& {
+            return Apply(other, [](float a, float b) { return a - b; });
+        }
+        auto operator*=(const LowPrecisionTensor& other) -> LowPrecisionTensor& {
+            return Apply(other, [](float a, float b) { return a * b; });
+        }
+        auto operator/=(const LowPrecisionTensor& other) -> LowPrecisionTensor& {
+            return Apply(other, [](float a, float b) { return a / b; });
+        }
+
+        friend auto operator+(const LowPrecisionTensor& a, const LowPrecisionTensor& b) -> LowPrecisionTensor {
+            return Combine(a, b, [](float x, float y) { return x + y; });
+        }
+        friend auto operator-(const LowPrecisionTensor& a, const LowPrecisionTensor& b) -> LowPrecisionTensor {
+            return Combine(a, b, [](float x, float y) { return x - y; });
+        }
+        friend auto operator*(const LowPrecisionTensor& a, const LowPrecisionTensor& b) -> LowPrecisionTensor {
+            return Combine(a, b, [](float x, float y) { return x * y; });
+        }
+        friend auto operator/(const LowPrecisionTensor& a, const LowPrecisionTensor& b) -> LowPrecisionTensor {
+            return Combine(a, b, [](float x, float y) { return x / y; });
+        }
+        friend auto operator*(double s, const LowPrecisionTensor& a) -> LowPrecisionTensor {
+            return Combine(LowPrecisionTensor(1, static_cast<float>(s)), a, [](float x, float y) { return x * y; });
+        }
+
+        /// Returns the sum of `gradient` as one element if `operand` has one element and was broadcast, `std::nullopt` otherwise.
+        friend auto ReduceBroadcast(const LowPrecisionTensor& gradient, const LowPrecisionTensor& operand)
+            -> std::optional<LowPrecisionTensor> {
+            if (operand.Size() != 1 || gradient.Size() == 1) {
+                return std::nullopt;
+            }
+            return LowPrecisionTensor(1, gradient.Sum());
+        }
+
+        /// NaN when an element is NaN, as `MaxNorm` of VectorSpace.hpp.
+        friend auto MaxNorm(const LowPrecisionTensor& a) -> double {
+            double norm = 0;
+            for (size_t i = 0; i < a.Size(); ++i) {
+                const float element = a[i];
+                if (std::isnan(element)) {
+                    return element;
+                }
+                norm = std::max(norm, static_cast<double>(std::abs(element)));
+            }
+            return norm;
+        }
+        friend auto Dot(const LowPrecisionTensor& a, const LowPrecisionTensor& b) -> double {
+            float dot = 0;
+            for (size_t i = 0; i < a.Size(); ++i) {
+                dot += a[i] * b[i];
+            }
+            return dot;
+        }
+
+     private:
+        std::vector<Storage> m_elements;
+        /// Elements of an accumulator, `m_elements` is empty then.
+        std::vector<float> m_accumulator;
+        bool m_accumulating{false};
+
+        [[nodiscard]] static auto BroadcastSize(const LowPrecisionTensor& a, const LowPrecisionTensor& b) -> size_t {
+            if (a.Size() != 1 && b.Size() != 1 && a.Size() != b.Size()) {
+                throw std::invalid_argument("LowPrecisionTensor: sizes of element-wise operands don't match");
+            }
+            return a.Size() == 1 ? b.Size() : a.Size();
+        }
+
+        /// Element-wise `op` computed in `float` and rounded to a new 16-bit tensor.
+        template <typename Op>
+        [[nodiscard]] static auto Combine(const LowPrecisionTensor& a, const LowPrecisionTensor& b, Op op) -> LowPrecisionTensor {
+            const size_t size = BroadcastSize(a, b);
+            LowPrecisionTensor result;
+            result.m_elements.reserve(size);
+            for (size_t i = 0; i < size; ++i) {
+                result.m_elements.emplace_back(op(a[a.Size() == 1 ? 0 : i], b[b.Size() == 1 ? 0 : i]));
+            }
+            return result;
+        }
+
+        /// Element-wise `op` accumulated in place in `float` storage.
+        template <typename Op>
+        auto Apply(const LowPrecisionTensor& other, Op op) -> LowPrecisionTensor& {
+            const size_t size = BroadcastSize(*this, other);
+            if (!m_accumulating) {
+                m_accumulator.assign(m_elements.begin(), m_elements.end());
+                m_elements = {};
+                m_accumulating = true;
+            }
+            if (m_accumulator.size() == 1 && size != 1) {
+                m_accumulator.resize(size, m_accumulator[0]);
+            }
+            for (size_t i = 0; i < size; ++i) {
+                m_accumulator[i] = op(m_accumulator[i], other[other.Size() == 1 ? 0 : i]);
+            }
+            return *this;
+        }
+    };
+
+    namespace detail {
+
+        /// Largest power of two `Storage` holds, a loss seeded with a higher scale is already infinite.
+        template <typename Storage>
+        [[nodiscard]] auto LargestPowerOfTwo() noexcept -> float {
+            float power = 1.0F;
+            while (std::isfinite(static_cast<float>(Storage(power * 2.0F)))) {
+                power *= 2.0F;
+            }
+            return power;
+        }
+
+    }  // namespace detail
+
+    /// @tparam Storage Format of the gradients, `Float16` or `BFloat16`
+    template <typename Storage = Float16>
+    struct LossScalerOptions {
+        /// Largest power of two below the Float16 maximum of 65504.
+        float initialScale{32768.0F};
+        float growthFactor{2.0F};
+        float backoffFactor{0.5F};
+        /// Number of consecutive steps without overflow after which the scale grows.
+        size_t growthInterval{2000};
+        /// The scale doesn't grow beyond it, a higher seed would overflow every time.
+        float maxScale{detail::LargestPowerOfTwo<Storage>()};
+        /// The scale isn't reduced below it, so that repeated overflows don't drive it to zero or denormals.
+        float minScale{1.0F};
+    };
+
+    /**
+     * @class LossScaler
+     * @brief Dynamic loss scaling for gradients stored in 16-bit formats.
+     *
+     * @tparam Storage Format of the gradients, `Float16` or `BFloat16`
+     */
+    template <typename Storage = Float16>
+    class LossScaler {
+     public:
+        explicit LossScaler(LossScalerOptions<Storage> options = {}) : m_options(options), m_scale(options.initialScale) {}
+
+        [[nodiscard]] auto Scale() const noexcept -> float { return m_scale; }
+
+        /**
+         * @brief Backpropagates `loss` seeded with the current scale instead of one.
+         *
+         * Gradients of the graph must be zeroed beforehand, as for `Node::Backward`.
+         */
+        template <NodeT T>
+        auto Backward(Node<T>& loss) const -> void {
+            if (!loss.requiresGrad) return;
+            loss.grad = loss.data;
+            loss.grad = m_scale;
+            Node<T>::Backpropagate({&loss});
+        }
+
+        /// Adjusts the scale after a step, `overflow` tells whether any gradient was not finite.
+        auto Update(bool overflow) noexcept -> void {
+            if (overflow) {
+                // an initial scale below minScale is left as it is, not raised
+                m_scale = std::max(m_scale * m_options.backoffFactor, std::min(m_options.minScale, m_scale));
+                m_goodSteps = 0;
+                return;
+            }
+            if (++m_goodSteps == m_options.growthInterval) {
+                // an initial scale above maxScale is left as it is, not reduced
+                m_scale = std::min(m_scale * m_options.growthFactor, std::max(m_options.maxScale, m_scale));
+                m_goodSteps = 0;
+            }
+        }
+
+     private:
+        LossScalerOptions<Storage> m_options;
+        float m_scale;
+        size_t m_goodSteps{0};
+    };
+
+    /**
+     * @class MasterWeights
+     * @brief `float` copies of 16-bit parameters that receive the updates.
+     *
+     * @tparam Storage `Float16` or `BFloat16`
+     */
+    template <typename Storage>
+    class MasterWeights {
+     public:
+        explicit MasterWeights(NodePtrVector<LowPrecisionTensor<Storage>> params) : m_params(std::move(params)) {
+            for (const auto& param : m_params) {
+                m_masters.push_back(param->data.ToFloat());
+            }
+        }
+
+        /**
+         * @brief Unscales the gradients and applies `update` to the master weights.
+         *
+         * If any gradient is not finite nothing is updated. The scaler is updated in both cases.
+         *
+         * @param update Callable `(std::vector<float>& weight, const std::vector<float>& grad)` applied to every parameter
+         * @return Whether the step has been applied
+         */
+        template <typename Update>
+        auto Step(LossScaler<Storage>& scaler, const Update& update) -> bool {
+            const float inverseScale = 1.0F / scaler.Scale();
+            std::vector<std::vector<float>> grads;
+            grads.reserve(m_params.size());
+            for (const auto& param : m_params) {
+                std::vector<float> grad = param->grad.ToFloat();
+                for (float& value : grad) {
+                    value *= inverseScale;
+                    if (!std::isfinite(value)) {
+                        scaler.Update(true);
+                        return false;
+                    }
+                }
+                grads.push_back(std::move(grad));
+            }
+            for (size_t i = 0; i < m_params.size(); ++i) {
+                update(m_masters[i], grads[i]);
+                m_params[i]->data = LowPrecisionTensor<Storage>(m_masters[i]);
+            }
+            scaler.Update(false);
+            return true;
+        }
+
+        [[nodiscard]] auto Master(size_t i) const -> const std::vector<float>& { return m_masters[i]; }
+
+     private:
+        NodePtrVector<LowPrecisionTensor<Storage>> m_params;
+        std::vector<std::vector<float>> m_masters;
+    };
+
+}  // namespace auto_diff
@@ -8,5 +8,6 @@ namespace auto_diff {
     DEFINE_MODULE(ElemwiseMult)
     DEFINE_MODULE(ElemwiseDiv)
     DEFINE_MODULE(ElemwiseSub)
+    DEFINE_MODULE(MatMul)
 
 }  // namespace auto_diff
\ No newline at end of file
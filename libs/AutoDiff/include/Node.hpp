@@ -9,10 +9,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace auto_diff {
@@ -48,6 +53,68 @@ namespace auto_diff {
     template <NodeT T>
     using NodePtrVector = std::vector<NodePtr<T>>;
 
+    /**
+     * @brief Batched kernels of a module, shared by all nodes the module produced.
+     *
+     * Nodes pointing to the same kernels (and having the same shape) can be evaluated with one call, see `BatchExecutor`.
+     */
+    template <NodeT T>
+    struct BatchKernels {
+        /// Recomputes `data` of every node from its parents.
+        void (*forward)(const std::vector<Node<T>*>& nodes);
+        /// Accumulates `grad` of every node into its parents that require grad.
+        void (*backward)(const std::vector<Node<T>*>& nodes);
+    };
+
+    /// Packed `data` of a node, see `SavedDataCodec`.
+    template <NodeT T>
+    struct PackedData {
+        /// Restores `data`, called once.
+        std::function<void(T&)> unpack;
+        /// Starts loading the data in the background ahead of `unpack`, optional. May be called several times.
+        std::function<void()> prefetch{};
+    };
+
+    /**
+     * @brief Lossy or lossless compression of `data` kept by a node only for the backward pass, see SavedData.hpp.
+     */
+    template <NodeT T>
+    class SavedDataCodec {
+     public:
+        virtual ~SavedDataCodec() = default;
+        /// Compresses `data` and releases its storage.
+        [[nodiscard]] virtual auto Pack(T& data) const -> PackedData<T> = 0;
+    };
+
+    /**
+     * @brief RAII scope that records what replaying graphs needs on the current thread.
+     *
+     * Modules called while recording is enabled set `forwardFn` of their outputs and register the outputs as `children`
+     * of their inputs. Only replays (`Graph::Forward`, `Recompute` and the classes built on them) and `Node::SetData` read
+     * them, so plain forward and backward passes don't pay for the closures and links. Build graphs that are going to be
+     * replayed inside a scope.
+     *
+     * Scopes can be nested, `ReplayRecordingScope(false)` suspends recording until it ends.
+     */
+    class ReplayRecordingScope {
+     public:
+        explicit ReplayRecordingScope(bool enabled = true) noexcept : m_previous(std::exchange(Enabled(), enabled)) {}
+        ~ReplayRecordingScope() { Enabled() = m_previous; }
+
+        ReplayRecordingScope(const ReplayRecordingScope&) = delete;
+        auto operator=(const ReplayRecordingScope&) -> ReplayRecordingScope& = delete;
+
+        [[nodiscard]] static auto IsEnabled() noexcept -> bool { return Enabled(); }
+
+     private:
+        bool m_previous;
+
+        [[nodiscard]] static auto Enabled() noexcept -> bool& {
+            thread_local bool enabled = false;
+            return enabled;
+        }
+    };
+
     /**
      * @class Node
      * @brief Represents a node in a computational graph for automatic differentiation.
@@ -81,34 +148,182 @@ namespace auto_diff {
         auto Backward() -> void {
             if (!requiresGrad) return;
             grad = 1;
-            std::vector<Node<T>*> topologicalSortedNodes = TopologicalSort();
+            Backpropagate({this});
+        }
+
+        /**
+         * @brief Propagates the current gradients of `roots` backward through the graph.
+         *
+         * Unlike `Backward`, gradients of the roots are not reset, they are used as seeds. This allows backpropagating a
+         * vector-Jacobian product from several outputs at once. Nodes shared by the roots are processed once.
+         *
+         * @param roots Nodes whose `grad` is already seeded
+         */
+        static auto Backpropagate(const std::vector<Node<T>*>& roots) -> void {
+            std::vector<Node<T>*> topologicalSortedNodes = TopologicalSort(roots);
+            std::reverse(topologicalSortedNodes.begin(), topologicalSortedNodes.end());
+
+            // packed data stored outside of memory is requested a few nodes before it is needed
+            auto prefetch = [&topologicalSortedNodes](size_t i) {
+                if (i < topologicalSortedNodes.size() && topologicalSortedNodes[i]->backwardFn) {
+                    topologicalSortedNodes[i]->Prefetch();
+                    for (auto& parent : topologicalSortedNodes[i]->parents) {
+                        parent->Prefetch();
+                    }
+                }
+            };
+            for (size_t i = 0; i < PREFETCH_DISTANCE; ++i) {
+                prefetch(i);
+            }
+            for (size_t i = 0; i < topologicalSortedNodes.size(); ++i) {
+                prefetch(i + PREFETCH_DISTANCE);
+                Node<T>* node = topologicalSortedNodes[i];
+                if (node->backwardFn) {
+                    node->Unpack();
+                    for (auto& parent : node->parents) {
+                        parent->Unpack();
+                    }
+                    node->backwardFn();
+                }
+            }
+        }
+
+        /**
+         * @brief Replaces `data` and marks all nodes computed from this node as stale.
+         *
+         * Stale nodes can be brought up to date with `Recompute`, which re-executes only the stale part of the graph.
+         * Assigning `data` directly doesn't mark anything. Only children recorded in a `ReplayRecordingScope` are marked.
+         */
+        auto SetData(T value) -> void {
+            data = std::move(value);
+            MarkChildrenStale();
+        }
 
-            for (auto it = topologicalSortedNodes.rbegin(); it != topologicalSortedNodes.rend(); ++it) {
-                if ((*it)->backwardFn) {
-                    (*it)->backwardFn();
+        /**
+         * @brief Registers a node computed from this node.
+         *
+         * Dead children are pruned before the storage grows. Nodes are allocated with `std::make_shared`, so a dangling
+         * weak pointer keeps the memory of the whole node, and long-lived leaves (e.g. parameters) would otherwise
+         * accumulate them on every step.
+         *
+         * A child of a stale node has been computed from out of date data, so it is marked stale as well.
+         */
+        auto AddChild(const NodePtr<T>& child) -> void {
+            AppendLink(children, child);
+            if (stale) {
+                child->stale = true;
+            }
+        }
+
+        /// Appends `node` to `links`, pruning expired links before the storage grows, see `AddChild`.
+        static auto AppendLink(std::vector<std::weak_ptr<Node<T>>>& links, const NodePtr<T>& node) -> void {
+            if (links.size() == links.capacity()) {
+                std::erase_if(links, [](const std::weak_ptr<Node<T>>& link) { return link.expired(); });
+                // keep pruning amortized O(1) when most links are alive
+                if (links.size() > links.capacity() / 2) {
+                    links.reserve(2 * links.capacity());
                 }
             }
+            links.push_back(node);
         }
 
+        /**
+         * @brief Restores `data` compressed by `PackSavedData`. Does nothing if `data` is not packed.
+         *
+         * Backpropagation and graph replays unpack the nodes they read, so this is needed only to read `data` directly.
+         */
+        auto Unpack() -> void {
+            if (packed.unpack) {
+                auto unpack = std::move(packed.unpack);
+                packed = {};
+                unpack(data);
+            }
+        }
+
+        /**
+         * @brief Recomputes `data` from `parents` with `forwardFn`. Does nothing for leaves.
+         *
+         * @throws std::logic_error if the node has parents but was recorded outside of a `ReplayRecordingScope`
+         */
+        auto Replay() -> void {
+            if (forwardFn) {
+                forwardFn();
+            } else if (!parents.empty()) {
+                throw std::logic_error("Node: replayed node was recorded outside of a ReplayRecordingScope");
+            }
+        }
+
+        /// Starts loading packed `data` in the background if its codec supports it.
+        auto Prefetch() -> void {
+            if (packed.prefetch) {
+                packed.prefetch();
+            }
+        }
+
+        /// Number of nodes ahead of the current one whose packed data is prefetched during backpropagation.
+        static constexpr size_t PREFETCH_DISTANCE = 4;
+
+        /// Incremented by every pass that calls `forwardFn` (`Graph::Forward`, `Recompute`, ...). Outputs of one module call
+        /// run the module once per pass, see `SetReplayForward`.
+        static inline thread_local uint64_t replayPass{0};
+
         T data{};
         T grad{};
         bool requiresGrad{true};
         std::function<void()> backwardFn;
+        /// Recomputes `data` from `parents`. Set by modules inside a `ReplayRecordingScope`, empty for leaves. Used to replay
+        /// captured graphs, see `Graph`.
+        std::function<void()> forwardFn;
         std::vector<NodePtr<T>> parents;
+        /// Nodes computed from this node inside a `ReplayRecordingScope`. Weak, so that consumers don't prolong each other's
+        /// lifetime.
+        std::vector<std::weak_ptr<Node<T>>> children;
+        /// `data` is out of date because one of the ancestors has been changed with `SetData`.
+        bool stale{false};
+        /// Set by modules whose backends provide batched kernels, `nullptr` otherwise.
+        const BatchKernels<T>* batchKernels{nullptr};
+        /// Codec accepted by all consumers that compress their saved inputs, `nullptr` if they disagree. See `CompressSaved`.
+        std::shared_ptr<const SavedDataCodec<T>> savedDataCodec;
+        /// Outputs of the consumers that accepted a compressed `data`. `data` is packed only if all live children are among them.
+        std::vector<std::weak_ptr<Node<T>>> compressingConsumers;
+        /// The backward function of this node tolerates a compressed `data`, set by `CompressSaved` on the outputs it wraps.
+        bool compressibleByProducer{false};
+        /// `data` compressed by `PackSavedData`, empty when `data` is not packed.
+        PackedData<T> packed;
 
      private:
+        /// Marks all descendants as stale. Children of stale nodes are stale from `AddChild` on, so stale nodes are not revisited.
+        auto MarkChildrenStale() -> void {
+            std::vector<Node<T>*> stack{this};
+            while (!stack.empty()) {
+                Node<T>* node = stack.back();
+                stack.pop_back();
+                std::erase_if(node->children, [](const std::weak_ptr<Node<T>>& child) { return child.expired(); });
+                for (const auto& weakChild : node->children) {
+                    auto child = weakChild.lock();
+                    if (!child->stale) {
+                        child->stale = true;
+                        stack.push_back(child.get());
+                    }
+                }
+            }
+        }
+
         /**
          * @brief Performs a topological sort of the computational graph.
          *
+         * @param roots Nodes to start from.
          * @return A vector of pointers to nodes in topological order.
          *
          * This function sorts the nodes in the computational graph in topological
          * order, ensuring that parent nodes appear before their children.
          */
-        auto TopologicalSort() -> std::vector<Node<T>*> {
+        static auto TopologicalSort(const std::vector<Node<T>*>& roots) -> std::vector<Node<T>*> {
             std::vector<Node<T>*> sortedNodes;
             std::unordered_set<Node<T>*> visited;
-            TopologicalSortInner(this, visited, sortedNodes);
+            for (Node<T>* root : roots) {
+                TopologicalSortInner(root, visited, sortedNodes);
+            }
             return sortedNodes;
         }
 
@@ -122,7 +337,9 @@ namespace auto_diff {
          * This function recursively visits all parent nodes of the given node
          * and adds them to the sorted list in topological order.
          */
-        auto TopologicalSortInner(Node<T>* node, std::unordered_set<Node<T>*>& visited, std::vector<Node<T>*>& sortedNodes) -> void {
+        static auto TopologicalSortInner(Node<T>* node,
+                                         std::unordered_set<Node<T>*>& visited,
+                                         std::vector<Node<T>*>& sortedNodes) -> void {
             if (visited.count(node) || !node->requiresGrad) return;
             visited.insert(node);
             for (auto& parent : node->parents) {
@@ -0,0 +1,282 @@
+/**
+ * @file OdeSolve.hpp
+ * @brief Defines the OdeSolve module that integrates an ODE and differentiates it with the adjoint method.
+ *
+ * The module solves \f$\dot y = f(y, \theta)\f$ from `t0` to `t1`, where \f$f\f$ is a body module called with the state
+ * followed by the parameters. Neither the forward solve nor the backward pass records the solver steps in the graph.
+ * The backward pass integrates the augmented system
+ * \f[
+ *     \dot y = f, \quad \dot a = -a^T \frac{\partial f}{\partial y}, \quad \dot a_\theta = -a^T \frac{\partial f}{\partial \theta}
+ * \f]
+ * from `t1` back to `t0` with \f$a(t_1)\f$ equal to the gradient of the solution, so memory is constant in the number of
+ * solver steps. The vector-Jacobian products are computed by the body's own backward.
+ *
+ * Usage:
+ * \code
+ *     OdeSolve<double> solve(std::make_shared<Dynamics>(), {.method = OdeMethod::DORMAND_PRINCE, .t1 = 10});
+ *     auto y1 = solve.Forward({y0, theta})[0];
+ *     y1->Backward();  // y0->grad and theta->grad are filled
+ * \endcode
+ *
+ * @note The state is recomputed backward in time, so the gradients are exact only up to the solver tolerance. Unstable
+ * dynamics may need tighter tolerances in reverse than in forward.
+ *
+ * @note The dynamics are autonomous. Time can be added as a state component with \f$\dot t = 1\f$.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Functional.hpp"
+#include "IModule.hpp"
+#include "Node.hpp"
+#include "VectorSpace.hpp"
+
+namespace auto_diff {
+
+    /// Integration method of `OdeSolve`.
+    enum class OdeMethod {
+        /// Classic fourth order Runge-Kutta with `OdeOptions::steps` fixed steps
+        RK4,
+        /// Adaptive fifth order Dormand-Prince method with embedded fourth order error estimate
+        DORMAND_PRINCE
+    };
+
+    struct OdeOptions {
+        OdeMethod method{OdeMethod::DORMAND_PRINCE};
+        double t0{0.0};
+        double t1{1.0};
+        /// Number of steps of the fixed step method, used in both directions.
+        size_t steps{100};
+        double relativeTolerance{1e-6};
+        double absoluteTolerance{1e-9};
+        /// Maximum number of accepted and rejected steps of the adaptive method.
+        size_t maxSteps{100000};
+    };
+
+    /**
+     * @class OdeSolve
+     * @brief Module integrating an ODE defined by a body module, differentiated with the adjoint method.
+     *
+     * @tparam T The data type of the nodes, must form a vector space over `double`
+     *
+     * Inputs are `stateSize` initial state components followed by the parameters of the dynamics. Outputs are the state
+     * components at `t1`. The adaptive method throws `std::runtime_error` when it exceeds `maxSteps` or when the step size
+     * falls below a minimum because the state or the error estimate stays non-finite.
+     */
+    template <VectorSpaceT T>
+    class OdeSolve : public IModule<T> {
+     public:
+        /**
+         * @param dynamics Module computing \f$\dot y\f$ in its `stateSize` leading outputs from the state and the parameters
+         * @param options Integration interval and method
+         * @param stateSize Number of state inputs, the rest of the inputs are parameters
+         */
+        explicit OdeSolve(std::shared_ptr<IModule<T>> dynamics, OdeOptions options = {}, size_t stateSize = 1)
+            : m_solver(std::make_shared<const Solver>(Solver{std::move(dynamics), options, stateSize})) {}
+
+        [[nodiscard]] auto Forward(const std::vector<NodePtr<T>>& inputs) -> std::vector<NodePtr<T>> override {
+            if (inputs.size() < m_solver->stateSize) {
+                throw std::invalid_argument("OdeSolve: number of inputs is less than the state size");
+            }
+            return RecordOpaque<T>(
+                inputs,
+                [solver = m_solver](const NodePtrVector<T>& solveInputs) { return solver->Solve(solveInputs); },
+                [solver = m_solver](const NodePtrVector<T>& solveInputs, const std::vector<T>& solution, std::vector<T> adjoint) {
+                    solver->SolveAdjoint(solveInputs, solution, std::move(adjoint));
+                });
+        }
+
+     private:
+        using State = std::vector<T>;
+
+        /// Solver configuration, shared with the recorded nodes so that they can outlive the module.
+        struct Solver {
+            std::shared_ptr<IModule<T>> dynamics;
+            OdeOptions options;
+            size_t stateSize;
+
+            [[nodiscard]] auto Solve(const NodePtrVector<T>& inputs) const -> State {
+                NodePtrVector<T> parameters = MakeLeaves(Values(Parameters(inputs)), false);
+                auto rhs = [this, &parameters](const State& y) {
+                    NodePtrVector<T> rhsInputs = MakeLeaves(y, false);
+                    rhsInputs.insert(rhsInputs.end(), parameters.begin(), parameters.end());
+                    return Evaluate(*dynamics, rhsInputs, stateSize);
+                };
+                return Integrate(rhs, Values(NodePtrVector<T>(inputs.begin(), inputs.begin() + Offset())), options.t0, options.t1);
+            }
+
+            /// Integrates the augmented state `[y, a, a_theta]` from `t1` to `t0` and accumulates the gradients.
+            auto SolveAdjoint(const NodePtrVector<T>& inputs, const State& solution, State adjoint) const -> void {
+                const std::vector<T> parameterValues = Values(Parameters(inputs));
+                const size_t numParameters = parameterValues.size();
+
+                State augmented = solution;
+                augmented.insert(augmented.end(), std::make_move_iterator(adjoint.begin()), std::make_move_iterator(adjoint.end()));
+                for (const auto& parameter : parameterValues) {
+                    augmented.push_back(ZerosLike(parameter));
+                }
+
+                auto rhs = [this, &parameterValues, numParameters](const State& s) {
+                    NodePtrVector<T> stateLeaves = MakeLeaves(State(s.begin(), s.begin() + Offset()), true);
+                    NodePtrVector<T> parameterLeaves = MakeLeaves(parameterValues, true);
+                    NodePtrVector<T> rhsInputs = stateLeaves;
+                    rhsInputs.insert(rhsInputs.end(), parameterLeaves.begin(), parameterLeaves.end());
+
+                    State derivative = VectorJacobianProduct(*dynamics, rhsInputs, State(s.begin() + Offset(), s.begin() + 2 * Offset()));
+                    for (size_t i = 0; i < stateSize; ++i) {
+                        derivative.push_back(-1.0 * stateLeaves[i]->grad);
+                    }
+                    for (size_t i = 0; i < numParameters; ++i) {
+                        derivative.push_back(-1.0 * parameterLeaves[i]->grad);
+                    }
+                    return derivative;
+                };
+                augmented = Integrate(rhs, std::move(augmented), options.t1, options.t0);
+
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    if (inputs[i]->requiresGrad) {
+                        inputs[i]->grad += augmented[stateSize + i];
+                    }
+                }
+            }
+
+            [[nodiscard]] auto Offset() const -> std::ptrdiff_t { return static_cast<std::ptrdiff_t>(stateSize); }
+
+            [[nodiscard]] auto Parameters(const NodePtrVector<T>& inputs) const -> NodePtrVector<T> {
+                return {inputs.begin() + Offset(), inputs.end()};
+            }
+
+            template <typename Rhs>
+            [[nodiscard]] auto Integrate(const Rhs& rhs, State y, double from, double to) const -> State {
+                switch (options.method) {
+                    case OdeMethod::RK4:
+                        return IntegrateRungeKutta(rhs, std::move(y), from, to);
+                    case OdeMethod::DORMAND_PRINCE:
+                    default:
+                        return IntegrateDormandPrince(rhs, std::move(y), from, to);
+                }
+            }
+
+            template <typename Rhs>
+            [[nodiscard]] auto IntegrateRungeKutta(const Rhs& rhs, State y, double from, double to) const -> State {
+                const double h = (to - from) / static_cast<double>(options.steps);
+                for (size_t step = 0; step < options.steps; ++step) {
+                    const State k1 = rhs(y);
+                    const State k2 = rhs(Combine(y, h, {{0.5, &k1}}));
+                    const State k3 = rhs(Combine(y, h, {{0.5, &k2}}));
+                    const State k4 = rhs(Combine(y, h, {{1.0, &k3}}));
+                    y = Combine(y, h, {{1.0 / 6, &k1}, {1.0 / 3, &k2}, {1.0 / 3, &k3}, {1.0 / 6, &k4}});
+                }
+                return y;
+            }
+
+            template <typename Rhs>
+            [[nodiscard]] auto IntegrateDormandPrince(const Rhs& rhs, State y, double from, double to) const -> State {
+                constexpr double SAFETY = 0.9;
+                constexpr double MIN_FACTOR = 0.2;
+                constexpr double MAX_FACTOR = 5.0;
+                constexpr double INITIAL_FRACTION = 0.01;
+                constexpr double MIN_FRACTION = 1e-12;
+
+                const double direction = to >= from ? 1.0 : -1.0;
+                double t = from;
+                double h = INITIAL_FRACTION * (to - from);
+                const double minStep = MIN_FRACTION * std::abs(to - from);
+                State k1 = rhs(y);
+                for (size_t step = 0; direction * (to - t) > 0; ++step) {
+                    if (step == options.maxSteps) {
+                        throw std::runtime_error("OdeSolve: maximum number of steps exceeded");
+                    }
+                    h = direction * std::min(std::abs(h), std::abs(to - t));
+
+                    const State k2 = rhs(Combine(y, h, {{1.0 / 5, &k1}}));
+                    const State k3 = rhs(Combine(y, h, {{3.0 / 40, &k1}, {9.0 / 40, &k2}}));
+                    const State k4 = rhs(Combine(y, h, {{44.0 / 45, &k1}, {-56.0 / 15, &k2}, {32.0 / 9, &k3}}));
+                    const State k5 = rhs(
+                        Combine(y, h, {{19372.0 / 6561, &k1}, {-25360.0 / 2187, &k2}, {64448.0 / 6561, &k3}, {-212.0 / 729, &k4}}));
+                    const State k6 = rhs(Combine(y, h,
+                                                 {{9017.0 / 3168, &k1},
+                                                  {-355.0 / 33, &k2},
+                                                  {46732.0 / 5247, &k3},
+                                                  {49.0 / 176, &k4},
+                                                  {-5103.0 / 18656, &k5}}));
+                    State next = Combine(y, h,
+                                         {{35.0 / 384, &k1},
+                                          {500.0 / 1113, &k3},
+                                          {125.0 / 192, &k4},
+                                          {-2187.0 / 6784, &k5},
+                                          {11.0 / 84, &k6}});
+                    State k7 = rhs(next);
+
+                    // difference between the fifth and the embedded fourth order solutions
+                    const State error = Combine(ZeroState(y), h,
+                                                {{71.0 / 57600, &k1},
+                                                 {-71.0 / 16695, &k3},
+                                                 {71.0 / 1920, &k4},
+                                                 {-17253.0 / 339200, &k5},
+                                                 {22.0 / 525, &k6},
+                                                 {-1.0 / 40, &k7}});
+                    double errorRatio = 0;
+                    for (size_t i = 0; i < y.size(); ++i) {
+                        const double nextNorm = MaxNorm(next[i]);
+                        const double scale = options.absoluteTolerance + options.relativeTolerance * std::max(MaxNorm(y[i]), nextNorm);
+                        const double ratio = MaxNorm(error[i]) / scale;
+                        // std::max would drop a NaN ratio and accept the step
+                        if (!std::isfinite(nextNorm) || !std::isfinite(ratio)) {
+                            errorRatio = std::numeric_limits<double>::infinity();
+                            break;
+                        }
+                        errorRatio = std::max(errorRatio, ratio);
+                    }
+
+                    if (errorRatio <= 1) {
+                        t += h;
+                        y = std::move(next);
+                        // first same as last: the last stage is the first stage of the next step
+                        k1 = std::move(k7);
+                    }
+                    const double factor = errorRatio == 0 ? MAX_FACTOR : SAFETY * std::pow(errorRatio, -1.0 / 5);
+                    h *= std::clamp(factor, MIN_FACTOR, MAX_FACTOR);
+                    if (errorRatio > 1 && std::abs(h) < minStep) {
+                        throw std::runtime_error("OdeSolve: step size fell below the minimum, the solution is not finite");
+                    }
+                }
+                return y;
+            }
+
+            [[nodiscard]] static auto ZeroState(const State& state) -> State {
+                State zeros;
+                zeros.reserve(state.size());
+                for (const auto& component : state) {
+                    zeros.push_back(ZerosLike(component));
+                }
+                return zeros;
+            }
+
+            /// Returns `y + h * sum(c_j * k_j)`.
+            [[nodiscard]] static auto Combine(const State& y, double h, std::initializer_list<std::pair<double, const State*>> terms)
+                -> State {
+                State result = y;
+                for (const auto& [coefficient, k] : terms) {
+                    for (size_t i = 0; i < result.size(); ++i) {
+                        result[i] += static_cast<T>((h * coefficient) * (*k)[i]);
+                    }
+                }
+                return result;
+            }
+        };
+
+        std::shared_ptr<const Solver> m_solver;
+    };
+
+}  // namespace auto_diff
@@ -0,0 +1,263 @@
+/**
+ * @file Offload.hpp
+ * @brief Saved activations spilled to a scratch file and prefetched during backpropagation.
+ *
+ * `FileOffloadCodec` is a `SavedDataCodec` (see SavedData.hpp) that moves packed `Matrix<S>` data to an unlinked
+ * scratch file instead of compressing it in memory. Writes are queued to a background I/O thread, so the caller continues
+ * while the data is being written, and the memory of queued writes is bounded by `maxPendingBytes`. During
+ * `Node::Backpropagate` the data of the next `Node::PREFETCH_DISTANCE` nodes is read in the background before the
+ * backward functions need it.
+ *
+ * Usage:
+ * \code
+ *     auto offload = std::make_shared<FileOffloadCodec<float>>(OffloadOptions{.directory = "/scratch"});
+ *     CompressSaved<Matrix<float>> layer(std::make_shared<Layer>(), offload);  // for every layer
+ *     auto loss = ...;
+ *     PackSavedData<Matrix<float>>({loss});  // activations are written to the file
+ *     loss->Backward();                       // and read back ahead of the reverse sweep
+ * \endcode
+ *
+ * Space of the file is reused once all offloaded data has been unpacked or dropped, so the file doesn't grow across
+ * training steps.
+ *
+ * @note The file goes through the page cache, the kernel evicts written pages under memory pressure. Written ranges are
+ * advised as not needed to let it evict them early.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    struct OffloadOptions {
+        /// Directory of the scratch file, a local disk is preferable.
+        std::filesystem::path directory{std::filesystem::temp_directory_path()};
+        /// Memory held by queued writes, `Pack` blocks while it is exceeded.
+        size_t maxPendingBytes{size_t{256} << 20};
+    };
+
+    namespace detail {
+
+        /**
+         * @class ScratchFile
+         * @brief Unlinked temporary file with a single I/O thread executing requests in submission order.
+         */
+        class ScratchFile {
+         public:
+            explicit ScratchFile(const OffloadOptions& options) : m_maxPendingBytes(options.maxPendingBytes) {
+                std::string path = (options.directory / "auto_diff_offload_XXXXXX").string();
+                m_fd = ::mkstemp(path.data());
+                if (m_fd < 0) {
+                    const std::string message = "ScratchFile: can't create a file in " + options.directory.string();
+                    throw std::system_error(errno, std::generic_category(), message);
+                }
+                ::unlink(path.c_str());
+                m_worker = std::thread([this]() { Run(); });
+            }
+
+            ScratchFile(const ScratchFile&) = delete;
+            auto operator=(const ScratchFile&) -> ScratchFile& = delete;
+
+            /// Finishes the queued requests.
+            ~ScratchFile() {
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_stop = true;
+                }
+                m_changed.notify_all();
+                m_worker.join();
+                ::close(m_fd);
+            }
+
+            /// Reserves `bytes` at the end of the file. The space is reused after every allocation has been released.
+            [[nodiscard]] auto Allocate(size_t bytes) -> off_t {
+                std::lock_guard lock(m_mutex);
+                const auto offset = static_cast<off_t>(m_end);
+                m_end += bytes;
+                ++m_allocations;
+                return offset;
+            }
+
+            auto Release() -> void {
+                std::lock_guard lock(m_mutex);
+                if (--m_allocations == 0) {
+                    // requests are executed in order, so pending writes of released data finish before new ones
+                    m_end = 0;
+                }
+            }
+
+            [[nodiscard]] auto BytesInUse() const -> size_t {
+                std::lock_guard lock(m_mutex);
+                return m_end;
+            }
+
+            /// Queues `request` holding `pendingBytes` of memory until it is executed.
+            auto Submit(std::function<void()> request, size_t pendingBytes = 0) -> void {
+                std::unique_lock lock(m_mutex);
+                m_changed.wait(lock, [&]() { return m_pendingBytes == 0 || m_pendingBytes + pendingBytes <= m_maxPendingBytes; });
+                m_pendingBytes += pendingBytes;
+                m_requests.emplace_back(std::move(request), pendingBytes);
+                m_changed.notify_all();
+            }
+
+            auto Write(const void* data, size_t bytes, off_t offset) const -> void {
+                const auto* begin = static_cast<const char*>(data);
+                for (size_t done = 0; done < bytes;) {
+                    const ssize_t written = ::pwrite(m_fd, begin + done, bytes - done, offset + static_cast<off_t>(done));
+                    if (written == 0 || (written < 0 && errno != EINTR)) {
+                        throw std::system_error(written == 0 ? EIO : errno, std::generic_category(), "ScratchFile: write failed");
+                    }
+                    done += written > 0 ? static_cast<size_t>(written) : 0;
+                }
+                ::posix_fadvise(m_fd, offset, static_cast<off_t>(bytes), POSIX_FADV_DONTNEED);
+            }
+
+            auto Read(void* data, size_t bytes, off_t offset) const -> void {
+                auto* begin = static_cast<char*>(data);
+                for (size_t done = 0; done < bytes;) {
+                    const ssize_t read = ::pread(m_fd, begin + done, bytes - done, offset + static_cast<off_t>(done));
+                    if (read == 0 || (read < 0 && errno != EINTR)) {
+                        throw std::system_error(read == 0 ? EIO : errno, std::generic_category(), "ScratchFile: read failed");
+                    }
+                    done += read > 0 ? static_cast<size_t>(read) : 0;
+                }
+            }
+
+         private:
+            int m_fd{-1};
+            size_t m_maxPendingBytes;
+            mutable std::mutex m_mutex;
+            std::condition_variable m_changed;
+            std::deque<std::pair<std::function<void()>, size_t>> m_requests;
+            size_t m_pendingBytes{0};
+            size_t m_end{0};
+            size_t m_allocations{0};
+            bool m_stop{false};
+            std::thread m_worker;
+
+            auto Run() -> void {
+                std::unique_lock lock(m_mutex);
+                while (true) {
+                    m_changed.wait(lock, [this]() { return m_stop || !m_requests.empty(); });
+                    if (m_requests.empty()) return;
+                    auto [request, pendingBytes] = std::move(m_requests.front());
+                    m_requests.pop_front();
+                    lock.unlock();
+                    request();
+                    request = nullptr;
+                    lock.lock();
+                    m_pendingBytes -= pendingBytes;
+                    m_changed.notify_all();
+                }
+            }
+        };
+
+    }  // namespace detail
+
+    /**
+     * @class FileOffloadCodec
+     * @brief Stores packed `Matrix<S>` data in a scratch file, losslessly.
+     *
+     * @tparam S Trivially copyable element type
+     */
+    template <typename S>
+    class FileOffloadCodec : public SavedDataCodec<Matrix<S>> {
+     public:
+        explicit FileOffloadCodec(const OffloadOptions& options = {}) : m_file(std::make_shared<detail::ScratchFile>(options)) {}
+
+        [[nodiscard]] auto Pack(Matrix<S>& data) const -> PackedData<Matrix<S>> override {
+            auto record = std::make_shared<Record>(m_file, data.rows, data.cols, data.values.size());
+            const size_t bytes = record->size * sizeof(S);
+            auto values = std::make_shared<std::vector<S>>(std::move(data.values));
+            data = Matrix<S>();
+
+            auto written = std::make_shared<std::promise<void>>();
+            record->written = written->get_future();
+            m_file->Submit(
+                [file = m_file.get(), values = std::move(values), written, bytes, offset = record->offset]() mutable {
+                    try {
+                        file->Write(values->data(), bytes, offset);
+                        written->set_value();
+                    } catch (...) {
+                        written->set_exception(std::current_exception());
+                    }
+                    values.reset();
+                },
+                bytes);
+
+            return {.unpack =
+                        [record](Matrix<S>& restored) {
+                            record->Prefetch();
+                            record->written.get();
+                            restored = Matrix<S>(record->rows, record->cols, record->loaded.get());
+                        },
+                    .prefetch = [record]() { record->Prefetch(); }};
+        }
+
+        /// Size of the scratch file currently holding offloaded data.
+        [[nodiscard]] auto BytesInUse() const -> size_t { return m_file->BytesInUse(); }
+
+     private:
+        /// Offloaded data of one node. Destroyed on the caller's thread after its requests have finished.
+        struct Record {
+            std::shared_ptr<detail::ScratchFile> file;
+            size_t rows;
+            size_t cols;
+            size_t size;
+            off_t offset;
+            std::future<void> written;
+            std::future<std::vector<S>> loaded;
+
+            Record(std::shared_ptr<detail::ScratchFile> scratchFile, size_t numRows, size_t numCols, size_t numValues)
+                : file(std::move(scratchFile)), rows(numRows), cols(numCols), size(numValues), offset(file->Allocate(size * sizeof(S))) {}
+
+            Record(const Record&) = delete;
+            auto operator=(const Record&) -> Record& = delete;
+
+            ~Record() {
+                if (written.valid()) written.wait();
+                if (loaded.valid()) loaded.wait();
+                file->Release();
+            }
+
+            /// Queues the read once, after the write.
+            auto Prefetch() -> void {
+                if (loaded.valid()) return;
+                auto promise = std::make_shared<std::promise<std::vector<S>>>();
+                loaded = promise->get_future();
+                file->Submit([this, promise]() {
+                    try {
+                        std::vector<S> values(size);
+                        file->Read(values.data(), size * sizeof(S), offset);
+                        promise->set_value(std::move(values));
+                    } catch (...) {
+                        promise->set_exception(std::current_exception());
+                    }
+                });
+            }
+        };
+
+        std::shared_ptr<detail::ScratchFile> m_file;
+    };
+
+}  // namespace auto_diff
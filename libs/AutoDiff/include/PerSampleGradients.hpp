@@ -0,0 +1,178 @@
+/**
+ * @file PerSampleGradients.hpp
+ * @brief Per-sample gradients, their norms and clipped sums for differentially private training.
+ *
+ * In a graph on `Node<Lanes<S, N>>` the lanes of the inputs hold different samples and the parameters are broadcast to
+ * all lanes. Backends work lane by lane and never reduce across lanes, so after one `Backward` the lanes of every
+ * parameter's `grad` are the gradients of the individual samples: `N` per-sample gradients for the cost of one backward
+ * pass.
+ *
+ * DP-SGD needs only the sum of the per-sample gradients clipped to a maximum norm. `ClipAndAccumulate` computes the norms,
+ * clips and adds the chunk of `N` samples to a running sum, so a batch of `B` samples is processed in chunks and only `N`
+ * per-sample gradients exist at a time instead of `B`.
+ *
+ * Usage:
+ * \code
+ *     using Chunk = Lanes<double, 8>;
+ *     std::vector<double> weights = ...;  // current parameter values
+ *     std::vector<double> clippedSum(params.size());
+ *     for (size_t i = 0; i < batchSize; i += Chunk::size) {
+ *         for (size_t j = 0; j < params.size(); ++j) {
+ *             params[j]->data = Chunk(weights[j]);  // broadcast the current parameters
+ *         }
+ *         ...;  // load samples [i, i + 8) into the input lanes
+ *         graph.Forward();
+ *         loss->Backward();
+ *         ClipAndAccumulate(params, maxNorm, clippedSum, std::min(Chunk::size, batchSize - i));
+ *     }
+ *     // add noise to clippedSum and take a step
+ * \endcode
+ *
+ * Matrix models keep the batch in the rows instead: `y = x w` recorded with `MatMul` has one sample per row of `x`. The
+ * gradient of `w` for sample `b` is the outer product of row `b` of `x` and row `b` of `y`'s gradient, so after one
+ * `Backward` of the summed loss `ClipAndAccumulateMatMul` gets the per-sample norms from the row norms and the clipped
+ * sum from one reweighted product `x^T diag(scales) dy`, without forming the `B` outer products.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "Lanes.hpp"
+#include "Matrix.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @brief Euclidean norm of every sample's gradient over all parameters.
+     *
+     * @param params Parameters whose `grad` holds per-sample gradients in lanes
+     */
+    template <typename S, size_t N>
+    [[nodiscard]] auto PerSampleNorms(const NodePtrVector<Lanes<S, N>>& params) -> Lanes<S, N> {
+        Lanes<S, N> squaredNorms(S{0});
+        for (const auto& param : params) {
+            squaredNorms += param->grad * param->grad;
+        }
+        return sqrt(squaredNorms);
+    }
+
+    /**
+     * @brief Clips every sample's gradient to `maxNorm` and adds it to `sum`.
+     *
+     * Sample `l` is scaled by `min(1, maxNorm / norm_l)`.
+     *
+     * @param params Parameters whose `grad` holds per-sample gradients in lanes
+     * @param maxNorm Maximum norm of a sample's gradient
+     * @param sum Clipped gradient sum, one value per parameter
+     * @param activeLanes Number of lanes holding samples, the rest are ignored (e.g. in the last chunk of a batch), even if
+     * they hold Inf or NaN
+     * @return Norms of the per-sample gradients before clipping, zero for inactive lanes
+     */
+    template <typename S, size_t N>
+    auto ClipAndAccumulate(const NodePtrVector<Lanes<S, N>>& params, S maxNorm, std::vector<S>& sum, size_t activeLanes = N)
+        -> Lanes<S, N> {
+        if (sum.size() != params.size()) {
+            throw std::invalid_argument("ClipAndAccumulate: sum size doesn't match the number of parameters");
+        }
+        const size_t active = std::min(activeLanes, N);
+        Lanes<S, N> norms(S{0});
+        if (active == N) {
+            norms = PerSampleNorms(params);
+        } else {
+            for (size_t lane = 0; lane < active; ++lane) {
+                S squaredNorm{0};
+                for (const auto& param : params) {
+                    squaredNorm += param->grad[lane] * param->grad[lane];
+                }
+                norms[lane] = std::sqrt(squaredNorm);
+            }
+        }
+        Lanes<S, N> scales(S{0});
+        for (size_t lane = 0; lane < active; ++lane) {
+            scales[lane] = norms[lane] > maxNorm ? maxNorm / norms[lane] : S{1};
+        }
+        for (size_t i = 0; i < params.size(); ++i) {
+            for (size_t lane = 0; lane < active; ++lane) {
+                sum[i] += params[i]->grad[lane] * scales[lane];
+            }
+        }
+        return norms;
+    }
+
+    /**
+     * @brief Clips the per-sample gradients of the weights of `MatMul` layers to `maxNorm` and adds them to `sums`.
+     *
+     * Every layer is the output `y = x w` of a `MatMul` call, `x` has one sample per row and `w` is a parameter used by
+     * this layer only. `grad` of the layers must come from one `Backward` of a loss summed over samples, so that row `b` of
+     * `y`'s gradient depends on sample `b` only. The gradient of sample `b` has the squared norm
+     * `sum over layers |x_b|^2 |dy_b|^2` and is scaled by `min(1, maxNorm / norm_b)`.
+     *
+     * @param layers Outputs of the `MatMul` calls
+     * @param maxNorm Maximum norm of a sample's gradient over all layers
+     * @param sums Clipped gradient sums, one matrix shaped like `w` per layer, empty matrices are initialized with zeros
+     * @return Norms of the per-sample gradients before clipping
+     */
+    template <typename S>
+    auto ClipAndAccumulateMatMul(const NodePtrVector<Matrix<S>>& layers, S maxNorm, std::vector<Matrix<S>>& sums) -> std::vector<S> {
+        if (sums.size() != layers.size()) {
+            throw std::invalid_argument("ClipAndAccumulateMatMul: sums size doesn't match the number of layers");
+        }
+        if (layers.empty()) {
+            return {};
+        }
+        const size_t batchSize = layers[0]->grad.rows;
+        std::vector<S> squaredNorms(batchSize, S{0});
+        for (const auto& layer : layers) {
+            const Matrix<S>& x = layer->parents.at(0)->data;
+            const Matrix<S>& g = layer->grad;
+            if (x.rows != batchSize || g.rows != batchSize) {
+                throw std::invalid_argument("ClipAndAccumulateMatMul: layers have different batch sizes");
+            }
+            for (size_t b = 0; b < batchSize; ++b) {
+                S xNorm{0};
+                for (size_t k = 0; k < x.cols; ++k) {
+                    xNorm += x(b, k) * x(b, k);
+                }
+                S gNorm{0};
+                for (size_t j = 0; j < g.cols; ++j) {
+                    gNorm += g(b, j) * g(b, j);
+                }
+                squaredNorms[b] += xNorm * gNorm;
+            }
+        }
+
+        std::vector<S> norms(batchSize);
+        std::vector<S> scales(batchSize);
+        for (size_t b = 0; b < batchSize; ++b) {
+            norms[b] = std::sqrt(squaredNorms[b]);
+            scales[b] = norms[b] > maxNorm ? maxNorm / norms[b] : S{1};
+        }
+        for (size_t l = 0; l < layers.size(); ++l) {
+            const Matrix<S>& x = layers[l]->parents[0]->data;
+            const Matrix<S>& g = layers[l]->grad;
+            Matrix<S>& sum = sums[l];
+            if (sum.values.empty()) {
+                sum = Matrix<S>(x.cols, g.cols);
+            } else if (sum.rows != x.cols || sum.cols != g.cols) {
+                throw std::invalid_argument("ClipAndAccumulateMatMul: sum isn't shaped like the weight");
+            }
+            // sum += x^T diag(scales) g
+            for (size_t b = 0; b < batchSize; ++b) {
+                for (size_t k = 0; k < x.cols; ++k) {
+                    const S weight = scales[b] * x(b, k);
+                    for (size_t j = 0; j < g.cols; ++j) {
+                        sum(k, j) += weight * g(b, j);
+                    }
+                }
+            }
+        }
+        return norms;
+    }
+
+}  // namespace auto_diff
@@ -0,0 +1,320 @@
+/**
+ * @file Quantization.hpp
+ * @brief Post-training int8 quantization of `MatMul` weights and the `Int8Backend` for inference.
+ *
+ * `QuantizeWeights` converts every weight matrix to int8 with one scale per output channel (column). The clipping
+ * threshold of every channel is calibrated on the weights: the maximum absolute value, or the threshold that minimizes
+ * the mean squared quantization error, which trades clipping a few outliers for a finer resolution of the rest.
+ *
+ * `Int8Backend` is a drop-in replacement of `MatrixBackend<float>`. For quantized weights `MatMul` quantizes every row of
+ * the activations symmetrically on the fly, computes int8 dot products with int32 accumulation and rescales the result.
+ * The dot product uses AVX2 when the CPU supports it. Element-wise modules stay in float: they are bound by memory, and
+ * the activations between modules are float anyway.
+ *
+ * Usage:
+ * \code
+ *     template <typename Backend>
+ *     auto Model(...);                            // uses MatMul<Matrix<float>, Backend> and Elemwise* modules
+ *
+ *     QuantizeWeights({w1, w2});                  // once, after training
+ *     auto y = Model<Int8Backend>(x, w1, w2);    // instead of Model<MatrixBackend<float>>
+ * \endcode
+ *
+ * @note The backend is inference-only: backward through a quantized `MatMul` throws `std::logic_error`.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AUTO_DIFF_INT8_AVX2
+#endif
+
+#include "Matrix.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /// Int8 weights with a scale per output channel, `weight(k, j) ~ weights[j * rows + k] * scales[j]`.
+    struct QuantizedMatrix {
+        size_t rows{0};
+        size_t cols{0};
+        /// Weights of every output channel (column of the original matrix) stored contiguously.
+        std::vector<int8_t> weights;
+        std::vector<float> scales;
+    };
+
+    enum class CalibrationMethod {
+        /// Threshold is the maximum absolute value, nothing is clipped
+        MAX_ABS,
+        /// Threshold minimizes the mean squared quantization error
+        MIN_MSE
+    };
+
+    struct QuantizationOptions {
+        CalibrationMethod calibration{CalibrationMethod::MIN_MSE};
+        /// Number of thresholds tried by `MIN_MSE` between `minClipFraction` and one of the maximum absolute value.
+        size_t searchSteps{64};
+        float minClipFraction{0.5F};
+    };
+
+    namespace detail {
+
+        constexpr float INT8_LIMIT = 127.0F;
+
+        /// Rounds `value * inverseScale` to the int8 range. Non-finite values (and NaN products) are mapped to zero.
+        [[nodiscard]] inline auto QuantizeValue(float value, float inverseScale) -> int8_t {
+            const float scaled = std::nearbyint(value * inverseScale);
+            if (!std::isfinite(value) || std::isnan(scaled)) {
+                return 0;
+            }
+            return static_cast<int8_t>(std::clamp(scaled, -INT8_LIMIT, INT8_LIMIT));
+        }
+
+        [[nodiscard]] inline auto DotInt8Scalar(const int8_t* a, const int8_t* b, size_t size) -> int32_t {
+            int32_t sum = 0;
+            for (size_t i = 0; i < size; ++i) {
+                sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+            }
+            return sum;
+        }
+
+#ifdef AUTO_DIFF_INT8_AVX2
+        /// Sign-extends 16 pairs to int16 and multiplies them with `vpmaddwd`, which adds adjacent products into int32.
+        __attribute__((target("avx2"))) inline auto DotInt8Avx2(const int8_t* a, const int8_t* b, size_t size) -> int32_t {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                const __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+                const __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+            }
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            sum = _mm_hadd_epi32(sum, sum);
+            sum = _mm_hadd_epi32(sum, sum);
+            return _mm_cvtsi128_si32(sum) + DotInt8Scalar(a + i, b + i, size - i);
+        }
+#endif
+
+        /// Int8 dot product with int32 accumulation, dispatched to the best implementation supported by the CPU.
+        [[nodiscard]] inline auto DotInt8(const int8_t* a, const int8_t* b, size_t size) -> int32_t {
+#ifdef AUTO_DIFF_INT8_AVX2
+            static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+            if (hasAvx2) {
+                return DotInt8Avx2(a, b, size);
+            }
+#endif
+            return DotInt8Scalar(a, b, size);
+        }
+
+        /// Threshold of one channel given by `count` values with `stride`.
+        [[nodiscard]] inline auto CalibrateThreshold(const float* values, size_t count, size_t stride, const QuantizationOptions& options)
+            -> float {
+            float maxAbs = 0;
+            for (size_t i = 0; i < count; ++i) {
+                maxAbs = std::max(maxAbs, std::abs(values[i * stride]));
+            }
+            if (maxAbs == 0 || options.calibration == CalibrationMethod::MAX_ABS || options.searchSteps == 0) {
+                return maxAbs;
+            }
+
+            float bestThreshold = maxAbs;
+            double bestError = -1;
+            for (size_t step = 0; step <= options.searchSteps; ++step) {
+                const float position = static_cast<float>(step) / static_cast<float>(options.searchSteps);
+                const float fraction = options.minClipFraction + (1 - options.minClipFraction) * position;
+                const float threshold = fraction * maxAbs;
+                const float scale = threshold / INT8_LIMIT;
+                double error = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    const float value = values[i * stride];
+                    const double difference = value - QuantizeValue(value, 1 / scale) * scale;
+                    error += difference * difference;
+                }
+                if (bestError < 0 || error < bestError) {
+                    bestError = error;
+                    bestThreshold = threshold;
+                }
+            }
+            return bestThreshold;
+        }
+
+    }  // namespace detail
+
+    /**
+     * @brief Quantizes a `K x N` weight matrix with one scale per column.
+     *
+     * @throws std::invalid_argument if a weight is not finite
+     */
+    [[nodiscard]] inline auto Quantize(const Matrix<float>& w, const QuantizationOptions& options = {}) -> QuantizedMatrix {
+        if (!std::ranges::all_of(w.values, [](float value) { return std::isfinite(value); })) {
+            throw std::invalid_argument("Quantize: weights must be finite");
+        }
+        QuantizedMatrix q{w.rows, w.cols, std::vector<int8_t>(w.rows * w.cols), std::vector<float>(w.cols)};
+        for (size_t j = 0; j < w.cols; ++j) {
+            const float threshold = detail::CalibrateThreshold(w.values.data() + j, w.rows, w.cols, options);
+            const float scale = threshold > 0 ? threshold / detail::INT8_LIMIT : 1.0F;
+            q.scales[j] = scale;
+            for (size_t k = 0; k < w.rows; ++k) {
+                q.weights[j * w.rows + k] = detail::QuantizeValue(w(k, j), 1 / scale);
+            }
+        }
+        return q;
+    }
+
+    /**
+     * @brief Stores int8 copies of the weight matrices in `Int8Backend`, the float values are kept.
+     *
+     * The copies are taken from the current values: call it again after changing the weights. It may run concurrently with
+     * inference, calls that have already looked up a weight keep using its previous copy.
+     */
+    inline auto QuantizeWeights(const NodePtrVector<Matrix<float>>& weights, const QuantizationOptions& options = {}) -> void;
+
+    /**
+     * @class Int8Backend
+     * @brief Backend of `MatMul` and the element-wise modules running quantized weights with int8 dot products.
+     *
+     * The int8 copies are kept by the backend per weight node, so the `Matrix` values stay plain floats for other backends.
+     * Weights without an int8 copy are multiplied in float. The table of copies is global: one per process, shared by all
+     * models and threads and guarded by a reader-writer lock. A copy outlives its weight node until the entry is erased,
+     * which `QuantizeWeights` and every `PRUNE_INTERVAL`-th lookup do for all freed weights.
+     */
+    class Int8Backend : public MatrixBackend<float> {
+     public:
+        static auto MatMulForward(const std::vector<NodePtr<Matrix<float>>>& inputs, std::vector<NodePtr<Matrix<float>>>& outputs)
+            -> void {
+            const auto quantized = Quantized(inputs[1]);
+            outputs.push_back(std::make_shared<NodeType>(quantized ? Multiply(inputs[0]->data, *quantized)
+                                                                   : MatrixBackend<float>::Multiply(inputs[0]->data, inputs[1]->data)));
+        }
+
+        static auto MatMulBackward(const std::vector<NodePtr<Matrix<float>>>& inputs, NodeType* output, size_t outputIdx) -> void {
+            if (Quantized(inputs[1])) {
+                throw std::logic_error("Int8Backend: quantized MatMul is inference-only");
+            }
+            MatrixBackend<float>::MatMulBackward(inputs, output, outputIdx);
+        }
+
+        /// Batched `MatMul`, the stacked rows of all `x` are multiplied by every quantized weight at once.
+        static auto MatMulForwardBatch(const std::vector<NodeType*>& outputs) -> void {
+            for (const auto& [w, group] : GroupByWeight(outputs)) {
+                const auto quantized = Quantized(group.front()->parents[1]);
+                ScatterRows(group, quantized ? Multiply(StackInputs(group), *quantized)
+                                             : MatrixBackend<float>::Multiply(StackInputs(group), w->data));
+            }
+        }
+
+        static auto MatMulBackwardBatch(const std::vector<NodeType*>& outputs) -> void {
+            for (NodeType* output : outputs) {
+                if (Quantized(output->parents[1])) {
+                    throw std::logic_error("Int8Backend: quantized MatMul is inference-only");
+                }
+            }
+            MatrixBackend<float>::MatMulBackwardBatch(outputs);
+        }
+
+        /// Multiplies float activations by int8 weights, quantizing every row of the activations with its own scale. A row with a
+        /// non-finite activation gives a row of NaN, as the float product would propagate it.
+        [[nodiscard]] static auto Multiply(const Matrix<float>& x, const QuantizedMatrix& w) -> Matrix<float> {
+            if (x.cols != w.rows) {
+                throw std::invalid_argument("MatMul: inner dimensions don't match");
+            }
+            Matrix<float> y(x.rows, w.cols);
+            std::vector<int8_t> row(x.cols);
+            for (size_t i = 0; i < x.rows; ++i) {
+                float maxAbs = 0;
+                bool finite = true;
+                for (size_t k = 0; k < x.cols && finite; ++k) {
+                    finite = std::isfinite(x(i, k));
+                    maxAbs = std::max(maxAbs, std::abs(x(i, k)));
+                }
+                if (!finite) {
+                    const auto rowBegin = y.values.begin() + static_cast<std::ptrdiff_t>(i * y.cols);
+                    std::fill_n(rowBegin, y.cols, std::numeric_limits<float>::quiet_NaN());
+                    continue;
+                }
+                if (maxAbs == 0) {
+                    continue;
+                }
+                const float scale = maxAbs / detail::INT8_LIMIT;
+                for (size_t k = 0; k < x.cols; ++k) {
+                    row[k] = detail::QuantizeValue(x(i, k), 1 / scale);
+                }
+                for (size_t j = 0; j < w.cols; ++j) {
+                    const int32_t dot = detail::DotInt8(row.data(), w.weights.data() + j * w.rows, w.rows);
+                    y(i, j) = static_cast<float>(dot) * scale * w.scales[j];
+                }
+            }
+            return y;
+        }
+
+        /// Number of lookups between two erasures of the copies of freed weights.
+        static constexpr size_t PRUNE_INTERVAL = 1024;
+
+        /// Int8 copy of `weight` taken by the last `QuantizeWeights`, `nullptr` if there is none.
+        [[nodiscard]] static auto Quantized(const NodePtr<Matrix<float>>& weight) -> std::shared_ptr<const QuantizedMatrix> {
+            if (s_lookups.fetch_add(1, std::memory_order_relaxed) % PRUNE_INTERVAL == PRUNE_INTERVAL - 1) {
+                // skipped while another thread holds the lock, so that lookups never wait for a pruning
+                std::unique_lock lock(s_mutex, std::try_to_lock);
+                if (lock.owns_lock()) {
+                    PruneExpired();
+                }
+            }
+            std::shared_lock lock(s_mutex);
+            const auto it = s_quantized.find(weight);
+            return it != s_quantized.end() ? it->second : nullptr;
+        }
+
+        /// Number of entries in the table, including copies of freed weights that have not been erased yet.
+        [[nodiscard]] static auto QuantizedCount() -> size_t {
+            std::shared_lock lock(s_mutex);
+            return s_quantized.size();
+        }
+
+     private:
+        friend auto QuantizeWeights(const NodePtrVector<Matrix<float>>& weights, const QuantizationOptions& options) -> void;
+
+        /**
+         * Keyed by the ownership of the weight node rather than its address: an entry of a freed node keeps its control block
+         * alive, so it never matches a node allocated later at the same address. The copies are shared, so that a lookup
+         * stays valid when the weight is quantized again. Guarded by `s_mutex`.
+         */
+        static inline std::map<std::weak_ptr<const NodeType>, std::shared_ptr<const QuantizedMatrix>, std::owner_less<>> s_quantized;
+        static inline std::shared_mutex s_mutex;
+        static inline std::atomic<size_t> s_lookups{0};
+
+        /// Erases the copies of freed weights, `s_mutex` must be held exclusively.
+        static auto PruneExpired() -> void {
+            std::erase_if(s_quantized, [](const auto& entry) { return entry.first.expired(); });
+        }
+    };
+
+    inline auto QuantizeWeights(const NodePtrVector<Matrix<float>>& weights, const QuantizationOptions& options) -> void {
+        // quantized before taking the lock, so that inference is blocked only by the table update
+        std::vector<std::shared_ptr<const QuantizedMatrix>> quantized;
+        quantized.reserve(weights.size());
+        for (const auto& weight : weights) {
+            quantized.push_back(std::make_shared<const QuantizedMatrix>(Quantize(weight->data, options)));
+        }
+        std::unique_lock lock(Int8Backend::s_mutex);
+        Int8Backend::PruneExpired();
+        for (size_t i = 0; i < weights.size(); ++i) {
+            Int8Backend::s_quantized.insert_or_assign(weights[i], std::move(quantized[i]));
+        }
+    }
+
+}  // namespace auto_diff
@@ -0,0 +1,230 @@
+/**
+ * @file SavedData.hpp
+ * @brief Compressed storage of activations that are kept only for the backward pass.
+ *
+ * Every module keeps its inputs alive until backward, so the activations of the whole forward pass are held in full
+ * precision. Wrapping a module in `CompressSaved` declares that its backward tolerates compressed inputs and outputs.
+ * After the forward pass `PackSavedData` compresses every intermediate node whose producer is wrapped and whose consumers
+ * all agreed on the same codec, and releases its storage. Backpropagation decompresses a node right before the backward
+ * functions read it, the node's own backward first, so a producer reading its output (e.g. `ElemwiseDiv`) must not be
+ * wrapped unless it tolerates the codec of the consumers.
+ *
+ * Codecs for `Matrix<S>`:
+ * - `HalfPrecisionCodec` stores 16-bit floats, half the memory of `float`.
+ * - `Int8Codec` stores int8 with one scale per matrix, a quarter of the memory of `float`.
+ * - `SignMaskCodec` stores one bit per element telling whether it is positive, enough for backward functions that only
+ *   test the sign, e.g. ReLU.
+ *
+ * Usage:
+ * \code
+ *     auto mask = std::make_shared<SignMaskCodec<float>>();
+ *     CompressSaved<Matrix<float>> relu(std::make_shared<Relu<Matrix<float>, Backend>>(), mask);
+ *     auto loss = ...;                // forward pass using `relu` and other modules
+ *     PackSavedData<Matrix<float>>({loss});
+ *     loss->Backward();
+ * \endcode
+ *
+ * @note Leaves (inputs and parameters) and the roots are never packed. Unpacked `data` of a lossy codec stays lossy; replays
+ * with `Graph::Forward` or `Recompute` overwrite it with exact values.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Float16.hpp"
+#include "IModule.hpp"
+#include "Matrix.hpp"
+#include "Node.hpp"
+#include "Quantization.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class CompressSaved
+     * @brief Runs a module and lets its inputs be stored with `codec` until backward.
+     *
+     * An input is packed only if all its consumers are wrapped with the same codec object. The outputs of the wrapped
+     * module are recorded on the input, so consumers are matched by identity. The outputs themselves are marked as
+     * compressible by their producer, which is required to pack them as inputs of other wrapped modules.
+     */
+    template <NodeT T>
+    class CompressSaved : public IModule<T> {
+     public:
+        CompressSaved(std::shared_ptr<IModule<T>> module, std::shared_ptr<const SavedDataCodec<T>> codec)
+            : m_module(std::move(module)), m_codec(std::move(codec)) {}
+
+        [[nodiscard]] auto Forward(const std::vector<NodePtr<T>>& inputs) -> std::vector<NodePtr<T>> override {
+            std::vector<NodePtr<T>> outputs = m_module->Forward(inputs);
+            for (const auto& input : inputs) {
+                auto& consumers = input->compressingConsumers;
+                // the newest consumers are the most likely to be alive, e.g. those of the current step for a parameter
+                const bool hasLiveConsumer = std::any_of(consumers.rbegin(), consumers.rend(), [](const std::weak_ptr<Node<T>>& output) {
+                    return !output.expired();
+                });
+                if (!hasLiveConsumer) {
+                    consumers.clear();
+                    input->savedDataCodec = m_codec;
+                } else if (input->savedDataCodec != m_codec) {
+                    input->savedDataCodec = nullptr;
+                }
+                for (const auto& output : outputs) {
+                    Node<T>::AppendLink(consumers, output);
+                }
+            }
+            for (const auto& output : outputs) {
+                output->compressibleByProducer = true;
+            }
+            return outputs;
+        }
+
+     private:
+        std::shared_ptr<IModule<T>> m_module;
+        std::shared_ptr<const SavedDataCodec<T>> m_codec;
+    };
+
+    namespace detail {
+
+        /**
+         * @brief Whether every consumer of `node` is an output of a consumer that accepted its compressed `data`.
+         *
+         * @param graphConsumers Consumers of `node` in the graph being packed, other consumers are known from `children`
+         */
+        template <NodeT T>
+        auto AllConsumersCompress(const Node<T>& node, const std::vector<const Node<T>*>& graphConsumers) -> bool {
+            std::unordered_set<const Node<T>*> compressing;
+            for (const auto& consumer : node.compressingConsumers) {
+                if (auto output = consumer.lock()) {
+                    compressing.insert(output.get());
+                }
+            }
+            return std::ranges::all_of(graphConsumers, [&compressing](const Node<T>* output) { return compressing.contains(output); }) &&
+                   std::ranges::all_of(node.children, [&compressing](const std::weak_ptr<Node<T>>& child) {
+                       const auto output = child.lock();
+                       return !output || compressing.contains(output.get());
+                   });
+        }
+
+    }  // namespace detail
+
+    /**
+     * @brief Compresses the intermediate nodes of the graph of `roots` accepted by their producers and all their consumers.
+     *
+     * Call it after the forward pass, when nothing but backward reads the activations. Consumers outside of the graph of
+     * `roots` are taken into account only if the graph was built inside a `ReplayRecordingScope`.
+     *
+     * @return Number of packed nodes
+     */
+    template <NodeT T>
+    auto PackSavedData(const NodePtrVector<T>& roots) -> size_t {
+        std::unordered_map<Node<T>*, std::vector<const Node<T>*>> consumers;
+        std::vector<Node<T>*> nodes;
+        std::vector<Node<T>*> stack;
+        for (const auto& root : roots) {
+            if (consumers.try_emplace(root.get()).second) {
+                stack.push_back(root.get());
+            }
+        }
+        const std::unordered_set<Node<T>*> rootSet(stack.begin(), stack.end());
+        while (!stack.empty()) {
+            Node<T>* node = stack.back();
+            stack.pop_back();
+            nodes.push_back(node);
+            for (const auto& parent : node->parents) {
+                auto [it, inserted] = consumers.try_emplace(parent.get());
+                it->second.push_back(node);
+                if (inserted) {
+                    stack.push_back(parent.get());
+                }
+            }
+        }
+
+        size_t packed = 0;
+        for (Node<T>* node : nodes) {
+            if (rootSet.contains(node) || node->parents.empty() || !node->compressibleByProducer || !node->savedDataCodec ||
+                node->packed.unpack) {
+                continue;
+            }
+            std::erase_if(node->children, [](const std::weak_ptr<Node<T>>& child) { return child.expired(); });
+            if (detail::AllConsumersCompress(*node, consumers[node])) {
+                node->packed = node->savedDataCodec->Pack(node->data);
+                ++packed;
+            }
+        }
+        return packed;
+    }
+
+    /// Stores `Matrix<S>` in a 16-bit floating point format.
+    template <typename S, typename Storage = Float16>
+    class HalfPrecisionCodec : public SavedDataCodec<Matrix<S>> {
+     public:
+        [[nodiscard]] auto Pack(Matrix<S>& data) const -> PackedData<Matrix<S>> override {
+            std::vector<Storage> values(data.values.begin(), data.values.end());
+            const size_t rows = data.rows;
+            const size_t cols = data.cols;
+            data = Matrix<S>();
+            return {.unpack = [rows, cols, values = std::move(values)](Matrix<S>& restored) {
+                restored = Matrix<S>(rows, cols, std::vector<S>(values.begin(), values.end()));
+            }};
+        }
+    };
+
+    /// Stores `Matrix<S>` as int8 with one symmetric scale per matrix.
+    template <typename S>
+    class Int8Codec : public SavedDataCodec<Matrix<S>> {
+     public:
+        [[nodiscard]] auto Pack(Matrix<S>& data) const -> PackedData<Matrix<S>> override {
+            float maxAbs = 0;
+            for (S value : data.values) {
+                maxAbs = std::max(maxAbs, std::abs(static_cast<float>(value)));
+            }
+            const float scale = maxAbs > 0 ? maxAbs / detail::INT8_LIMIT : 1.0F;
+            std::vector<int8_t> values(data.values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                values[i] = detail::QuantizeValue(static_cast<float>(data.values[i]), 1 / scale);
+            }
+            const size_t rows = data.rows;
+            const size_t cols = data.cols;
+            data = Matrix<S>();
+            return {.unpack = [rows, cols, scale, values = std::move(values)](Matrix<S>& restored) {
+                restored = Matrix<S>(rows, cols);
+                for (size_t i = 0; i < values.size(); ++i) {
+                    restored.values[i] = static_cast<S>(static_cast<float>(values[i]) * scale);
+                }
+            }};
+        }
+    };
+
+    /// Stores one bit per element of `Matrix<S>`, positive elements are restored as one and the others as zero.
+    template <typename S>
+    class SignMaskCodec : public SavedDataCodec<Matrix<S>> {
+     public:
+        [[nodiscard]] auto Pack(Matrix<S>& data) const -> PackedData<Matrix<S>> override {
+            std::vector<uint64_t> bits((data.values.size() + 63) / 64);
+            for (size_t i = 0; i < data.values.size(); ++i) {
+                if (data.values[i] > S{}) {
+                    bits[i / 64] |= uint64_t{1} << (i % 64);
+                }
+            }
+            const size_t rows = data.rows;
+            const size_t cols = data.cols;
+            data = Matrix<S>();
+            return {.unpack = [rows, cols, bits = std::move(bits)](Matrix<S>& restored) {
+                restored = Matrix<S>(rows, cols);
+                for (size_t i = 0; i < restored.values.size(); ++i) {
+                    restored.values[i] = static_cast<S>((bits[i / 64] >> (i % 64)) & 1U);
+                }
+            }};
+        }
+    };
+
+}  // namespace auto_diff
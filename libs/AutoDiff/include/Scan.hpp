@@ -0,0 +1,205 @@
+/**
+ * @file Scan.hpp
+ * @brief Defines the Scan module that runs a loop as a single node of the graph.
+ *
+ * A loop written in C++ around `IModule::Forward` records every iteration in the graph. `Scan` runs the body module
+ * `steps` times on values and records one node for the whole loop. Reverse mode through the loop uses binomial
+ * checkpointing (Revolve): only a few intermediate states are kept and the rest are recomputed during the reverse sweep.
+ *
+ * Inputs of the module are `stateSize` loop-carried states followed by any number of constants (e.g. parameters). The body
+ * is called with the same layout and returns the next state in its `stateSize` leading outputs:
+ * \code
+ *     // x_{k+1} = body(x_k, w)
+ *     Scan<double> loop(std::make_shared<Body>(), 1000000);
+ *     auto xN = loop.Forward({x0, w})[0];
+ *     xN->Backward();  // x0->grad and w->grad are filled
+ * \endcode
+ *
+ * With `c` checkpoints and `n` steps the memory is `O(c)` states and the number of body evaluations is about `n * t` where
+ * `t` is the smallest number with `C(c + t, c) >= n`. The default `c = ceil(log2(n))` gives memory and recomputation
+ * factor logarithmic in the number of steps.
+ *
+ * @note The body is called on leaves, its temporary graphs are dropped after every step. The body must be a pure function
+ * of its inputs.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Functional.hpp"
+#include "IModule.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class Scan
+     * @brief Module applying a body module a fixed number of times with logarithmic memory reverse mode.
+     *
+     * @tparam T The data type of the nodes. Gradients must support `+=`
+     */
+    template <AccumulableT T>
+    class Scan : public IModule<T> {
+     public:
+        /**
+         * @param body Module computing the next state from the current state and the constants
+         * @param steps Number of iterations
+         * @param stateSize Number of loop-carried inputs, the rest of the inputs are constants
+         * @param checkpoints Maximum number of intermediate states kept during the reverse sweep, `ceil(log2(steps))` if
+         * not set
+         */
+        Scan(std::shared_ptr<IModule<T>> body, size_t steps, size_t stateSize = 1, std::optional<size_t> checkpoints = std::nullopt)
+            : m_loop(std::make_shared<const Loop>(
+                  Loop{std::move(body), steps, stateSize, checkpoints.value_or(std::bit_width(steps > 1 ? steps - 1 : 0))})) {}
+
+        /**
+         * @brief Runs the loop and returns the final state.
+         *
+         * The loop is recorded as one hidden node whose parents are `inputs`. Every returned output is a child of that
+         * node, so the whole loop is reversed once no matter how many outputs receive gradients.
+         */
+        [[nodiscard]] auto Forward(const std::vector<NodePtr<T>>& inputs) -> std::vector<NodePtr<T>> override {
+            if (inputs.size() < m_loop->stateSize) {
+                throw std::invalid_argument("Scan: number of inputs is less than the state size");
+            }
+            return RecordOpaque<T>(
+                inputs,
+                [loop = m_loop](const NodePtrVector<T>& loopInputs) { return loop->Run(loopInputs); },
+                [loop = m_loop](const NodePtrVector<T>& loopInputs, const std::vector<T>& /*finalState*/, std::vector<T> adjoint) {
+                    loop->Reverse(loopInputs, std::move(adjoint));
+                });
+        }
+
+     private:
+        /// Loop configuration, shared with the recorded nodes so that they can outlive the module.
+        struct Loop {
+            std::shared_ptr<IModule<T>> body;
+            size_t steps;
+            size_t stateSize;
+            size_t checkpoints;
+
+            [[nodiscard]] auto Run(const NodePtrVector<T>& inputs) const -> std::vector<T> {
+                NodePtrVector<T> constants = MakeLeaves(Values(Constants(inputs)), false);
+                return Advance(Values(State(inputs)), constants, 0, steps);
+            }
+
+            /// Reverses the whole loop and accumulates the gradients into `inputs`.
+            auto Reverse(const NodePtrVector<T>& inputs, std::vector<T> adjoint) const -> void {
+                // constants are shared by all steps, so that their gradients are summed up by the body's backward
+                NodePtrVector<T> constants = MakeLeaves(Values(Constants(inputs)), true);
+                NodePtrVector<T> frozenConstants = MakeLeaves(Values(constants), false);
+                ReverseSegment(Values(State(inputs)), 0, steps, checkpoints, adjoint, constants, frozenConstants);
+
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    if (!inputs[i]->requiresGrad) continue;
+                    inputs[i]->grad += i < stateSize ? adjoint[i] : constants[i - stateSize]->grad;
+                }
+            }
+
+            [[nodiscard]] auto State(const NodePtrVector<T>& inputs) const -> NodePtrVector<T> {
+                return {inputs.begin(), inputs.begin() + static_cast<std::ptrdiff_t>(stateSize)};
+            }
+
+            [[nodiscard]] auto Constants(const NodePtrVector<T>& inputs) const -> NodePtrVector<T> {
+                return {inputs.begin() + static_cast<std::ptrdiff_t>(stateSize), inputs.end()};
+            }
+
+            /// Runs steps `[from, to)` starting from `state`, the graph of every step is dropped after the step.
+            [[nodiscard]] auto Advance(std::vector<T> state,
+                                       const NodePtrVector<T>& constants,
+                                       size_t from,
+                                       size_t to) const -> std::vector<T> {
+                for (size_t step = from; step < to; ++step) {
+                    NodePtrVector<T> stepInputs = MakeLeaves(state, false);
+                    stepInputs.insert(stepInputs.end(), constants.begin(), constants.end());
+                    state = Evaluate(*body, stepInputs, stateSize);
+                }
+                return state;
+            }
+
+            /**
+             * @brief Reverses steps `[from, to)` with binomial checkpointing.
+             *
+             * @param state State before step `from`
+             * @param budget Number of states that can still be stored
+             * @param adjoint Gradient of the state after step `to`, replaced with the gradient of the state before `from`
+             */
+            auto ReverseSegment(std::vector<T> state,
+                                size_t from,
+                                size_t to,
+                                size_t budget,
+                                std::vector<T>& adjoint,
+                                const NodePtrVector<T>& constants,
+                                const NodePtrVector<T>& frozenConstants) const -> void {
+                while (to - from > 1) {
+                    if (budget == 0) {
+                        // no memory left: recompute every state from the start of the segment
+                        for (size_t step = to; step-- > from;) {
+                            ReverseStep(Advance(state, frozenConstants, from, step), adjoint, constants);
+                        }
+                        return;
+                    }
+                    const size_t middle = from + Split(to - from, budget);
+                    std::vector<T> middleState = Advance(state, frozenConstants, from, middle);
+                    ReverseSegment(std::move(middleState), middle, to, budget - 1, adjoint, constants, frozenConstants);
+                    to = middle;
+                }
+                if (to - from == 1) {
+                    ReverseStep(std::move(state), adjoint, constants);
+                }
+            }
+
+            /// Replaces the gradient of the state after a step with the gradient of the state before it.
+            auto ReverseStep(const std::vector<T>& state, std::vector<T>& adjoint, const NodePtrVector<T>& constants) const -> void {
+                NodePtrVector<T> stateLeaves = MakeLeaves(state, true);
+                NodePtrVector<T> stepInputs = stateLeaves;
+                stepInputs.insert(stepInputs.end(), constants.begin(), constants.end());
+                VectorJacobianProduct(*body, stepInputs, adjoint);
+                for (size_t i = 0; i < stateSize; ++i) {
+                    adjoint[i] = stateLeaves[i]->grad;
+                }
+            }
+        };
+
+        std::shared_ptr<const Loop> m_loop;
+
+        /// Number of ways `C(budget + repetitions, budget)`, saturated at the maximum of `size_t`.
+        [[nodiscard]] static auto Binomial(size_t budget, size_t repetitions) -> size_t {
+            size_t result = 1;
+            for (size_t i = 1; i <= budget; ++i) {
+                // result * (repetitions + i) / i is always an integer
+                if (result > std::numeric_limits<size_t>::max() / (repetitions + i)) {
+                    return std::numeric_limits<size_t>::max();
+                }
+                result = result * (repetitions + i) / i;
+            }
+            return result;
+        }
+
+        /**
+         * @brief Position of the first checkpoint in a segment of `length` steps.
+         *
+         * With `t` the minimal number of repetitions such that `C(c + t, c) >= length`, the right part is reversed with one
+         * checkpoint less and may be as long as `C(c - 1 + t, c - 1)`, the left part has already been swept once and gets
+         * `C(c + t - 1, c)` steps. The two add up to `C(c + t, c)` (Pascal's rule).
+         */
+        [[nodiscard]] static auto Split(size_t length, size_t budget) -> size_t {
+            size_t repetitions = 1;
+            while (Binomial(budget, repetitions) < length) {
+                ++repetitions;
+            }
+            const size_t right = std::min(length - 1, Binomial(budget - 1, repetitions));
+            return length - right;
+        }
+    };
+
+}  // namespace auto_diff
@@ -0,0 +1,322 @@
+/**
+ * @file SparseJacobian.hpp
+ * @brief Compressed evaluation of sparse Jacobians and Hessians with graph colouring.
+ *
+ * Computing a Jacobian with one `Backward` per output costs as many reverse sweeps as there are outputs. For sparse
+ * Jacobians many outputs depend on disjoint sets of inputs, and such outputs can be seeded together in one sweep: every
+ * input gradient then belongs to exactly one seeded output.
+ *
+ * `SparseJacobian` detects the sparsity pattern by propagating dependency sets through the graph, colours the rows so
+ * that rows sharing a column get different colours (distance-2 colouring of the bipartite row/column graph) and evaluates
+ * the Jacobian with one reverse sweep per colour. For banded or block-diagonal Jacobians the number of colours is the
+ * bandwidth or block size, independent of the number of outputs.
+ *
+ * Usage:
+ * \code
+ *     SparseJacobian<double> jacobian(residuals, unknowns);  // detection and colouring are done once
+ *     for (...) {
+ *         ...;  // update unknowns and replay the graph
+ *         CsrMatrix<double> j = jacobian.Evaluate();
+ *     }
+ * \endcode
+ *
+ * `SparseHessian` does the same for the Hessian of a sum of element functions on a `Node<Dual<S>>` graph: the pattern is
+ * the union of the dependency blocks of the elements, columns are coloured so that columns sharing a row get different
+ * colours, and every colour costs one Hessian-vector product (see Dual.hpp) with the indicator vector of its columns.
+ * \code
+ *     SparseHessian<double> hessian(elements, params);  // elements built in a `ReplayRecordingScope`, loss = their sum
+ *     CsrMatrix<double> h = hessian.Evaluate();
+ * \endcode
+ *
+ * @note Patterns are structural: an output is assumed to depend on an input if there is a path between them, and every
+ * pair of inputs of an element is assumed to interact. Jacobians need a scalar arithmetic data type.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Dual.hpp"
+#include "Graph.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /// Nonzero structure of a sparse matrix in compressed sparse row format.
+    struct SparsityPattern {
+        size_t rows{0};
+        size_t cols{0};
+        /// Row `i` occupies `[rowOffsets[i], rowOffsets[i + 1])` of `columns`.
+        std::vector<size_t> rowOffsets{0};
+        /// Column indices, sorted within every row.
+        std::vector<size_t> columns;
+
+        [[nodiscard]] auto NonZeros() const noexcept -> size_t { return columns.size(); }
+    };
+
+    /// Sparse matrix in compressed sparse row format.
+    template <typename S>
+    struct CsrMatrix {
+        SparsityPattern pattern;
+        /// Values in the order of `pattern.columns`.
+        std::vector<S> values;
+
+        /// Returns the element at row `i` and column `j`, zero if it is not stored.
+        [[nodiscard]] auto At(size_t i, size_t j) const -> S {
+            auto begin = pattern.columns.begin() + static_cast<std::ptrdiff_t>(pattern.rowOffsets[i]);
+            auto end = pattern.columns.begin() + static_cast<std::ptrdiff_t>(pattern.rowOffsets[i + 1]);
+            auto it = std::lower_bound(begin, end, j);
+            return it != end && *it == j ? values[static_cast<size_t>(it - pattern.columns.begin())] : S{0};
+        }
+    };
+
+    /**
+     * @brief Greedy distance-2 colouring of the rows of a sparsity pattern.
+     *
+     * Two rows get different colours if they have a nonzero in the same column.
+     *
+     * @return Colour of every row, colours are numbered from zero
+     */
+    [[nodiscard]] inline auto ColorRows(const SparsityPattern& pattern) -> std::vector<size_t> {
+        std::vector<std::vector<size_t>> rowsOfColumn(pattern.cols);
+        for (size_t row = 0; row < pattern.rows; ++row) {
+            for (size_t k = pattern.rowOffsets[row]; k < pattern.rowOffsets[row + 1]; ++k) {
+                rowsOfColumn[pattern.columns[k]].push_back(row);
+            }
+        }
+
+        constexpr size_t UNCOLORED = static_cast<size_t>(-1);
+        std::vector<size_t> colors(pattern.rows, UNCOLORED);
+        // forbiddenBy[color] == row means that the color is used by a neighbour of `row`
+        std::vector<size_t> forbiddenBy;
+        for (size_t row = 0; row < pattern.rows; ++row) {
+            for (size_t k = pattern.rowOffsets[row]; k < pattern.rowOffsets[row + 1]; ++k) {
+                for (size_t neighbour : rowsOfColumn[pattern.columns[k]]) {
+                    if (colors[neighbour] != UNCOLORED) {
+                        forbiddenBy[colors[neighbour]] = row;
+                    }
+                }
+            }
+            size_t color = 0;
+            while (color < forbiddenBy.size() && forbiddenBy[color] == row) {
+                ++color;
+            }
+            if (color == forbiddenBy.size()) {
+                forbiddenBy.push_back(UNCOLORED);
+            }
+            colors[row] = color;
+        }
+        return colors;
+    }
+
+    /**
+     * @brief Structural Jacobian pattern of `outputs` with respect to `inputs`.
+     *
+     * Sorted sets of input indices are propagated from the inputs to the outputs in topological order.
+     *
+     * @param graph Graph containing `outputs`
+     * @param inputs Columns of the pattern, must be nodes that require grad
+     */
+    template <NodeT T>
+    [[nodiscard]] auto DetectSparsity(const Graph<T>& graph, const NodePtrVector<T>& outputs, const NodePtrVector<T>& inputs)
+        -> SparsityPattern {
+        std::unordered_map<const Node<T>*, size_t> inputIndices;
+        for (size_t j = 0; j < inputs.size(); ++j) {
+            if (!inputs[j]->requiresGrad) {
+                throw std::invalid_argument("DetectSparsity: inputs must require grad");
+            }
+            inputIndices.emplace(inputs[j].get(), j);
+        }
+
+        std::unordered_map<const Node<T>*, std::vector<size_t>> dependencies;
+        for (Node<T>* node : graph.Nodes()) {
+            std::vector<size_t> nodeDependencies;
+            if (auto it = inputIndices.find(node); it != inputIndices.end()) {
+                nodeDependencies.push_back(it->second);
+            } else if (node->requiresGrad) {
+                for (const auto& parent : node->parents) {
+                    const auto& parentDependencies = dependencies[parent.get()];
+                    std::vector<size_t> merged;
+                    std::set_union(nodeDependencies.begin(), nodeDependencies.end(), parentDependencies.begin(),
+                                   parentDependencies.end(), std::back_inserter(merged));
+                    nodeDependencies = std::move(merged);
+                }
+            }
+            dependencies[node] = std::move(nodeDependencies);
+        }
+
+        SparsityPattern pattern{outputs.size(), inputs.size(), {0}, {}};
+        for (const auto& output : outputs) {
+            const auto& row = dependencies[output.get()];
+            pattern.columns.insert(pattern.columns.end(), row.begin(), row.end());
+            pattern.rowOffsets.push_back(pattern.columns.size());
+        }
+        return pattern;
+    }
+
+    /**
+     * @class SparseJacobian
+     * @brief Jacobian of `outputs` with respect to `inputs` evaluated with one reverse sweep per colour.
+     *
+     * @tparam T Scalar arithmetic data type of the nodes
+     */
+    template <NodeT T>
+        requires std::is_arithmetic_v<T>
+    class SparseJacobian {
+     public:
+        /**
+         * @param outputs Rows of the Jacobian
+         * @param inputs Columns of the Jacobian, must be nodes that require grad
+         */
+        SparseJacobian(NodePtrVector<T> outputs, NodePtrVector<T> inputs)
+            : m_graph(outputs), m_outputs(std::move(outputs)), m_inputs(std::move(inputs)) {
+            m_pattern = DetectSparsity(m_graph, m_outputs, m_inputs);
+            m_colors = ColorRows(m_pattern);
+            m_numColors = m_colors.empty() ? 0 : *std::max_element(m_colors.begin(), m_colors.end()) + 1;
+        }
+
+        [[nodiscard]] auto Pattern() const noexcept -> const SparsityPattern& { return m_pattern; }
+
+        [[nodiscard]] auto Colors() const noexcept -> const std::vector<size_t>& { return m_colors; }
+
+        /// Number of reverse sweeps needed by `Evaluate`.
+        [[nodiscard]] auto NumColors() const noexcept -> size_t { return m_numColors; }
+
+        /**
+         * @brief Evaluates the Jacobian at the current data of the graph.
+         *
+         * Gradients of all nodes of the graph are overwritten.
+         */
+        [[nodiscard]] auto Evaluate() const -> CsrMatrix<T> {
+            CsrMatrix<T> jacobian{m_pattern, std::vector<T>(m_pattern.NonZeros())};
+            for (size_t color = 0; color < m_numColors; ++color) {
+                for (Node<T>* node : m_graph.Nodes()) {
+                    node->grad = 0;
+                }
+                std::vector<Node<T>*> roots;
+                for (size_t row = 0; row < m_outputs.size(); ++row) {
+                    if (m_colors[row] == color && m_outputs[row]->requiresGrad) {
+                        m_outputs[row]->grad = 1;
+                        roots.push_back(m_outputs[row].get());
+                    }
+                }
+                Node<T>::Backpropagate(roots);
+                for (size_t row = 0; row < m_outputs.size(); ++row) {
+                    if (m_colors[row] != color) continue;
+                    for (size_t k = m_pattern.rowOffsets[row]; k < m_pattern.rowOffsets[row + 1]; ++k) {
+                        jacobian.values[k] = m_inputs[m_pattern.columns[k]]->grad;
+                    }
+                }
+            }
+            return jacobian;
+        }
+
+     private:
+        Graph<T> m_graph;
+        NodePtrVector<T> m_outputs;
+        NodePtrVector<T> m_inputs;
+        SparsityPattern m_pattern;
+        std::vector<size_t> m_colors;
+        size_t m_numColors{0};
+    };
+
+    /**
+     * @class SparseHessian
+     * @brief Hessian of a sum of element functions evaluated with one Hessian-vector product per colour.
+     *
+     * @tparam S Scalar type of the `Dual<S>` nodes
+     */
+    template <typename S>
+    class SparseHessian {
+     public:
+        /**
+         * @param elements Element functions, the Hessian is the one of their sum
+         * @param params Rows and columns of the Hessian, must be nodes that require grad
+         */
+        SparseHessian(NodePtrVector<Dual<S>> elements, NodePtrVector<Dual<S>> params)
+            : m_graph(elements), m_elements(std::move(elements)), m_params(std::move(params)) {
+            const SparsityPattern elementPattern = DetectSparsity(m_graph, m_elements, m_params);
+            // every pair of parameters of an element may interact
+            std::vector<std::vector<size_t>> rows(m_params.size());
+            for (size_t element = 0; element < m_elements.size(); ++element) {
+                for (size_t a = elementPattern.rowOffsets[element]; a < elementPattern.rowOffsets[element + 1]; ++a) {
+                    auto& row = rows[elementPattern.columns[a]];
+                    row.insert(row.end(), elementPattern.columns.begin() + static_cast<std::ptrdiff_t>(elementPattern.rowOffsets[element]),
+                               elementPattern.columns.begin() + static_cast<std::ptrdiff_t>(elementPattern.rowOffsets[element + 1]));
+                }
+            }
+            m_pattern = SparsityPattern{m_params.size(), m_params.size(), {0}, {}};
+            for (auto& row : rows) {
+                std::sort(row.begin(), row.end());
+                row.erase(std::unique(row.begin(), row.end()), row.end());
+                m_pattern.columns.insert(m_pattern.columns.end(), row.begin(), row.end());
+                m_pattern.rowOffsets.push_back(m_pattern.columns.size());
+            }
+            // the pattern is symmetric, so rows sharing a column are also columns sharing a row
+            m_colors = ColorRows(m_pattern);
+            m_numColors = m_colors.empty() ? 0 : *std::max_element(m_colors.begin(), m_colors.end()) + 1;
+        }
+
+        [[nodiscard]] auto Pattern() const noexcept -> const SparsityPattern& { return m_pattern; }
+
+        [[nodiscard]] auto Colors() const noexcept -> const std::vector<size_t>& { return m_colors; }
+
+        /// Number of Hessian-vector products needed by `Evaluate`.
+        [[nodiscard]] auto NumColors() const noexcept -> size_t { return m_numColors; }
+
+        /**
+         * @brief Evaluates the Hessian at the current values of the parameters.
+         *
+         * The graph is replayed and gradients of all its nodes are overwritten.
+         */
+        [[nodiscard]] auto Evaluate() -> CsrMatrix<S> {
+            CsrMatrix<S> hessian{m_pattern, std::vector<S>(m_pattern.NonZeros())};
+            for (size_t color = 0; color < m_numColors; ++color) {
+                for (size_t j = 0; j < m_params.size(); ++j) {
+                    m_params[j]->data.tangent = m_colors[j] == color ? S{1} : S{0};
+                }
+                m_graph.Forward();
+                for (Node<Dual<S>>* node : m_graph.Nodes()) {
+                    if (node->requiresGrad) {
+                        node->grad = 0;
+                    }
+                }
+                std::vector<Node<Dual<S>>*> roots;
+                for (const auto& element : m_elements) {
+                    if (element->requiresGrad) {
+                        element->grad = 1;
+                        roots.push_back(element.get());
+                    }
+                }
+                Node<Dual<S>>::Backpropagate(roots);
+                // row `i` of H v is the sum of H_ij over the columns of the colour, of which at most one is in the pattern
+                for (size_t row = 0; row < m_params.size(); ++row) {
+                    for (size_t k = m_pattern.rowOffsets[row]; k < m_pattern.rowOffsets[row + 1]; ++k) {
+                        if (m_colors[m_pattern.columns[k]] == color) {
+                            hessian.values[k] = m_params[row]->grad.tangent;
+                        }
+                    }
+                }
+            }
+            for (const auto& param : m_params) {
+                param->data.tangent = S{};
+            }
+            return hessian;
+        }
+
+     private:
+        Graph<Dual<S>> m_graph;
+        NodePtrVector<Dual<S>> m_elements;
+        NodePtrVector<Dual<S>> m_params;
+        SparsityPattern m_pattern;
+        std::vector<size_t> m_colors;
+        size_t m_numColors{0};
+    };
+
+}  // namespace auto_diff
@@ -0,0 +1,273 @@
+/**
+ * @file Taylor.hpp
+ * @brief Truncated Taylor polynomials for higher-order directional derivatives in one forward pass.
+ *
+ * `Taylor<S, K>` holds the normalized coefficients \f$f_k = f^{(k)}(t_0) / k!\f$ of \f$f(x + t v)\f$ up to order `K`.
+ * Operations propagate the whole polynomial with the classic recurrences of Taylor-mode AD, so a product, a quotient or an
+ * elementary function costs \f$O(K^2)\f$. Nesting first order types (e.g. `Dual<Dual<...>>`) instead costs
+ * \f$O(2^K)\f$.
+ *
+ * Backends written with the operators of the data type (e.g. `ElemwiseBackend`) propagate Taylor polynomials without
+ * changes, elementary functions are found by argument-dependent lookup as for `Dual`.
+ *
+ * Usage:
+ * \code
+ *     using T3 = Taylor<double, 3>;
+ *     ReplayRecordingScope recording;  // `Apply` replays the graph
+ *     auto residual = Pde(x, y);  // graph on Node<T3>
+ *     DirectionalDerivatives<double, 3> derivatives(residual, {x, y});
+ *     auto d = derivatives.Apply({1.0, 0.0});  // d[k] is the k-th derivative of the residual along x
+ * \endcode
+ */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Graph.hpp"
+#include "Node.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @class Taylor
+     * @brief Polynomial \f$\sum_{k=0}^{K} c_k t^k\f$ with arithmetic truncated at order `K`.
+     *
+     * @tparam S The scalar type of the coefficients
+     * @tparam K Highest order
+     */
+    template <typename S, size_t K>
+    struct Taylor {
+        static constexpr size_t order = K;
+
+        std::array<S, K + 1> coefficients{};
+
+        Taylor() = default;
+        // implicit, so that constants (e.g. `grad = 0` or `2.0 * x`) are constant polynomials
+        Taylor(S value) { coefficients[0] = value; }
+
+        /// Polynomial of `value + direction * t`.
+        [[nodiscard]] static auto Variable(S value, S direction) -> Taylor {
+            Taylor result(value);
+            if constexpr (K > 0) {
+                result.coefficients[1] = direction;
+            }
+            return result;
+        }
+
+        [[nodiscard]] auto operator[](size_t k) const -> const S& { return coefficients[k]; }
+        [[nodiscard]] auto operator[](size_t k) -> S& { return coefficients[k]; }
+
+        [[nodiscard]] auto Value() const -> const S& { return coefficients[0]; }
+
+        /// `k`-th derivative, the coefficient times `k!`.
+        [[nodiscard]] auto Derivative(size_t k) const -> S {
+            S result = coefficients[k];
+            for (size_t i = 2; i <= k; ++i) {
+                result *= static_cast<S>(i);
+            }
+            return result;
+        }
+
+        auto operator+=(const Taylor& other) -> Taylor& {
+            for (size_t k = 0; k <= K; ++k) {
+                coefficients[k] += other.coefficients[k];
+            }
+            return *this;
+        }
+        auto operator-=(const Taylor& other) -> Taylor& {
+            for (size_t k = 0; k <= K; ++k) {
+                coefficients[k] -= other.coefficients[k];
+            }
+            return *this;
+        }
+        auto operator*=(const Taylor& other) -> Taylor& { return *this = *this * other; }
+        auto operator/=(const Taylor& other) -> Taylor& { return *this = *this / other; }
+
+        friend auto operator+(Taylor a, const Taylor& b) -> Taylor { return a += b; }
+        friend auto operator-(Taylor a, const Taylor& b) -> Taylor { return a -= b; }
+        friend auto operator-(const Taylor& a) -> Taylor {
+            Taylor result;
+            for (size_t k = 0; k <= K; ++k) {
+                result.coefficients[k] = -a.coefficients[k];
+            }
+            return result;
+        }
+
+        /// Cauchy product.
+        friend auto operator*(const Taylor& a, const Taylor& b) -> Taylor {
+            Taylor result;
+            for (size_t k = 0; k <= K; ++k) {
+                for (size_t j = 0; j <= k; ++j) {
+                    result.coefficients[k] += a.coefficients[j] * b.coefficients[k - j];
+                }
+            }
+            return result;
+        }
+
+        /// Solves `b * c = a` for `c` coefficient by coefficient.
+        friend auto operator/(const Taylor& a, const Taylor& b) -> Taylor {
+            Taylor result;
+            for (size_t k = 0; k <= K; ++k) {
+                S sum = a.coefficients[k];
+                for (size_t j = 1; j <= k; ++j) {
+                    sum -= b.coefficients[j] * result.coefficients[k - j];
+                }
+                result.coefficients[k] = sum / b.coefficients[0];
+            }
+            return result;
+        }
+
+        // comparisons see only the value, so that branches in backends take the same path as without derivatives
+        friend auto operator==(const Taylor& a, const Taylor& b) -> bool { return a.Value() == b.Value(); }
+        friend auto operator<(const Taylor& a, const Taylor& b) -> bool { return a.Value() < b.Value(); }
+        friend auto operator>(const Taylor& a, const Taylor& b) -> bool { return a.Value() > b.Value(); }
+        friend auto operator<=(const Taylor& a, const Taylor& b) -> bool { return a.Value() <= b.Value(); }
+        friend auto operator>=(const Taylor& a, const Taylor& b) -> bool { return a.Value() >= b.Value(); }
+
+        // elementary functions f(a) follow from f' = g(f) a', i.e. k f_k = sum_{j=1}^{k} j a_j g_{k-j}
+
+        friend auto exp(const Taylor& a) -> Taylor {
+            using std::exp;
+            Taylor result(exp(a.Value()));
+            for (size_t k = 1; k <= K; ++k) {
+                result.coefficients[k] = ScaledConvolution(a, result, k) / static_cast<S>(k);
+            }
+            return result;
+        }
+
+        friend auto log(const Taylor& a) -> Taylor {
+            using std::log;
+            Taylor result(log(a.Value()));
+            for (size_t k = 1; k <= K; ++k) {
+                // a' = a l', so k a_k = sum_{j=1}^{k} j l_j a_{k-j}
+                S sum = static_cast<S>(k) * a.coefficients[k];
+                for (size_t j = 1; j < k; ++j) {
+                    sum -= static_cast<S>(j) * result.coefficients[j] * a.coefficients[k - j];
+                }
+                result.coefficients[k] = sum / (static_cast<S>(k) * a.Value());
+            }
+            return result;
+        }
+
+        friend auto sqrt(const Taylor& a) -> Taylor {
+            using std::sqrt;
+            Taylor result(sqrt(a.Value()));
+            for (size_t k = 1; k <= K; ++k) {
+                // r * r = a
+                S sum = a.coefficients[k];
+                for (size_t j = 1; j < k; ++j) {
+                    sum -= result.coefficients[j] * result.coefficients[k - j];
+                }
+                result.coefficients[k] = sum / (S{2} * result.Value());
+            }
+            return result;
+        }
+
+        friend auto sin(const Taylor& a) -> Taylor { return SinCos(a).first; }
+
+        friend auto cos(const Taylor& a) -> Taylor { return SinCos(a).second; }
+
+        friend auto tanh(const Taylor& a) -> Taylor {
+            using std::tanh;
+            Taylor result(tanh(a.Value()));
+            // u = 1 - tanh^2 is the derivative of tanh
+            Taylor derivative(S{1} - result.Value() * result.Value());
+            for (size_t k = 1; k <= K; ++k) {
+                result.coefficients[k] = ScaledConvolution(a, derivative, k) / static_cast<S>(k);
+                S square{};
+                for (size_t j = 0; j <= k; ++j) {
+                    square += result.coefficients[j] * result.coefficients[k - j];
+                }
+                derivative.coefficients[k] = -square;
+            }
+            return result;
+        }
+
+        /// `a^exponent` for a constant exponent, requires a nonzero value.
+        friend auto pow(const Taylor& a, const S& exponent) -> Taylor {
+            using std::pow;
+            Taylor result(pow(a.Value(), exponent));
+            for (size_t k = 1; k <= K; ++k) {
+                // a p' = exponent p a'
+                S sum{};
+                for (size_t j = 1; j <= k; ++j) {
+                    sum += (exponent * static_cast<S>(j) - static_cast<S>(k - j)) * a.coefficients[j] * result.coefficients[k - j];
+                }
+                result.coefficients[k] = sum / (static_cast<S>(k) * a.Value());
+            }
+            return result;
+        }
+
+        friend auto abs(const Taylor& a) -> Taylor { return a.Value() < S{0} ? -a : a; }
+
+     private:
+        /// Returns `sum_{j=1}^{k} j a_j g_{k-j}`.
+        [[nodiscard]] static auto ScaledConvolution(const Taylor& a, const Taylor& g, size_t k) -> S {
+            S sum{};
+            for (size_t j = 1; j <= k; ++j) {
+                sum += static_cast<S>(j) * a.coefficients[j] * g.coefficients[k - j];
+            }
+            return sum;
+        }
+
+        [[nodiscard]] static auto SinCos(const Taylor& a) -> std::pair<Taylor, Taylor> {
+            using std::cos, std::sin;
+            Taylor s(sin(a.Value()));
+            Taylor c(cos(a.Value()));
+            for (size_t k = 1; k <= K; ++k) {
+                s.coefficients[k] = ScaledConvolution(a, c, k) / static_cast<S>(k);
+                c.coefficients[k] = -ScaledConvolution(a, s, k) / static_cast<S>(k);
+            }
+            return {s, c};
+        }
+    };
+
+    /**
+     * @class DirectionalDerivatives
+     * @brief Derivatives of an output along a direction in the inputs, up to order `K`, in one forward pass.
+     *
+     * The graph is captured once, every `Apply` seeds the inputs with `x + t v` and replays it.
+     *
+     * @tparam S The scalar type
+     * @tparam K Highest order
+     */
+    template <typename S, size_t K>
+    class DirectionalDerivatives {
+     public:
+        DirectionalDerivatives(NodePtr<Taylor<S, K>> output, NodePtrVector<Taylor<S, K>> inputs)
+            : m_graph({output}), m_output(std::move(output)), m_inputs(std::move(inputs)) {}
+
+        /**
+         * @brief Returns the derivatives of orders `0..K` of `f(x + t v)` at `t = 0`.
+         *
+         * @param v Direction, one component per input
+         */
+        [[nodiscard]] auto Apply(const std::vector<S>& v) -> std::array<S, K + 1> {
+            if (v.size() != m_inputs.size()) {
+                throw std::invalid_argument("DirectionalDerivatives: direction size doesn't match the number of inputs");
+            }
+            for (size_t i = 0; i < m_inputs.size(); ++i) {
+                m_inputs[i]->data = Taylor<S, K>::Variable(m_inputs[i]->data.Value(), v[i]);
+            }
+            m_graph.Forward();
+
+            std::array<S, K + 1> derivatives;
+            for (size_t k = 0; k <= K; ++k) {
+                derivatives[k] = m_output->data.Derivative(k);
+            }
+            return derivatives;
+        }
+
+     private:
+        Graph<Taylor<S, K>> m_graph;
+        NodePtr<Taylor<S, K>> m_output;
+        NodePtrVector<Taylor<S, K>> m_inputs;
+    };
+
+}  // namespace auto_diff
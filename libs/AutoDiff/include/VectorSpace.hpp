@@ -0,0 +1,67 @@
+/**
+ * @file VectorSpace.hpp
+ * @brief Arithmetic on Node data types needed by solvers and integrators.
+ *
+ * Solver modules combine values outside of backends (e.g. `y + h * k` in an ODE step), so they need more from the data
+ * type than `NodeT`. Arithmetic types work out of the box, tensor types provide the operators and, if they are not ranges
+ * of arithmetic values, `MaxNorm` and `Dot` overloads found by argument-dependent lookup.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <ranges>
+#include <type_traits>
+
+#include "Functional.hpp"
+
+namespace auto_diff {
+
+    /**
+     * @brief Concept for Node data types that form a vector space over `double`
+     */
+    template <typename T>
+    concept VectorSpaceT = AccumulableT<T> && requires(const T& a, const T& b, double s) {
+        { a + b } -> std::convertible_to<T>;
+        { a - b } -> std::convertible_to<T>;
+        { s * a } -> std::convertible_to<T>;
+    };
+
+    /// Maximum absolute value of the elements, NaN when an element is NaN.
+    template <typename T>
+    [[nodiscard]] auto MaxNorm(const T& value) -> double {
+        if constexpr (std::is_arithmetic_v<T>) {
+            return std::abs(static_cast<double>(value));
+        } else {
+            static_assert(std::ranges::range<T>, "MaxNorm: provide an overload for this type");
+            double norm = 0;
+            for (const auto& element : value) {
+                const double elementNorm = MaxNorm(element);
+                if (std::isnan(elementNorm)) {
+                    return elementNorm;
+                }
+                norm = std::max(norm, elementNorm);
+            }
+            return norm;
+        }
+    }
+
+    /// Sum of products of the elements.
+    template <typename T>
+    [[nodiscard]] auto Dot(const T& a, const T& b) -> double {
+        if constexpr (std::is_arithmetic_v<T>) {
+            return static_cast<double>(a) * static_cast<double>(b);
+        } else {
+            static_assert(std::ranges::range<T>, "Dot: provide an overload for this type");
+            double dot = 0;
+            auto it = std::ranges::begin(b);
+            for (const auto& element : a) {
+                dot += Dot(element, *it++);
+            }
+            return dot;
+        }
+    }
+
+}  // namespace auto_diff
@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+
+#include "BatchExecutor.hpp"
+#include "IModule.hpp"
+#include "Matrix.hpp"
+#include "Modules.hpp"
+
+using auto_diff::BatchExecutor;
+using auto_diff::Matrix;
+using auto_diff::MatrixBackend;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+using auto_diff::NodePtrVector;
+
+template <typename T>
+class BatchBackend {
+ public:
+    static inline size_t batchCalls = 0;
+
+    static auto BatchedAddForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data + inputs[1]->data));
+    }
+    static auto BatchedAddBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        for (const auto& input : inputs) {
+            if (input->requiresGrad) {
+                input->grad += output->grad;
+            }
+        }
+    }
+    static auto BatchedAddForwardBatch(const std::vector<Node<T>*>& outputs) -> void {
+        ++batchCalls;
+        for (Node<T>* output : outputs) {
+            output->data = output->parents[0]->data + output->parents[1]->data;
+        }
+    }
+    static auto BatchedAddBackwardBatch(const std::vector<Node<T>*>& outputs) -> void {
+        ++batchCalls;
+        for (Node<T>* output : outputs) {
+            BatchedAddBackward(output->parents, output, 0);
+        }
+    }
+
+    static auto BatchedMultForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data * inputs[1]->data));
+    }
+    static auto BatchedMultBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * inputs[1]->data;
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += output->grad * inputs[0]->data;
+        }
+    }
+    static auto BatchedMultForwardBatch(const std::vector<Node<T>*>& outputs) -> void {
+        ++batchCalls;
+        for (Node<T>* output : outputs) {
+            output->data = output->parents[0]->data * output->parents[1]->data;
+        }
+    }
+    static auto BatchedMultBackwardBatch(const std::vector<Node<T>*>& outputs) -> void {
+        ++batchCalls;
+        for (Node<T>* output : outputs) {
+            BatchedMultBackward(output->parents, output, 0);
+        }
+    }
+
+    // no batched kernels, evaluated node by node
+    static auto UnbatchedSquareForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data * inputs[0]->data));
+    }
+    static auto UnbatchedSquareBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += 2 * output->grad * inputs[0]->data;
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(BatchedAdd)
+    DEFINE_MODULE(BatchedMult)
+    DEFINE_MODULE(UnbatchedSquare)
+}  // namespace auto_diff
+
+using Add = auto_diff::BatchedAdd<double, BatchBackend<double>>;
+using Mult = auto_diff::BatchedMult<double, BatchBackend<double>>;
+using Square = auto_diff::UnbatchedSquare<double, BatchBackend<double>>;
+
+namespace {
+
+    /// Recursive cell `h = w * left + right` over a tree whose shape depends on `seed`.
+    auto Encode(size_t size, size_t seed, const NodePtr<double>& w, NodePtrVector<double>& leaves) -> NodePtr<double> {
+        if (size == 1) {
+            leaves.push_back(std::make_shared<Node<double>>(0.1 * static_cast<double>(leaves.size() % 7 + 1), false));
+            return leaves.back();
+        }
+        const size_t left = 1 + seed % (size - 1);
+        auto l = Encode(left, seed * 31 + 7, w, leaves);
+        auto r = Encode(size - left, seed * 17 + 3, w, leaves);
+        Add add;
+        Mult mult;
+        return add.Forward({mult.Forward({w, l})[0], r})[0];
+    }
+
+}  // namespace
+
+TEST(BatchExecutorTest, MatchesSequentialEvaluation) {
+    auto_diff::ReplayRecordingScope recording;
+    auto w = std::make_shared<Node<double>>(0.9);
+    NodePtrVector<double> leaves;
+    NodePtrVector<double> losses;
+    size_t numNodes = 0;
+    for (size_t sample = 0; sample < 32; ++sample) {
+        const size_t size = 2 + sample % 9;
+        numNodes += 2 * (size - 1) + 1;
+        losses.push_back(Square().Forward({Encode(size, sample, w, leaves)})[0]);
+    }
+
+    std::vector<double> expectedLosses;
+    for (const auto& loss : losses) {
+        loss->Backward();
+        expectedLosses.push_back(loss->data);
+    }
+    const double expectedGrad = w->grad;
+
+    BatchExecutor<double> executor(losses);
+    // much fewer calls than nodes: one per depth and module plus the unbatched squares
+    EXPECT_LT(executor.NumForwardCalls(), numNodes / 4);
+
+    w->data = 0.0;
+    executor.Forward();
+    EXPECT_DOUBLE_EQ(losses[0]->data, leaves[1]->data * leaves[1]->data);
+
+    w->data = 0.9;
+    BatchBackend<double>::batchCalls = 0;
+    executor.Forward();
+    executor.Backward();
+    EXPECT_GT(BatchBackend<double>::batchCalls, 0);
+    for (size_t i = 0; i < losses.size(); ++i) {
+        EXPECT_DOUBLE_EQ(losses[i]->data, expectedLosses[i]);
+    }
+    EXPECT_NEAR(w->grad, expectedGrad, 1e-12);
+}
+
+TEST(BatchExecutorTest, MatMulOfManyGraphsRunsAsOneProduct) {
+    using Tensor = Matrix<double>;
+    using MatMul = auto_diff::MatMul<Tensor, MatrixBackend<double>>;
+    auto w = std::make_shared<Node<Tensor>>(Tensor(3, 2, {0.5, -1.0, 0.25, 2.0, -0.75, 1.5}));
+    auto v = std::make_shared<Node<Tensor>>(Tensor(2, 1, {1.5, -0.5}));
+    NodePtrVector<Tensor> xs;
+    NodePtrVector<Tensor> losses;
+    for (size_t sample = 0; sample < 16; ++sample) {
+        // a different number of rows per sample
+        const size_t rows = 1 + sample % 4;
+        std::vector<double> values(rows * 3);
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = 0.1 * static_cast<double>((sample + i) % 5) - 0.2;
+        }
+        xs.push_back(std::make_shared<Node<Tensor>>(Tensor(rows, 3, values)));
+        losses.push_back(MatMul().Forward({MatMul().Forward({xs.back(), w})[0], v})[0]);
+    }
+
+    std::vector<Tensor> expectedLosses;
+    for (const auto& loss : losses) {
+        loss->Backward();
+        expectedLosses.push_back(loss->data);
+    }
+    std::vector<Tensor> expectedXGrads;
+    for (const auto& x : xs) {
+        expectedXGrads.push_back(x->grad);
+    }
+    const Tensor expectedWGrad = w->grad;
+    const Tensor expectedVGrad = v->grad;
+
+    BatchExecutor<Tensor> executor(losses);
+    // one product per depth for all 32 MatMul nodes
+    EXPECT_EQ(executor.NumForwardCalls(), 2);
+
+    w->data = 0.0;
+    executor.Forward();
+    for (const auto& loss : losses) {
+        for (double value : loss->data.values) {
+            EXPECT_DOUBLE_EQ(value, 0.0);
+        }
+    }
+
+    w->data = Tensor(3, 2, {0.5, -1.0, 0.25, 2.0, -0.75, 1.5});
+    executor.Forward();
+    executor.Backward();
+    for (size_t i = 0; i < losses.size(); ++i) {
+        ASSERT_EQ(losses[i]->data.rows, expectedLosses[i].rows);
+        for (size_t j = 0; j < expectedLosses[i].values.size(); ++j) {
+            EXPECT_NEAR(losses[i]->data.values[j], expectedLosses[i].values[j], 1e-12);
+        }
+        for (size_t j = 0; j < expectedXGrads[i].values.size(); ++j) {
+            EXPECT_NEAR(xs[i]->grad.values[j], expectedXGrads[i].values[j], 1e-12);
+        }
+    }
+    for (size_t j = 0; j < expectedWGrad.values.size(); ++j) {
+        EXPECT_NEAR(w->grad.values[j], expectedWGrad.values[j], 1e-12);
+    }
+    for (size_t j = 0; j < expectedVGrad.values.size(); ++j) {
+        EXPECT_NEAR(v->grad.values[j], expectedVGrad.values[j], 1e-12);
+    }
+}
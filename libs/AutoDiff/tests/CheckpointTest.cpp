@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "Checkpoint.hpp"
+#include "TemporaryPath.hpp"
+
+using auto_diff::Checkpoint;
+using auto_diff::CheckpointTensor;
+using auto_diff::MappedTensor;
+using auto_diff::Matrix;
+using auto_diff::SaveCheckpoint;
+using auto_diff::tests::TemporaryPath;
+
+TEST(CheckpointTest, RoundTrip) {
+    TemporaryPath path("checkpoint_round_trip");
+    Matrix<float> w(3, 5);
+    for (size_t i = 0; i < w.values.size(); ++i) {
+        w.values[i] = static_cast<float>(i) / 7;
+    }
+    const std::vector<double> moments{1.5, -2.5, 3.5};
+    const Matrix<int8_t> quantized(2, 2, std::vector<int8_t>{-1, 2, -3, 4});
+    SaveCheckpoint(path.Get(), {CheckpointTensor("w", w), CheckpointTensor("adam.m", moments), CheckpointTensor("q", quantized)}, 2);
+
+    auto checkpoint = Checkpoint::Open(path.Get());
+    EXPECT_EQ(checkpoint.Entries().size(), 3);
+    EXPECT_TRUE(checkpoint.Contains("adam.m"));
+
+    Matrix<float> loaded;
+    checkpoint.Load("w", loaded);
+    EXPECT_EQ(loaded.rows, 3);
+    EXPECT_EQ(loaded.cols, 5);
+    EXPECT_EQ(loaded.values, w.values);
+    std::vector<double> loadedMoments;
+    checkpoint.Load("adam.m", loadedMoments);
+    EXPECT_EQ(loadedMoments, moments);
+
+    // views point into the mapping at 64-byte aligned addresses
+    MappedTensor<int8_t> view = checkpoint.View<int8_t>("q");
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(view.Row(0).data()) % 64, 0);
+    EXPECT_EQ(view.Row(1)[1], 4);
+    EXPECT_EQ(view.File(), checkpoint.View<float>("w").File());
+
+    EXPECT_THROW((void)checkpoint.View<double>("w"), std::invalid_argument);
+    EXPECT_THROW((void)checkpoint.View<float>("missing"), std::out_of_range);
+}
+
+TEST(CheckpointTest, LargeTensorsAreSplitBetweenWriters) {
+    TemporaryPath path("checkpoint_large");
+    TemporaryPath tablePath("checkpoint_large_table");
+    auto table = MappedTensor<float>::Create(tablePath.Get(), 5 << 20, 2);
+    table.Row(0)[0] = 1.0F;
+    table.Row((5 << 20) - 1)[1] = 2.0F;
+    SaveCheckpoint(path.Get(), {CheckpointTensor("table", table)}, 4);
+
+    auto view = Checkpoint::Open(path.Get()).View<float>("table");
+    EXPECT_EQ(view.Rows(), 5 << 20);
+    EXPECT_EQ(view.Row(0)[0], 1.0F);
+    EXPECT_EQ(view.Row((5 << 20) - 1)[1], 2.0F);
+    // no temporary file is left next to the checkpoint
+    for (const auto& file : std::filesystem::directory_iterator(path.Get().parent_path())) {
+        EXPECT_FALSE(file.path().string().starts_with(path.Get().string() + "."));
+    }
+}
+
+TEST(CheckpointTest, ConcurrentSavesToTheSamePath) {
+    TemporaryPath path("checkpoint_concurrent");
+    const Matrix<float> a(64, 64, 1.0F);
+    const Matrix<float> b(64, 64, 2.0F);
+    auto save = [&path](const Matrix<float>& w) {
+        for (int i = 0; i < 20; ++i) {
+            SaveCheckpoint(path.Get(), {CheckpointTensor("w", w)}, 1);
+        }
+    };
+    std::thread first(save, std::cref(a));
+    std::thread second(save, std::cref(b));
+    first.join();
+    second.join();
+
+    // every save renamed a complete file of its own
+    Matrix<float> loaded;
+    Checkpoint::Open(path.Get()).Load("w", loaded);
+    EXPECT_TRUE(loaded.values == a.values || loaded.values == b.values);
+}
+
+TEST(CheckpointTest, InvalidFilesAreRejected) {
+    TemporaryPath path("checkpoint_invalid");
+    {
+        std::ofstream file(path.Get(), std::ios::binary);
+        file << std::string(128, 'x');
+    }
+    EXPECT_THROW(Checkpoint::Open(path.Get()), std::runtime_error);
+    const Matrix<float> w(1, 1);
+    EXPECT_THROW(SaveCheckpoint(path.Get(), {CheckpointTensor("w", w), CheckpointTensor("w", w)}), std::invalid_argument);
+}
+
+TEST(CheckpointTest, OverflowingShapesAreRejected) {
+    TemporaryPath path("checkpoint_overflow");
+    const Matrix<float> w(1, 1);
+    SaveCheckpoint(path.Get(), {CheckpointTensor("w", w)});
+    {
+        std::fstream file(path.Get(), std::ios::binary | std::ios::in | std::ios::out);
+        uint64_t indexOffset = 0;
+        file.seekg(16);
+        file.read(reinterpret_cast<char*>(&indexOffset), sizeof(indexOffset));
+        // (2^62 + 1) * 1 * sizeof(float) wraps around to the 4 bytes of the blob
+        const uint64_t rows = (uint64_t{1} << 62) + 1;
+        file.seekp(static_cast<std::streamoff>(indexOffset + 8));
+        file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    }
+    EXPECT_THROW(Checkpoint::Open(path.Get()), std::runtime_error);
+}
+
+TEST(CheckpointTest, InconsistentIndexEntriesAreRejected) {
+    TemporaryPath path("checkpoint_inconsistent");
+    const Matrix<float> w(1, 1);
+    // writes `value` at `position` of the index of a fresh checkpoint of "a" and "b", entries are 40 bytes + a 1-byte name
+    const auto corrupt = [&path, &w](uint64_t position, const auto& value) {
+        SaveCheckpoint(path.Get(), {CheckpointTensor("a", w), CheckpointTensor("b", w)});
+        std::fstream file(path.Get(), std::ios::binary | std::ios::in | std::ios::out);
+        uint64_t indexOffset = 0;
+        file.seekg(16);
+        file.read(reinterpret_cast<char*>(&indexOffset), sizeof(indexOffset));
+        file.seekp(static_cast<std::streamoff>(indexOffset + position));
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    constexpr uint64_t SECOND_ENTRY = 41;
+
+    corrupt(SECOND_ENTRY + 40, 'a');
+    EXPECT_THROW(Checkpoint::Open(path.Get()), std::runtime_error);
+    // the blob would overwrite the header
+    corrupt(24, uint64_t{0});
+    EXPECT_THROW(Checkpoint::Open(path.Get()), std::runtime_error);
+    // both entries point to the first blob
+    corrupt(SECOND_ENTRY + 24, uint64_t{64});
+    EXPECT_THROW(Checkpoint::Open(path.Get()), std::runtime_error);
+
+    SaveCheckpoint(path.Get(), {CheckpointTensor("a", w), CheckpointTensor("b", w)});
+    EXPECT_EQ(Checkpoint::Open(path.Get()).Entries().size(), 2U);
+}
+
+TEST(CheckpointTest, UnknownElementTypesAreRejected) {
+    TemporaryPath path("checkpoint_unknown_type");
+    const Matrix<float> w(1, 1);
+    SaveCheckpoint(path.Get(), {CheckpointTensor("w", w)});
+    {
+        std::fstream file(path.Get(), std::ios::binary | std::ios::in | std::ios::out);
+        uint64_t indexOffset = 0;
+        file.seekg(16);
+        file.read(reinterpret_cast<char*>(&indexOffset), sizeof(indexOffset));
+        // an unknown type has no element size, a zero byte size would match any shape
+        const uint32_t type = 99;
+        const uint64_t size = 0;
+        file.seekp(static_cast<std::streamoff>(indexOffset + 4));
+        file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+        file.seekp(static_cast<std::streamoff>(indexOffset + 32));
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+    EXPECT_THROW(Checkpoint::Open(path.Get()), std::runtime_error);
+}
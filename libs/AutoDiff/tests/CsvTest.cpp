@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "Csv.hpp"
+#include "TemporaryPath.hpp"
+
+using auto_diff::LoadCsv;
+using auto_diff::Matrix;
+using auto_diff::tests::TemporaryPath;
+
+TEST(CsvTest, FindByteMatchesScalarSearch) {
+    const std::string text = std::string(37, 'a') + "\n" + std::string(5, 'b') + "\n";
+    for (size_t start = 0; start < text.size(); ++start) {
+        const char* expected = text.data() + text.find('\n', start);
+        EXPECT_EQ(auto_diff::detail::FindByte(text.data() + start, text.data() + text.size(), '\n'), expected) << start;
+    }
+    EXPECT_EQ(auto_diff::detail::FindByte(text.data(), text.data() + 37, '\n'), text.data() + 37);
+}
+
+TEST(CsvTest, SeparatorFinderMatchesScalarSearch) {
+    const std::string text = "1.5,2;" + std::string(20, '7') + ",\n" + std::string(9, '8') + ",4\n5";
+    const char* end = text.data() + text.size();
+    auto_diff::detail::SeparatorFinder separators(end, ',');
+    for (size_t start = 0; start < text.size(); ++start) {
+        const size_t expected = std::min(text.find_first_of(",\n", start), text.size());
+        EXPECT_EQ(separators.Next(text.data() + start), text.data() + expected) << start;
+    }
+}
+
+TEST(CsvTest, SpacesAndCarriageReturnsAroundFields) {
+    TemporaryPath path("csv_spaces");
+    {
+        std::ofstream file(path.Get());
+        file << " 1 ,\t2\n3,4 \r\n";
+    }
+    EXPECT_THROW((void)LoadCsv<float>(path.Get()), std::runtime_error);
+    {
+        std::ofstream file(path.Get());
+        file << " 1 ,  2\r\n\n3,4 \r\n";
+    }
+    EXPECT_EQ(LoadCsv<float>(path.Get()).values, (std::vector<float>{1, 2, 3, 4}));
+    {
+        std::ofstream file(path.Get());
+        file << "1,2\r3\n";
+    }
+    EXPECT_THROW((void)LoadCsv<float>(path.Get()), std::runtime_error);
+}
+
+TEST(CsvTest, ParallelChunksKeepRecordOrder) {
+    TemporaryPath path("csv_parallel");
+    const size_t records = 20000;
+    {
+        std::ofstream file(path.Get());
+        file << "index,half,constant\n";
+        for (size_t i = 0; i < records; ++i) {
+            file << i << ", " << static_cast<double>(i) / 2 << ",1e-3" << (i % 3 == 0 ? "\r\n" : "\n");
+            if (i % 1000 == 0) {
+                file << "\n";
+            }
+        }
+    }
+    for (size_t threads : {1, 3, 8}) {
+        const Matrix<double> table = LoadCsv<double>(path.Get(), {.skipHeader = true, .numThreads = threads});
+        ASSERT_EQ(table.rows, records);
+        ASSERT_EQ(table.cols, 3);
+        for (size_t i = 0; i < records; ++i) {
+            ASSERT_EQ(table(i, 0), static_cast<double>(i));
+            ASSERT_EQ(table(i, 1), static_cast<double>(i) / 2);
+            ASSERT_EQ(table(i, 2), 1e-3);
+        }
+    }
+}
+
+TEST(CsvTest, MalformedRecordsThrow) {
+    TemporaryPath path("csv_malformed");
+    {
+        std::ofstream file(path.Get());
+        file << "1;2\n3;4;5\n";
+    }
+    EXPECT_THROW((void)LoadCsv<float>(path.Get(), {.delimiter = ';'}), std::runtime_error);
+    {
+        std::ofstream file(path.Get());
+        file << "1;2\n3;4";
+    }
+    EXPECT_EQ(LoadCsv<float>(path.Get(), {.delimiter = ';'}).values, (std::vector<float>{1, 2, 3, 4}));
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "Dual.hpp"
+#include "IModule.hpp"
+
+using auto_diff::Dual;
+using auto_diff::HessianVectorProduct;
+using auto_diff::Hvp;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+
+template <typename T>
+class DualBackend {
+ public:
+    static auto DualMultForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data * inputs[1]->data));
+    }
+    static auto DualMultBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * inputs[1]->data;
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += output->grad * inputs[0]->data;
+        }
+    }
+
+    static auto DualAddForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data + inputs[1]->data));
+    }
+    static auto DualAddBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        for (const auto& input : inputs) {
+            if (input->requiresGrad) {
+                input->grad += output->grad;
+            }
+        }
+    }
+
+    static auto DualExpForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        using std::exp;
+        outputs.push_back(std::make_shared<Node<T>>(exp(inputs[0]->data)));
+    }
+    static auto DualExpBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * output->data;
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(DualMult)
+    DEFINE_MODULE(DualAdd)
+    DEFINE_MODULE(DualExp)
+}  // namespace auto_diff
+
+using D = Dual<double>;
+using Mult = auto_diff::DualMult<D, DualBackend<D>>;
+using Add = auto_diff::DualAdd<D, DualBackend<D>>;
+using Exp = auto_diff::DualExp<D, DualBackend<D>>;
+
+TEST(DualTest, Arithmetic) {
+    D x(3.0, 1.0);
+    D y = x * x / (x + 1.0);
+    // d/dx x^2 / (x + 1) = (x^2 + 2x) / (x + 1)^2
+    EXPECT_DOUBLE_EQ(y.value, 9.0 / 4.0);
+    EXPECT_DOUBLE_EQ(y.tangent, 15.0 / 16.0);
+    D e = exp(2.0 * x);
+    EXPECT_DOUBLE_EQ(e.tangent, 2.0 * std::exp(6.0));
+}
+
+TEST(DualTest, HessianVectorProduct) {
+    auto_diff::ReplayRecordingScope recording;
+    Mult mult;
+    Add add;
+    Exp exp;
+    // f(x, y) = x^2 y + exp(x y)
+    auto x = std::make_shared<Node<D>>(D(0.5));
+    auto y = std::make_shared<Node<D>>(D(2.0));
+    auto xy = mult.Forward({x, y})[0];
+    auto loss = add.Forward({mult.Forward({mult.Forward({x, x})[0], y})[0], exp.Forward({xy})[0]})[0];
+
+    const double xv = 0.5;
+    const double yv = 2.0;
+    const double e = std::exp(xv * yv);
+    const double hxx = 2 * yv + yv * yv * e;
+    const double hxy = 2 * xv + e + xv * yv * e;
+    const double hyy = xv * xv * e;
+
+    HessianVectorProduct<double> hvp(loss, {x, y});
+    for (const auto& v : {std::vector<double>{1.0, 0.0}, std::vector<double>{0.0, 1.0}, std::vector<double>{-0.3, 0.7}}) {
+        auto hv = hvp.Apply(v);
+        EXPECT_NEAR(hv[0], hxx * v[0] + hxy * v[1], 1e-12);
+        EXPECT_NEAR(hv[1], hxy * v[0] + hyy * v[1], 1e-12);
+
+        auto gradient = hvp.Gradient();
+        EXPECT_NEAR(gradient[0], 2 * xv * yv + yv * e, 1e-12);
+        EXPECT_NEAR(gradient[1], xv * xv + xv * e, 1e-12);
+    }
+    EXPECT_DOUBLE_EQ(loss->data.value, xv * xv * yv + e);
+    EXPECT_DOUBLE_EQ(x->data.tangent, 0.0);
+
+    auto hv = Hvp(loss, {x, y}, {1.0, 1.0});
+    EXPECT_NEAR(hv[0], hxx + hxy, 1e-12);
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "FixedPoint.hpp"
+#include "IModule.hpp"
+
+using auto_diff::AdjointSolver;
+using auto_diff::FixedPoint;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+
+template <typename T>
+class EquilibriumBackend {
+ public:
+    static inline size_t backwardCalls = 0;
+
+    // z = a * cos(z) + b
+    static auto CosineForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[1]->data * std::cos(inputs[0]->data) + inputs[2]->data));
+    }
+    static auto CosineBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        ++backwardCalls;
+        const T& z = inputs[0]->data;
+        const T& a = inputs[1]->data;
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += -a * std::sin(z) * output->grad;
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += std::cos(z) * output->grad;
+        }
+        if (inputs[2]->requiresGrad) {
+            inputs[2]->grad += output->grad;
+        }
+    }
+
+    // z = a * z + b
+    static auto AffineForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[1]->data * inputs[0]->data + inputs[2]->data));
+    }
+    static auto AffineBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += inputs[1]->data * output->grad;
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += inputs[0]->data * output->grad;
+        }
+        if (inputs[2]->requiresGrad) {
+            inputs[2]->grad += output->grad;
+        }
+    }
+
+    // (x, y) = (0.5 * y + c, 0.25 * x + 2 * c)
+    static auto CoupledForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(0.5 * inputs[1]->data + inputs[2]->data));
+        outputs.push_back(std::make_shared<Node<T>>(0.25 * inputs[0]->data + 2 * inputs[2]->data));
+    }
+    static auto CoupledBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, size_t outputIdx) -> void {
+        if (inputs[outputIdx == 0 ? 1 : 0]->requiresGrad) {
+            inputs[outputIdx == 0 ? 1 : 0]->grad += (outputIdx == 0 ? 0.5 : 0.25) * output->grad;
+        }
+        if (inputs[2]->requiresGrad) {
+            inputs[2]->grad += (outputIdx == 0 ? 1 : 2) * output->grad;
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(Cosine)
+    DEFINE_MODULE(Affine)
+    DEFINE_MODULE(Coupled)
+}  // namespace auto_diff
+
+using CosineModule = auto_diff::Cosine<double, EquilibriumBackend<double>>;
+using AffineModule = auto_diff::Affine<double, EquilibriumBackend<double>>;
+using CoupledModule = auto_diff::Coupled<double, EquilibriumBackend<double>>;
+
+class FixedPointTest : public testing::TestWithParam<AdjointSolver> {};
+
+TEST_P(FixedPointTest, ScalarEquilibrium) {
+    FixedPoint<double> equilibrium(std::make_shared<CosineModule>(), {.adjointSolver = GetParam()});
+    auto z0 = std::make_shared<Node<double>>(0.0);
+    auto a = std::make_shared<Node<double>>(0.5);
+    auto b = std::make_shared<Node<double>>(0.2);
+    auto z = equilibrium.Forward({z0, a, b})[0];
+    EXPECT_NEAR(z->data, 0.5 * std::cos(z->data) + 0.2, 1e-9);
+
+    EquilibriumBackend<double>::backwardCalls = 0;
+    z->Backward();
+    const double denominator = 1 + 0.5 * std::sin(z->data);
+    EXPECT_NEAR(a->grad, std::cos(z->data) / denominator, 1e-8);
+    EXPECT_NEAR(b->grad, 1 / denominator, 1e-8);
+    EXPECT_EQ(z0->grad, 0);
+    // the backward doesn't replay the forward iterations
+    EXPECT_LT(EquilibriumBackend<double>::backwardCalls, 100);
+}
+
+TEST_P(FixedPointTest, CoupledLinearSystem) {
+    FixedPoint<double> equilibrium(std::make_shared<CoupledModule>(), {.adjointSolver = GetParam()}, 2);
+    auto x0 = std::make_shared<Node<double>>(0.0);
+    auto y0 = std::make_shared<Node<double>>(0.0);
+    auto c = std::make_shared<Node<double>>(1.0);
+    auto outputs = equilibrium.Forward({x0, y0, c});
+    // x = 0.5 y + c, y = 0.25 x + 2 c  =>  x = 16 c / 7, y = 18 c / 7
+    EXPECT_NEAR(outputs[0]->data, 16.0 / 7, 1e-9);
+    EXPECT_NEAR(outputs[1]->data, 18.0 / 7, 1e-9);
+    outputs[1]->Backward();
+    EXPECT_NEAR(c->grad, 18.0 / 7, 1e-8);
+}
+
+INSTANTIATE_TEST_SUITE_P(AdjointSolvers, FixedPointTest, testing::Values(AdjointSolver::NEUMANN, AdjointSolver::BICGSTAB));
+
+TEST(FixedPointLimitsTest, IterationLimitThrows) {
+    // the map is contractive, but three iterations are not enough to converge
+    FixedPoint<double> equilibrium(std::make_shared<CosineModule>(), {.maxIterations = 3});
+    auto z0 = std::make_shared<Node<double>>(0.0);
+    auto a = std::make_shared<Node<double>>(0.9);
+    auto b = std::make_shared<Node<double>>(0.2);
+    EXPECT_THROW(auto unused = equilibrium.Forward({z0, a, b}), std::runtime_error);
+}
+
+TEST(FixedPointLimitsTest, DivergentMapThrows) {
+    // z = 3 * z + 1 overflows to infinity long before the iteration limit
+    FixedPoint<double> equilibrium(std::make_shared<AffineModule>());
+    auto z0 = std::make_shared<Node<double>>(0.0);
+    auto a = std::make_shared<Node<double>>(3.0);
+    auto b = std::make_shared<Node<double>>(1.0);
+    EXPECT_THROW(auto unused = equilibrium.Forward({z0, a, b}), std::runtime_error);
+}
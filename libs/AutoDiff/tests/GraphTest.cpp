@@ -0,0 +1,252 @@
+#include <gtest/gtest.h>
+
+#include "Graph.hpp"
+#include "IModule.hpp"
+
+using auto_diff::Graph;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+
+template <typename T>
+class GraphBackend {
+ public:
+    static inline size_t forwardCalls = 0;
+
+    static auto GraphSumForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        ++forwardCalls;
+        outputs.push_back(std::make_shared<Node<T>>());
+        for (const auto& input : inputs) {
+            outputs[0]->data += input->data;
+        }
+    }
+    static auto GraphSumBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        for (const auto& input : inputs) {
+            if (input->requiresGrad) {
+                input->grad += output->grad;
+            }
+        }
+    }
+
+    static auto GraphMultForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        ++forwardCalls;
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data * inputs[1]->data));
+    }
+    static auto GraphMultBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * inputs[1]->data;
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += output->grad * inputs[0]->data;
+        }
+    }
+
+    // two outputs, the quotient and the remainder
+    static auto GraphDivModForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        ++forwardCalls;
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data / inputs[1]->data, false));
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data % inputs[1]->data, false));
+    }
+    static auto GraphDivModBackward(const std::vector<NodePtr<T>>& /*inputs*/, Node<T>* /*output*/, size_t /*outputIdx*/) -> void {}
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(GraphSum)
+    DEFINE_MODULE(GraphMult)
+    DEFINE_MODULE(GraphDivMod)
+}  // namespace auto_diff
+
+using Sum = auto_diff::GraphSum<int, GraphBackend<int>>;
+using Mult = auto_diff::GraphMult<int, GraphBackend<int>>;
+using DivMod = auto_diff::GraphDivMod<int, GraphBackend<int>>;
+
+TEST(GraphTest, CaptureIsTopologicallySorted) {
+    Sum sum;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = std::make_shared<Node<int>>(2);
+    auto c = sum.Forward({a, b})[0];
+    auto d = sum.Forward({c, a})[0];
+    Graph<int> graph({d});
+    const auto& nodes = graph.Nodes();
+    ASSERT_EQ(nodes.size(), 4);
+    EXPECT_EQ(nodes[0], a.get());
+    EXPECT_EQ(nodes[1], b.get());
+    EXPECT_EQ(nodes[2], c.get());
+    EXPECT_EQ(nodes[3], d.get());
+}
+
+TEST(GraphTest, ReplayAfterLeafChange) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    Mult mult;
+    auto a = std::make_shared<Node<int>>(2);
+    auto b = std::make_shared<Node<int>>(3);
+    auto c = mult.Forward({a, b})[0];
+    auto d = sum.Forward({c, a})[0];
+    Graph<int> graph({d});
+    EXPECT_EQ(d->data, 8);
+    a->data = 5;
+    graph.Forward();
+    EXPECT_EQ(c->data, 15);
+    EXPECT_EQ(d->data, 20);
+    d->Backward();
+    EXPECT_EQ(a->grad, 4);
+    EXPECT_EQ(b->grad, 5);
+}
+
+TEST(GraphTest, FoldConstants) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    Mult mult;
+    auto mask = std::make_shared<Node<int>>(3, false);
+    auto input = std::make_shared<Node<int>>(1, false);
+    auto weight = std::make_shared<Node<int>>(2);
+    auto fixed = sum.Forward({mask, mask})[0];
+    auto scaled = mult.Forward({fixed, input})[0];
+    auto loss = mult.Forward({scaled, weight})[0];
+    Graph<int> graph({loss});
+
+    EXPECT_EQ(graph.FoldConstants({input}), 1);
+    EXPECT_FALSE(fixed->forwardFn);
+    EXPECT_TRUE(fixed->parents.empty());
+    EXPECT_EQ(graph.Nodes().size(), 5);
+
+    GraphBackend<int>::forwardCalls = 0;
+    input->data = 4;
+    graph.Forward();
+    EXPECT_EQ(GraphBackend<int>::forwardCalls, 2);
+    EXPECT_EQ(loss->data, 48);
+    loss->Backward();
+    EXPECT_EQ(weight->grad, 24);
+}
+
+TEST(GraphTest, FoldConstantsKeepsNodesRequiringGrad) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = std::make_shared<Node<int>>(2, false);
+    auto c = sum.Forward({a, b})[0];
+    Graph<int> graph({c});
+    EXPECT_EQ(graph.FoldConstants(), 0);
+    EXPECT_TRUE(c->forwardFn);
+}
+
+TEST(GraphTest, SetDataMarksDescendantsStale) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = std::make_shared<Node<int>>(2);
+    auto c = sum.Forward({a, a})[0];
+    auto d = sum.Forward({b, b})[0];
+    auto e = sum.Forward({c, d})[0];
+    a->SetData(10);
+    EXPECT_FALSE(a->stale);
+    EXPECT_TRUE(c->stale);
+    EXPECT_FALSE(d->stale);
+    EXPECT_TRUE(e->stale);
+}
+
+TEST(GraphTest, RecomputeOnlyStaleNodes) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    Mult mult;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = std::make_shared<Node<int>>(2);
+    auto c = mult.Forward({a, a})[0];
+    auto d = mult.Forward({b, b})[0];
+    auto e = sum.Forward({c, d})[0];
+    auto f = sum.Forward({e, c})[0];
+
+    GraphBackend<int>::forwardCalls = 0;
+    a->SetData(3);
+    auto_diff::Recompute(f);
+    EXPECT_EQ(GraphBackend<int>::forwardCalls, 3);
+    EXPECT_EQ(c->data, 9);
+    EXPECT_EQ(e->data, 13);
+    EXPECT_EQ(f->data, 22);
+    EXPECT_FALSE(c->stale);
+    EXPECT_FALSE(f->stale);
+
+    GraphBackend<int>::forwardCalls = 0;
+    auto_diff::Recompute(f);
+    EXPECT_EQ(GraphBackend<int>::forwardCalls, 0);
+}
+
+TEST(GraphTest, ConsumersOfStaleNodesAreRecomputed) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    Mult mult;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = sum.Forward({a, a})[0];
+    a->SetData(3);
+    // built from the stale `b`, so computed from its old value 2
+    auto c = mult.Forward({b, b})[0];
+    EXPECT_TRUE(c->stale);
+    a->SetData(4);
+    auto_diff::Recompute(c);
+    EXPECT_EQ(b->data, 8);
+    EXPECT_EQ(c->data, 64);
+}
+
+TEST(GraphTest, ReplayClearsStaleFlags) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = sum.Forward({a, a})[0];
+    Graph<int> graph({b});
+    a->SetData(4);
+    graph.Forward();
+    EXPECT_FALSE(b->stale);
+    EXPECT_EQ(b->data, 8);
+}
+
+TEST(GraphTest, ReplayRunsModuleOnceForAllOutputs) {
+    auto_diff::ReplayRecordingScope recording;
+    DivMod divMod;
+    auto a = std::make_shared<Node<int>>(7, false);
+    auto b = std::make_shared<Node<int>>(2, false);
+    const auto outputs = divMod.Forward({a, b});
+    Graph<int> both({outputs[0], outputs[1]});
+    Graph<int> remainder({outputs[1]});
+
+    GraphBackend<int>::forwardCalls = 0;
+    a->data = 11;
+    both.Forward();
+    EXPECT_EQ(GraphBackend<int>::forwardCalls, 1);
+    EXPECT_EQ(outputs[0]->data, 5);
+    EXPECT_EQ(outputs[1]->data, 1);
+
+    // a graph with only one of the outputs still sees new inputs
+    b->data = 4;
+    remainder.Forward();
+    EXPECT_EQ(outputs[1]->data, 3);
+    both.Forward();
+    EXPECT_EQ(GraphBackend<int>::forwardCalls, 3);
+    EXPECT_EQ(outputs[0]->data, 2);
+}
+
+TEST(GraphTest, DeadChildrenArePruned) {
+    auto_diff::ReplayRecordingScope recording;
+    Sum sum;
+    auto a = std::make_shared<Node<int>>(1);
+    for (size_t i = 0; i < 1000; ++i) {
+        auto unused = sum.Forward({a});
+    }
+    EXPECT_LE(a->children.size(), 2);
+}
+
+TEST(GraphTest, ReplayNeedsRecordingScope) {
+    Sum sum;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = sum.Forward({a, a})[0];
+    EXPECT_FALSE(b->forwardFn);
+    EXPECT_TRUE(a->children.empty());
+    Graph<int> graph({b});
+    EXPECT_THROW(graph.Forward(), std::logic_error);
+
+    auto_diff::ReplayRecordingScope recording;
+    {
+        auto_diff::ReplayRecordingScope suspended(false);
+        EXPECT_FALSE(sum.Forward({a, a})[0]->forwardFn);
+    }
+    EXPECT_TRUE(sum.Forward({a, a})[0]->forwardFn);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include "IModule.hpp"
+#include "Node.hpp"
+
+using auto_diff::ExpressionCache;
+using auto_diff::HashConsingScope;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+
+template <typename T>
+class CountingBackend {
+ public:
+    static inline size_t forwardCalls = 0;
+
+    static auto CountingSumForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        ++forwardCalls;
+        outputs.push_back(std::make_shared<Node<T>>());
+        for (const auto& input : inputs) {
+            outputs[0]->data += input->data;
+        }
+    }
+    static auto CountingSumBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        for (const auto& input : inputs) {
+            if (input->requiresGrad) {
+                input->grad += output->grad;
+            }
+        }
+    }
+
+    static auto CountingScaleForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs, int scale) -> void {
+        ++forwardCalls;
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data * scale));
+    }
+    static auto CountingScaleBackward(const std::vector<NodePtr<T>>& inputs,
+                                      Node<T>* output,
+                                      [[maybe_unused]] size_t outputIdx,
+                                      int scale) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * scale;
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(CountingSum)
+    DEFINE_MODULE_WITH_PARAMS(CountingScale, int)
+}  // namespace auto_diff
+
+class HashConsingTest : public testing::Test {
+ protected:
+    void SetUp() override { CountingBackend<int>::forwardCalls = 0; }
+};
+
+TEST_F(HashConsingTest, DisabledByDefault) {
+    auto_diff::CountingSum<int, CountingBackend<int>> module;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = std::make_shared<Node<int>>(2);
+    auto c = module.Forward({a, b})[0];
+    auto d = module.Forward({a, b})[0];
+    EXPECT_NE(c, d);
+    EXPECT_EQ(CountingBackend<int>::forwardCalls, 2);
+}
+
+TEST_F(HashConsingTest, RepeatedCallReturnsSameNode) {
+    HashConsingScope scope;
+    auto_diff::CountingSum<int, CountingBackend<int>> first;
+    auto_diff::CountingSum<int, CountingBackend<int>> second;
+    auto a = std::make_shared<Node<int>>(1);
+    auto b = std::make_shared<Node<int>>(2);
+    auto c = first.Forward({a, b})[0];
+    auto d = second.Forward({a, b})[0];
+    auto e = first.Forward({b, a})[0];
+    EXPECT_EQ(c, d);
+    EXPECT_NE(c, e);
+    EXPECT_EQ(CountingBackend<int>::forwardCalls, 2);
+}
+
+TEST_F(HashConsingTest, BackwardThroughSharedNode) {
+    HashConsingScope scope;
+    auto_diff::CountingSum<int, CountingBackend<int>> module;
+    auto a = std::make_shared<Node<int>>(3);
+    auto b = std::make_shared<Node<int>>(4);
+    auto c = module.Forward({a, b})[0];
+    auto d = module.Forward({a, b})[0];
+    auto e = module.Forward({c, d})[0];
+    e->Backward();
+    EXPECT_EQ(e->data, 14);
+    EXPECT_EQ(c->grad, 2);
+    EXPECT_EQ(a->grad, 2);
+    EXPECT_EQ(b->grad, 2);
+    EXPECT_EQ(CountingBackend<int>::forwardCalls, 2);
+}
+
+TEST_F(HashConsingTest, ParamsArePartOfKey) {
+    HashConsingScope scope;
+    auto_diff::CountingScale<int, CountingBackend<int>> twice(2);
+    auto_diff::CountingScale<int, CountingBackend<int>> alsoTwice(2);
+    auto_diff::CountingScale<int, CountingBackend<int>> thrice(3);
+    auto a = std::make_shared<Node<int>>(5);
+    auto b = twice.Forward({a})[0];
+    auto c = alsoTwice.Forward({a})[0];
+    auto d = thrice.Forward({a})[0];
+    EXPECT_EQ(b, c);
+    EXPECT_EQ(d->data, 15);
+    EXPECT_EQ(CountingBackend<int>::forwardCalls, 2);
+}
+
+TEST_F(HashConsingTest, CacheIsDroppedWithScope) {
+    auto_diff::CountingSum<int, CountingBackend<int>> module;
+    auto a = std::make_shared<Node<int>>(1);
+    NodePtr<int> c;
+    {
+        HashConsingScope scope;
+        c = module.Forward({a, a})[0];
+    }
+    HashConsingScope scope;
+    auto d = module.Forward({a, a})[0];
+    EXPECT_NE(c, d);
+    EXPECT_EQ(CountingBackend<int>::forwardCalls, 2);
+}
+
+TEST_F(HashConsingTest, ExpiredOutputIsRecomputed) {
+    HashConsingScope scope;
+    auto_diff::CountingSum<int, CountingBackend<int>> module;
+    auto a = std::make_shared<Node<int>>(1);
+    { auto unused = module.Forward({a, a}); }
+    auto c = module.Forward({a, a})[0];
+    EXPECT_EQ(c->data, 2);
+    EXPECT_EQ(CountingBackend<int>::forwardCalls, 2);
+}
+
+TEST_F(HashConsingTest, ExpiredEntriesArePrunedOnInsert) {
+    HashConsingScope scope;
+    ExpressionCache<int> cache;
+    auto a = std::make_shared<Node<int>>(1);
+    for (int i = 0; i < 10000; ++i) {
+        auto b = std::make_shared<Node<int>>(i);
+        cache.Insert({a, b}, {}, {std::make_shared<Node<int>>(i + 1)});
+    }
+    // every entry has expired right after its insertion, so at most one pruning interval of them is left
+    EXPECT_LE(cache.Size(), 64);
+}
+
+TEST_F(HashConsingTest, CachesAreClearedWhenOutermostScopeEnds) {
+    ExpressionCache<int> cache;
+    auto a = std::make_shared<Node<int>>(1);
+    auto c = std::make_shared<Node<int>>(2);
+    {
+        HashConsingScope outer;
+        {
+            HashConsingScope inner;
+            cache.Insert({a, a}, {}, {c});
+        }
+        EXPECT_EQ(cache.Size(), 1);
+    }
+    EXPECT_EQ(cache.Size(), 0);
+}
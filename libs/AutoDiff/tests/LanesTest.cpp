@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "ElemwiseBackend.hpp"
+#include "Graph.hpp"
+#include "Lanes.hpp"
+#include "Modules.hpp"
+#include "VectorSpace.hpp"
+
+using auto_diff::ElemwiseBackend;
+using auto_diff::Graph;
+using auto_diff::Lanes;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+
+using Batch = Lanes<double, 4>;
+
+template <typename T>
+struct Formula {
+    auto_diff::ElemwiseAdd<T, ElemwiseBackend<T>> add;
+    auto_diff::ElemwiseSub<T, ElemwiseBackend<T>> sub;
+    auto_diff::ElemwiseMult<T, ElemwiseBackend<T>> mult;
+    auto_diff::ElemwiseDiv<T, ElemwiseBackend<T>> div;
+
+    /// f(x, y) = (x * y - x) / (x + y)
+    auto operator()(const NodePtr<T>& x, const NodePtr<T>& y) -> NodePtr<T> {
+        auto numerator = sub.Forward({mult.Forward({x, y})[0], x})[0];
+        return div.Forward({numerator, add.Forward({x, y})[0]})[0];
+    }
+};
+
+TEST(LanesTest, Arithmetic) {
+    Batch a = Batch::Load(std::vector<double>{1, 2, 3, 4}.data());
+    Batch b = 2.0 * a - 1.0;
+    EXPECT_DOUBLE_EQ(b[3], 7.0);
+    Batch c = Select(a - 2.0, b, a);
+    EXPECT_DOUBLE_EQ(c[0], 1.0);
+    EXPECT_DOUBLE_EQ(c[1], 2.0);
+    EXPECT_DOUBLE_EQ(c[2], 5.0);
+    EXPECT_DOUBLE_EQ(auto_diff::MaxNorm(-a), 4.0);
+}
+
+TEST(LanesTest, LaneCountsOtherThanPowersOfTwo) {
+    using Triple = Lanes<double, 3>;
+    static_assert(alignof(Triple) == 32);
+    Triple a = Triple::Load(std::vector<double>{1, 2, 3}.data());
+    Triple b = a * a;
+    EXPECT_DOUBLE_EQ(b[2], 9.0);
+}
+
+TEST(LanesTest, MatchesScalarGraphs) {
+    auto_diff::ReplayRecordingScope recording;
+    const size_t count = 10 * Batch::size;
+    std::vector<double> xs(count), ys(count);
+    for (size_t i = 0; i < count; ++i) {
+        xs[i] = 0.5 + 0.1 * static_cast<double>(i);
+        ys[i] = 2.0 - 0.05 * static_cast<double>(i);
+    }
+
+    Formula<Batch> batchFormula;
+    auto x = std::make_shared<Node<Batch>>(Batch{});
+    auto y = std::make_shared<Node<Batch>>(Batch{1.0});
+    auto f = batchFormula(x, y);
+    Graph<Batch> graph({f});
+
+    std::vector<double> values(count), dx(count), dy(count);
+    for (size_t i = 0; i < count; i += Batch::size) {
+        x->data = Batch::Load(xs.data() + i);
+        y->data = Batch::Load(ys.data() + i);
+        graph.Forward();
+        for (Node<Batch>* node : graph.Nodes()) {
+            node->grad = 0;
+        }
+        f->Backward();
+        f->data.Store(values.data() + i);
+        x->grad.Store(dx.data() + i);
+        y->grad.Store(dy.data() + i);
+    }
+
+    Formula<double> scalarFormula;
+    for (size_t i = 0; i < count; ++i) {
+        auto xi = std::make_shared<Node<double>>(xs[i]);
+        auto yi = std::make_shared<Node<double>>(ys[i]);
+        auto fi = scalarFormula(xi, yi);
+        fi->Backward();
+        EXPECT_DOUBLE_EQ(values[i], fi->data);
+        EXPECT_DOUBLE_EQ(dx[i], xi->grad);
+        EXPECT_DOUBLE_EQ(dy[i], yi->grad);
+    }
+}
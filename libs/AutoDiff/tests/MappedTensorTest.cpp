@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "MappedTensor.hpp"
+#include "Matrix.hpp"
+#include "TemporaryPath.hpp"
+
+using auto_diff::Embedding;
+using auto_diff::MappedTensor;
+using auto_diff::MappingOptions;
+using auto_diff::Matrix;
+using auto_diff::Node;
+using auto_diff::tests::TemporaryPath;
+
+TEST(MappedTensorTest, WritesGoToTheFile) {
+    TemporaryPath path("mapped_tensor_writes");
+    {
+        auto table = MappedTensor<float>::Create(path.Get(), 1000, 4);
+        EXPECT_EQ(table.Row(999)[3], 0.0F);
+        table.Row(7)[2] = 1.5F;
+        table.Flush();
+    }
+    EXPECT_EQ(std::filesystem::file_size(path.Get()), 1000 * 4 * sizeof(float));
+    auto reopened = MappedTensor<float>::Open(path.Get(), 1000, 4, {.writable = false});
+    EXPECT_EQ(reopened.Row(7)[2], 1.5F);
+    EXPECT_THROW((void)reopened.Row(1000), std::out_of_range);
+    EXPECT_THROW(MappedTensor<float>::Open(path.Get(), 1000, 5), std::invalid_argument);
+}
+
+TEST(MappedTensorTest, OverflowingShapesAreRejected) {
+    TemporaryPath path("mapped_tensor_overflow");
+    // 2^62 * 4 * sizeof(float) wraps around to zero bytes
+    const size_t rows = size_t{1} << 62;
+    EXPECT_THROW(MappedTensor<float>::Create(path.Get(), rows, 4), std::invalid_argument);
+    EXPECT_FALSE(std::filesystem::exists(path.Get()));
+    std::ofstream{path.Get()};
+    EXPECT_THROW(MappedTensor<float>::Open(path.Get(), rows, 4), std::invalid_argument);
+}
+
+TEST(MappedTensorTest, EmbeddingSparseUpdate) {
+    TemporaryPath path("mapped_tensor_embedding");
+    auto table = std::make_shared<MappedTensor<float>>(MappedTensor<float>::Create(path.Get(), 100000, 2));
+    for (size_t i = 0; i < table->Rows(); ++i) {
+        table->Row(i)[0] = static_cast<float>(i);
+        table->Row(i)[1] = 1.0F;
+    }
+
+    Embedding<float> embedding(table);
+    auto indices = std::make_shared<Node<Matrix<float>>>(Matrix<float>(3, 1, {5, 42, 5}), false);
+    auto rows = embedding.Forward({indices})[0];
+    EXPECT_EQ(rows->data.values, (std::vector<float>{5, 1, 42, 1, 5, 1}));
+
+    rows->Backward();
+    // only the touched rows have a gradient, repeated rows accumulate
+    ASSERT_EQ(table->Grad().size(), 2);
+    EXPECT_EQ(table->Grad().at(5), (std::vector<float>{2, 2}));
+    EXPECT_EQ(table->Grad().at(42), (std::vector<float>{1, 1}));
+
+    EXPECT_EQ(auto_diff::SparseSgd(*table, 0.5F), 2);
+    EXPECT_TRUE(table->Grad().empty());
+    table->Flush();
+
+    auto reopened = MappedTensor<float>::Open(path.Get(), 100000, 2, {.writable = false});
+    EXPECT_EQ(reopened.Row(5)[0], 4.0F);
+    EXPECT_EQ(reopened.Row(42)[1], 0.5F);
+    EXPECT_EQ(reopened.Row(43)[0], 43.0F);
+
+    auto invalid = std::make_shared<Node<Matrix<float>>>(Matrix<float>(1, 1, {100000}), false);
+    EXPECT_THROW((void)embedding.Forward({invalid}), std::out_of_range);
+}
+
+TEST(MappedTensorTest, ReadOnlyTableCantBeUpdated) {
+    TemporaryPath path("mapped_tensor_read_only");
+    (void)MappedTensor<double>::Create(path.Get(), 4, 4);
+    MappedTensor<double> table = MappedTensor<double>::Open(path.Get(), 4, 4, MappingOptions{.writable = false, .hugePages = true});
+    table.AccumulateGrad(1, std::vector<double>(4, 1.0));
+    EXPECT_THROW(auto_diff::SparseSgd(table, 0.1), std::logic_error);
+}
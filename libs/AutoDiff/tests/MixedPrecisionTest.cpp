@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+#include "ElemwiseBackend.hpp"
+#include "IModule.hpp"
+#include "MixedPrecision.hpp"
+#include "Modules.hpp"
+
+using auto_diff::BFloat16;
+using auto_diff::ElemwiseBackend;
+using auto_diff::Float16;
+using auto_diff::LossScaler;
+using auto_diff::LossScalerOptions;
+using auto_diff::LowPrecisionTensor;
+using auto_diff::MasterWeights;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+
+using Tensor = LowPrecisionTensor<Float16>;
+
+template <typename T>
+class ReductionBackend {
+ public:
+    static auto SumOfSquaresForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(T(1, (inputs[0]->data * inputs[0]->data).Sum())));
+    }
+    static auto SumOfSquaresBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += T(1, 2.0F) * output->grad * inputs[0]->data;
+        }
+    }
+    static auto SumForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(T(1, inputs[0]->data.Sum())));
+    }
+    static auto SumBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad;
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(SumOfSquares)
+    DEFINE_MODULE(Sum)
+}  // namespace auto_diff
+
+TEST(MixedPrecisionTest, Float16Conversion) {
+    EXPECT_EQ(Float16(1.0F).Bits(), 0x3c00);
+    EXPECT_EQ(Float16(-2.0F).Bits(), 0xc000);
+    EXPECT_EQ(Float16(65504.0F).Bits(), 0x7bff);
+    EXPECT_EQ(Float16(65520.0F).Bits(), 0x7c00);
+    EXPECT_EQ(Float16(std::ldexp(1.0F, -24)).Bits(), 0x0001);
+    EXPECT_EQ(Float16(std::ldexp(1.0F, -26)).Bits(), 0x0000);
+    // 1 + 2^-11 is a tie between 1 and 1 + 2^-10, rounded to the even mantissa
+    EXPECT_EQ(Float16(1.0F + std::ldexp(1.0F, -11)).Bits(), 0x3c00);
+    EXPECT_EQ(Float16(1.0F + 3 * std::ldexp(1.0F, -11)).Bits(), 0x3c02);
+    EXPECT_TRUE(std::isnan(static_cast<float>(Float16(std::numeric_limits<float>::quiet_NaN()))));
+
+    for (uint32_t bits = 0; bits < 0x7c00; ++bits) {
+        const auto value = Float16::FromBits(static_cast<uint16_t>(bits));
+        ASSERT_EQ(Float16(static_cast<float>(value)).Bits(), bits);
+    }
+    EXPECT_FLOAT_EQ(Float16::FromBits(0x0001), std::ldexp(1.0F, -24));
+    EXPECT_TRUE(std::isinf(static_cast<float>(Float16::FromBits(0xfc00))));
+}
+
+TEST(MixedPrecisionTest, BFloat16Conversion) {
+    EXPECT_EQ(BFloat16(1.0F).Bits(), 0x3f80);
+    // range of float, 8 significant bits
+    EXPECT_NEAR(BFloat16(3.0e38F) / 3.0e38F, 1.0F, std::ldexp(1.0F, -8));
+    EXPECT_EQ(BFloat16(1.0F + std::ldexp(1.0F, -8)).Bits(), 0x3f80);
+    EXPECT_EQ(BFloat16(1.0F + 3 * std::ldexp(1.0F, -8)).Bits(), 0x3f82);
+    EXPECT_TRUE(std::isnan(static_cast<float>(BFloat16(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+TEST(MixedPrecisionTest, ScalarNodesComputeInFloat) {
+    auto_diff::ElemwiseMult<Float16, ElemwiseBackend<Float16>> mult;
+    auto a = std::make_shared<Node<Float16>>(Float16(3.0F));
+    auto b = std::make_shared<Node<Float16>>(Float16(0.5F));
+    auto c = mult.Forward({a, b})[0];
+    c->Backward();
+    EXPECT_FLOAT_EQ(c->data, 1.5F);
+    EXPECT_FLOAT_EQ(a->grad, 0.5F);
+    EXPECT_FLOAT_EQ(b->grad, 3.0F);
+}
+
+TEST(MixedPrecisionTest, TrainingWithLossScaling) {
+    auto_diff::ElemwiseMult<Tensor, ElemwiseBackend<Tensor>> mult;
+    auto_diff::ElemwiseSub<Tensor, ElemwiseBackend<Tensor>> sub;
+    auto_diff::SumOfSquares<Tensor, ReductionBackend<Tensor>> sumOfSquares;
+
+    const size_t size = 64;
+    std::vector<float> xs(size), ys(size);
+    for (size_t i = 0; i < size; ++i) {
+        xs[i] = 1.0F + 0.01F * static_cast<float>(i);
+        ys[i] = 0.3F * xs[i];
+    }
+    auto w = std::make_shared<Node<Tensor>>(Tensor(size, 1.0F));
+    auto x = std::make_shared<Node<Tensor>>(Tensor(xs), false);
+    auto y = std::make_shared<Node<Tensor>>(Tensor(ys), false);
+
+    MasterWeights<Float16> master({w});
+    LossScaler scaler({.initialScale = 65536.0F, .growthInterval = 1000});
+    size_t skipped = 0;
+    float loss = 0;
+    for (size_t step = 0; step < 200; ++step) {
+        w->grad = 0;
+        auto l = sumOfSquares.Forward({sub.Forward({mult.Forward({w, x})[0], y})[0]})[0];
+        loss = l->data[0];
+        scaler.Backward(*l);
+        const bool applied = master.Step(scaler, [](std::vector<float>& weight, const std::vector<float>& grad) {
+            for (size_t i = 0; i < weight.size(); ++i) {
+                weight[i] -= 0.1F * grad[i];
+            }
+        });
+        skipped += applied ? 0 : 1;
+    }
+    // the initial scale overflows Float16 gradients until it is reduced
+    EXPECT_GT(skipped, 0);
+    EXPECT_LT(scaler.Scale(), 65536.0F);
+    EXPECT_LT(loss, 1e-4F);
+    EXPECT_NEAR(master.Master(0)[size - 1], 0.3F, 1e-3F);
+}
+
+TEST(MixedPrecisionTest, DefaultScaleDoesNotOverflowFirstStep) {
+    auto_diff::ElemwiseMult<Tensor, ElemwiseBackend<Tensor>> mult;
+    auto_diff::Sum<Tensor, ReductionBackend<Tensor>> sum;
+    auto_diff::SumOfSquares<Tensor, ReductionBackend<Tensor>> sumOfSquares;
+    auto w = std::make_shared<Node<Tensor>>(Tensor(std::vector<float>{0.01F, -0.02F, 0.03F}));
+    MasterWeights<Float16> master({w});
+    LossScaler scaler;
+    auto step = [&master, &scaler](const NodePtr<Tensor>& loss) {
+        scaler.Backward(*loss);
+        return master.Step(scaler, [](std::vector<float>& weight, const std::vector<float>& grad) {
+            for (size_t i = 0; i < weight.size(); ++i) {
+                weight[i] -= 0.5F * grad[i];
+            }
+        });
+    };
+
+    w->grad = 0;
+    auto l = sum.Forward({mult.Forward({w, w})[0]})[0];
+    EXPECT_TRUE(step(l));
+    EXPECT_EQ(scaler.Scale(), LossScalerOptions{}.initialScale);
+    EXPECT_NEAR(master.Master(0)[2], 0.0F, 1e-4F);
+
+    // the backward of SumOfSquares doubles the seed first, which overflows until the scale is reduced
+    w->grad = 0;
+    EXPECT_FALSE(step(sumOfSquares.Forward({w})[0]));
+    EXPECT_EQ(scaler.Scale(), LossScalerOptions{}.initialScale / 2);
+    w->grad = 0;
+    EXPECT_TRUE(step(sumOfSquares.Forward({w})[0]));
+}
+
+TEST(MixedPrecisionTest, ScaleGrowsUpToTheStorageLimit) {
+    EXPECT_EQ(LossScalerOptions<Float16>{}.maxScale, 32768.0F);
+    EXPECT_EQ(LossScalerOptions<BFloat16>{}.maxScale, std::ldexp(1.0F, 127));
+    LossScaler scaler({.initialScale = 8192.0F, .growthInterval = 1});
+    for (int step = 0; step < 5; ++step) {
+        scaler.Update(false);
+    }
+    EXPECT_EQ(scaler.Scale(), 32768.0F);
+}
+
+TEST(MixedPrecisionTest, ScaleIsNotReducedBelowTheMinimum) {
+    EXPECT_EQ(LossScalerOptions{}.minScale, 1.0F);
+    LossScaler scaler({.initialScale = 8.0F, .minScale = 2.0F});
+    for (int step = 0; step < 200; ++step) {
+        scaler.Update(true);
+    }
+    EXPECT_EQ(scaler.Scale(), 2.0F);
+}
+
+TEST(MixedPrecisionTest, BroadcastOperandGradient) {
+    auto_diff::ElemwiseMult<Tensor, ElemwiseBackend<Tensor>> mult;
+    auto_diff::ElemwiseAdd<Tensor, ElemwiseBackend<Tensor>> add;
+    auto_diff::Sum<Tensor, ReductionBackend<Tensor>> sum;
+    auto x = std::make_shared<Node<Tensor>>(Tensor(std::vector<float>{1.0F, 2.0F, 3.0F}));
+    auto scale = std::make_shared<Node<Tensor>>(Tensor(1, 2.0F));
+    auto bias = std::make_shared<Node<Tensor>>(Tensor(1, 0.5F));
+    auto l = sum.Forward({add.Forward({mult.Forward({scale, x})[0], bias})[0]})[0];
+    l->Backward();
+    // the gradients of the one-element operands are summed over the three broadcast elements
+    ASSERT_EQ(scale->grad.Size(), 1);
+    ASSERT_EQ(bias->grad.Size(), 1);
+    EXPECT_EQ(scale->grad[0], 6.0F);
+    EXPECT_EQ(bias->grad[0], 3.0F);
+    EXPECT_EQ(x->grad.ToFloat(), (std::vector<float>{2.0F, 2.0F, 2.0F}));
+}
+
+TEST(MixedPrecisionTest, GradientsAreAccumulatedInFloat) {
+    using BTensor = LowPrecisionTensor<BFloat16>;
+    auto_diff::ElemwiseAdd<BTensor, ElemwiseBackend<BTensor>> add;
+    auto w = std::make_shared<Node<BTensor>>(BTensor(1, 1.0F));
+    // w is shared by 1000 nodes, a BFloat16 sum of the ones would stop at 256, where 256 + 1 rounds back to 256
+    NodePtr<BTensor> y = w;
+    for (int i = 0; i < 1000; ++i) {
+        y = add.Forward({y, w})[0];
+    }
+    y->Backward();
+    EXPECT_TRUE(w->grad.IsAccumulator());
+    EXPECT_FALSE(y->data.IsAccumulator());
+    EXPECT_EQ(w->grad[0], 1001.0F);
+}
+
+TEST(MixedPrecisionTest, OperandsOfDifferentSizesAreRejected) {
+    Tensor a(std::vector<float>{1.0F, 2.0F, 3.0F});
+    EXPECT_THROW(a += Tensor(2, 1.0F), std::invalid_argument);
+    EXPECT_THROW(a *= Tensor(), std::invalid_argument);
+    EXPECT_THROW(a -= Tensor(4, 1.0F), std::invalid_argument);
+    a += Tensor(1, 1.0F);
+    EXPECT_EQ(a[2], 4.0F);
+}
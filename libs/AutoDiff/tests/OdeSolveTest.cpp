@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "IModule.hpp"
+#include "OdeSolve.hpp"
+
+using auto_diff::Node;
+using auto_diff::NodePtr;
+using auto_diff::OdeMethod;
+using auto_diff::OdeSolve;
+
+template <typename T>
+class DynamicsBackend {
+ public:
+    // y' = -k * y
+    static auto DecayForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(-inputs[1]->data * inputs[0]->data));
+    }
+    static auto DecayBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += -inputs[1]->data * output->grad;
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += -inputs[0]->data * output->grad;
+        }
+    }
+
+    // x' = v, v' = -w * x
+    static auto SpringForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[1]->data));
+        outputs.push_back(std::make_shared<Node<T>>(-inputs[2]->data * inputs[0]->data));
+    }
+    static auto SpringBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, size_t outputIdx) -> void {
+        if (outputIdx == 0) {
+            if (inputs[1]->requiresGrad) {
+                inputs[1]->grad += output->grad;
+            }
+            return;
+        }
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += -inputs[2]->data * output->grad;
+        }
+        if (inputs[2]->requiresGrad) {
+            inputs[2]->grad += -inputs[0]->data * output->grad;
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(Decay)
+    DEFINE_MODULE(Spring)
+}  // namespace auto_diff
+
+using DecayModule = auto_diff::Decay<double, DynamicsBackend<double>>;
+using SpringModule = auto_diff::Spring<double, DynamicsBackend<double>>;
+
+class OdeSolveTest : public testing::TestWithParam<OdeMethod> {};
+
+TEST_P(OdeSolveTest, ExponentialDecay) {
+    const double y0 = 2.0;
+    const double k = 0.7;
+    const double t1 = 3.0;
+    OdeSolve<double> solve(std::make_shared<DecayModule>(), {.method = GetParam(), .t1 = t1, .steps = 200});
+    auto y = std::make_shared<Node<double>>(y0);
+    auto rate = std::make_shared<Node<double>>(k);
+    auto solution = solve.Forward({y, rate})[0];
+    solution->Backward();
+
+    const double expected = y0 * std::exp(-k * t1);
+    EXPECT_NEAR(solution->data, expected, 1e-6);
+    EXPECT_NEAR(y->grad, std::exp(-k * t1), 1e-6);
+    EXPECT_NEAR(rate->grad, -t1 * expected, 1e-5);
+}
+
+TEST_P(OdeSolveTest, HarmonicOscillatorMatchesFiniteDifferences) {
+    auto solveFor = [](double x0, double v0, double w, double* gradX = nullptr, double* gradV = nullptr, double* gradW = nullptr) {
+        OdeSolve<double> solve(std::make_shared<SpringModule>(), {.method = GetParam(), .t1 = 2.0, .steps = 100}, 2);
+        auto x = std::make_shared<Node<double>>(x0);
+        auto v = std::make_shared<Node<double>>(v0);
+        auto stiffness = std::make_shared<Node<double>>(w);
+        auto solution = solve.Forward({x, v, stiffness});
+        // only the position receives a gradient, the velocity output gets zero
+        solution[0]->Backward();
+        if (gradX) *gradX = x->grad;
+        if (gradV) *gradV = v->grad;
+        if (gradW) *gradW = stiffness->grad;
+        return solution[0]->data;
+    };
+
+    double gradX = 0;
+    double gradV = 0;
+    double gradW = 0;
+    solveFor(1.0, 0.5, 1.5, &gradX, &gradV, &gradW);
+    const double eps = 1e-5;
+    EXPECT_NEAR(gradX, (solveFor(1.0 + eps, 0.5, 1.5) - solveFor(1.0 - eps, 0.5, 1.5)) / (2 * eps), 1e-5);
+    EXPECT_NEAR(gradV, (solveFor(1.0, 0.5 + eps, 1.5) - solveFor(1.0, 0.5 - eps, 1.5)) / (2 * eps), 1e-5);
+    EXPECT_NEAR(gradW, (solveFor(1.0, 0.5, 1.5 + eps) - solveFor(1.0, 0.5, 1.5 - eps)) / (2 * eps), 1e-5);
+}
+
+INSTANTIATE_TEST_SUITE_P(Methods, OdeSolveTest, testing::Values(OdeMethod::RK4, OdeMethod::DORMAND_PRINCE));
+
+TEST(OdeSolveLimitsTest, MaxStepsExceededThrows) {
+    OdeSolve<double> solve(std::make_shared<DecayModule>(), {.t1 = 100.0, .relativeTolerance = 1e-12, .maxSteps = 5});
+    auto y = std::make_shared<Node<double>>(1.0);
+    auto rate = std::make_shared<Node<double>>(1.0);
+    EXPECT_THROW(auto unused = solve.Forward({y, rate}), std::runtime_error);
+}
+
+TEST(OdeSolveLimitsTest, OverflowingSolutionThrows) {
+    // y' = 1000 * y overflows double before t1, steps reaching infinity are rejected until the step size underflows
+    OdeSolve<double> solve(std::make_shared<DecayModule>());
+    auto y = std::make_shared<Node<double>>(1.0);
+    auto rate = std::make_shared<Node<double>>(-1000.0);
+    EXPECT_THROW(auto unused = solve.Forward({y, rate}), std::runtime_error);
+}
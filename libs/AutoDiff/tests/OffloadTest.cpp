@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "Matrix.hpp"
+#include "Modules.hpp"
+#include "Offload.hpp"
+#include "SavedData.hpp"
+
+using auto_diff::CompressSaved;
+using auto_diff::FileOffloadCodec;
+using auto_diff::Matrix;
+using auto_diff::MatrixBackend;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+using auto_diff::OffloadOptions;
+using auto_diff::PackSavedData;
+
+using Tensor = Matrix<float>;
+
+namespace {
+
+    auto RandomMatrix(size_t rows, size_t cols, std::mt19937& generator) -> Tensor {
+        std::uniform_real_distribution<float> distribution(0.5F, 1.5F);
+        Tensor m(rows, cols);
+        for (float& value : m.values) {
+            value = distribution(generator);
+        }
+        return m;
+    }
+
+    /// h_{k+1} = h_k * w_k for `depth` layers
+    auto Deep(auto_diff::IModule<Tensor>& mult, const NodePtr<Tensor>& x, const std::vector<NodePtr<Tensor>>& weights) {
+        NodePtr<Tensor> h = x;
+        for (const auto& w : weights) {
+            h = mult.Forward({h, w})[0];
+        }
+        return h;
+    }
+
+}  // namespace
+
+TEST(OffloadTest, BackwardMatchesInMemory) {
+    std::mt19937 generator(1);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(32, 32, generator), false);
+    std::vector<NodePtr<Tensor>> weights;
+    for (size_t i = 0; i < 40; ++i) {
+        weights.push_back(std::make_shared<Node<Tensor>>(RandomMatrix(32, 32, generator)));
+    }
+
+    auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>> mult;
+    Deep(mult, x, weights)->Backward();
+    std::vector<Tensor> expected;
+    for (const auto& w : weights) {
+        expected.push_back(w->grad);
+        w->grad = 0;
+    }
+
+    // a small write budget makes packing wait for the I/O thread
+    auto offload = std::make_shared<FileOffloadCodec<float>>(OffloadOptions{.maxPendingBytes = 3 * 32 * 32 * sizeof(float)});
+    CompressSaved<Tensor> offloadedMult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(), offload);
+    {
+        auto y = Deep(offloadedMult, x, weights);
+        EXPECT_EQ(PackSavedData<Tensor>({y}), weights.size() - 1);
+        EXPECT_TRUE(y->parents[0]->data.values.empty());
+        EXPECT_EQ(offload->BytesInUse(), (weights.size() - 1) * 32 * 32 * sizeof(float));
+
+        y->Backward();
+        for (size_t i = 0; i < weights.size(); ++i) {
+            EXPECT_EQ(weights[i]->grad.values, expected[i].values) << i;
+        }
+        EXPECT_EQ(offload->BytesInUse(), 0);
+    }
+
+    // space is reused after the graph has been dropped without backward
+    {
+        auto y = Deep(offloadedMult, x, weights);
+        PackSavedData<Tensor>({y});
+    }
+    EXPECT_EQ(offload->BytesInUse(), 0);
+}
+
+TEST(OffloadTest, MissingDirectoryThrows) {
+    EXPECT_THROW(FileOffloadCodec<float>(OffloadOptions{.directory = "/nonexistent/auto_diff"}), std::system_error);
+}
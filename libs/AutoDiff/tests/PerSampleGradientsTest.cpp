@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "ElemwiseBackend.hpp"
+#include "Graph.hpp"
+#include "Lanes.hpp"
+#include "Matrix.hpp"
+#include "Modules.hpp"
+#include "PerSampleGradients.hpp"
+
+using auto_diff::ClipAndAccumulate;
+using auto_diff::ClipAndAccumulateMatMul;
+using auto_diff::ElemwiseBackend;
+using auto_diff::Graph;
+using auto_diff::Lanes;
+using auto_diff::Node;
+using auto_diff::NodePtrVector;
+using auto_diff::PerSampleNorms;
+
+using Chunk = Lanes<double, 4>;
+
+TEST(PerSampleGradientsTest, ClippedSumOverChunks) {
+    auto_diff::ReplayRecordingScope recording;
+    auto_diff::ElemwiseAdd<Chunk, ElemwiseBackend<Chunk>> add;
+    auto_diff::ElemwiseSub<Chunk, ElemwiseBackend<Chunk>> sub;
+    auto_diff::ElemwiseMult<Chunk, ElemwiseBackend<Chunk>> mult;
+
+    // loss = (w * x + b - y)^2
+    const double wValue = 0.5;
+    const double bValue = -0.2;
+    auto w = std::make_shared<Node<Chunk>>(Chunk(wValue));
+    auto b = std::make_shared<Node<Chunk>>(Chunk(bValue));
+    auto x = std::make_shared<Node<Chunk>>(Chunk(0.0), false);
+    auto y = std::make_shared<Node<Chunk>>(Chunk(0.0), false);
+    auto residual = sub.Forward({add.Forward({mult.Forward({w, x})[0], b})[0], y})[0];
+    auto loss = mult.Forward({residual, residual})[0];
+    Graph<Chunk> graph({loss});
+    NodePtrVector<Chunk> params{w, b};
+
+    const size_t batchSize = 10;
+    const double maxNorm = 1.0;
+    std::vector<double> xs(batchSize + Chunk::size), ys(batchSize + Chunk::size);
+    for (size_t i = 0; i < batchSize; ++i) {
+        xs[i] = -1.0 + 0.3 * static_cast<double>(i);
+        ys[i] = std::sin(static_cast<double>(i));
+    }
+
+    std::vector<double> clippedSum(params.size());
+    std::vector<double> norms;
+    for (size_t i = 0; i < batchSize; i += Chunk::size) {
+        x->data = Chunk::Load(xs.data() + i);
+        y->data = Chunk::Load(ys.data() + i);
+        graph.Forward();
+        for (Node<Chunk>* node : graph.Nodes()) {
+            node->grad = 0;
+        }
+        loss->Backward();
+        const size_t active = std::min(Chunk::size, batchSize - i);
+        Chunk chunkNorms = ClipAndAccumulate(params, maxNorm, clippedSum, active);
+        EXPECT_DOUBLE_EQ(PerSampleNorms(params)[0], chunkNorms[0]);
+        norms.insert(norms.end(), chunkNorms.begin(), chunkNorms.begin() + static_cast<std::ptrdiff_t>(active));
+    }
+
+    std::vector<double> expected(params.size());
+    for (size_t i = 0; i < batchSize; ++i) {
+        const double r = wValue * xs[i] + bValue - ys[i];
+        const double dw = 2 * r * xs[i];
+        const double db = 2 * r;
+        const double norm = std::hypot(dw, db);
+        EXPECT_NEAR(norms[i], norm, 1e-12);
+        const double scale = std::min(1.0, maxNorm / norm);
+        expected[0] += scale * dw;
+        expected[1] += scale * db;
+    }
+    EXPECT_NEAR(clippedSum[0], expected[0], 1e-12);
+    EXPECT_NEAR(clippedSum[1], expected[1], 1e-12);
+}
+
+TEST(PerSampleGradientsTest, InactiveLanesAreIgnored) {
+    // padding lanes of the last chunk, e.g. log(0) of zero-filled inputs
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    auto w = std::make_shared<Node<Chunk>>(Chunk(0.0));
+    auto b = std::make_shared<Node<Chunk>>(Chunk(0.0));
+    const std::vector<double> wGrad{3.0, 0.5, nan, inf};
+    const std::vector<double> bGrad{4.0, 0.0, inf, nan};
+    w->grad = Chunk::Load(wGrad.data());
+    b->grad = Chunk::Load(bGrad.data());
+
+    std::vector<double> clippedSum(2);
+    const Chunk norms = ClipAndAccumulate(NodePtrVector<Chunk>{w, b}, 1.0, clippedSum, 2);
+    EXPECT_DOUBLE_EQ(norms[0], 5.0);
+    EXPECT_DOUBLE_EQ(norms[1], 0.5);
+    EXPECT_EQ(norms[2], 0.0);
+    EXPECT_EQ(norms[3], 0.0);
+    EXPECT_DOUBLE_EQ(clippedSum[0], 0.6 + 0.5);
+    EXPECT_DOUBLE_EQ(clippedSum[1], 0.8);
+}
+
+TEST(PerSampleGradientsTest, MatMulClippedSumMatchesPerSampleBackward) {
+    using Tensor = auto_diff::Matrix<double>;
+    using Backend = auto_diff::MatrixBackend<double>;
+    auto_diff::MatMul<Tensor, Backend> matMul;
+    auto_diff::ElemwiseSub<Tensor, Backend> sub;
+    auto_diff::ElemwiseMult<Tensor, Backend> mult;
+
+    const Tensor w1Value(3, 2, {0.5, -0.3, 0.2, 0.8, -0.6, 0.1});
+    const Tensor w2Value(2, 1, {1.5, -0.7});
+    const Tensor xs(4, 3, {1, 2, 0, -1, 0.5, 2, 0.3, -0.2, 0.1, 3, 1, -2});
+    const Tensor ts(4, 1, {0.5, -1, 0, 2});
+    // loss = sum over samples of (x w1 w2 - t)^2, returns the two MatMul outputs
+    auto model = [&](const Tensor& x, const Tensor& t, const auto& w1, const auto& w2) {
+        auto hidden = matMul.Forward({std::make_shared<Node<Tensor>>(x, false), w1})[0];
+        auto y = matMul.Forward({hidden, w2})[0];
+        auto residual = sub.Forward({y, std::make_shared<Node<Tensor>>(t, false)})[0];
+        mult.Forward({residual, residual})[0]->Backward();
+        return NodePtrVector<Tensor>{hidden, y};
+    };
+
+    const double maxNorm = 2.0;
+    auto w1 = std::make_shared<Node<Tensor>>(w1Value);
+    auto w2 = std::make_shared<Node<Tensor>>(w2Value);
+    std::vector<Tensor> sums(2);
+    const std::vector<double> norms = ClipAndAccumulateMatMul(model(xs, ts, w1, w2), maxNorm, sums);
+    // some samples are clipped, some are not
+    EXPECT_GT(*std::ranges::max_element(norms), maxNorm);
+    EXPECT_LT(*std::ranges::min_element(norms), maxNorm);
+
+    // reference: one backward pass per sample
+    Tensor expected1(3, 2);
+    Tensor expected2(2, 1);
+    for (size_t b = 0; b < xs.rows; ++b) {
+        auto sampleW1 = std::make_shared<Node<Tensor>>(w1Value);
+        auto sampleW2 = std::make_shared<Node<Tensor>>(w2Value);
+        const Tensor x(1, 3, {xs(b, 0), xs(b, 1), xs(b, 2)});
+        static_cast<void>(model(x, Tensor(1, 1, {ts(b, 0)}), sampleW1, sampleW2));
+        double squaredNorm = 0;
+        for (const double value : sampleW1->grad.values) {
+            squaredNorm += value * value;
+        }
+        for (const double value : sampleW2->grad.values) {
+            squaredNorm += value * value;
+        }
+        EXPECT_NEAR(norms[b], std::sqrt(squaredNorm), 1e-12);
+        const double scale = std::min(1.0, maxNorm / std::sqrt(squaredNorm));
+        for (size_t i = 0; i < expected1.values.size(); ++i) {
+            expected1.values[i] += scale * sampleW1->grad.values[i];
+        }
+        for (size_t i = 0; i < expected2.values.size(); ++i) {
+            expected2.values[i] += scale * sampleW2->grad.values[i];
+        }
+    }
+    for (size_t i = 0; i < expected1.values.size(); ++i) {
+        EXPECT_NEAR(sums[0].values[i], expected1.values[i], 1e-12);
+    }
+    for (size_t i = 0; i < expected2.values.size(); ++i) {
+        EXPECT_NEAR(sums[1].values[i], expected2.values[i], 1e-12);
+    }
+}
@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <thread>
+
+#include "BatchExecutor.hpp"
+#include "Matrix.hpp"
+#include "Modules.hpp"
+#include "Quantization.hpp"
+
+using auto_diff::BatchExecutor;
+using auto_diff::CalibrationMethod;
+using auto_diff::Int8Backend;
+using auto_diff::Matrix;
+using auto_diff::MatrixBackend;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+using auto_diff::QuantizeWeights;
+
+namespace {
+
+    auto RandomMatrix(size_t rows, size_t cols, std::mt19937& generator) -> Matrix<float> {
+        std::normal_distribution<float> distribution;
+        Matrix<float> m(rows, cols);
+        for (float& value : m.values) {
+            value = distribution(generator);
+        }
+        return m;
+    }
+
+    /// y = x w + b with the modules of `Backend`.
+    template <typename Backend>
+    auto Linear(const NodePtr<Matrix<float>>& x, const NodePtr<Matrix<float>>& w, const NodePtr<Matrix<float>>& b) {
+        auto_diff::MatMul<Matrix<float>, Backend> matMul;
+        auto_diff::ElemwiseAdd<Matrix<float>, Backend> add;
+        return add.Forward({matMul.Forward({x, w})[0], b})[0];
+    }
+
+}  // namespace
+
+TEST(QuantizationTest, MatMulBackward) {
+    auto x = std::make_shared<Node<Matrix<float>>>(Matrix<float>(1, 2, {1, 2}));
+    auto w = std::make_shared<Node<Matrix<float>>>(Matrix<float>(2, 2, {1, 2, 3, 4}));
+    auto y = auto_diff::MatMul<Matrix<float>, MatrixBackend<float>>().Forward({x, w})[0];
+    EXPECT_EQ(y->data.values, (std::vector<float>{7, 10}));
+    y->Backward();
+    // dy/dx = 1 w^T, dy/dw = x^T 1
+    EXPECT_EQ(x->grad.values, (std::vector<float>{3, 7}));
+    EXPECT_EQ(w->grad.values, (std::vector<float>{1, 1, 2, 2}));
+}
+
+TEST(QuantizationTest, BroadcastOperandGradient) {
+    auto x = std::make_shared<Node<Matrix<float>>>(Matrix<float>(2, 3, {1, 2, 3, 4, 5, 6}));
+    auto scale = std::make_shared<Node<Matrix<float>>>(Matrix<float>(1, 1, 2.0F));
+    auto bias = std::make_shared<Node<Matrix<float>>>(Matrix<float>(1, 1, 1.0F));
+    auto scaled = auto_diff::ElemwiseMult<Matrix<float>, MatrixBackend<float>>().Forward({scale, x})[0];
+    auto y = auto_diff::ElemwiseSub<Matrix<float>, MatrixBackend<float>>().Forward({scaled, bias})[0];
+    y->Backward();
+    // the gradients of the 1x1 operands are summed over the six broadcast elements
+    EXPECT_EQ(scale->grad.rows, 1);
+    EXPECT_EQ(scale->grad.cols, 1);
+    EXPECT_EQ(scale->grad.values, (std::vector<float>{21}));
+    EXPECT_EQ(bias->grad.values, (std::vector<float>{-6}));
+    EXPECT_EQ(x->grad.values, (std::vector<float>(6, 2)));
+}
+
+TEST(QuantizationTest, DotProductImplementationsAgree) {
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> distribution(-127, 127);
+    for (size_t size : {0, 1, 15, 16, 17, 100, 1000}) {
+        std::vector<int8_t> a(size), b(size);
+        for (size_t i = 0; i < size; ++i) {
+            a[i] = static_cast<int8_t>(distribution(generator));
+            b[i] = static_cast<int8_t>(distribution(generator));
+        }
+        EXPECT_EQ(auto_diff::detail::DotInt8(a.data(), b.data(), size), auto_diff::detail::DotInt8Scalar(a.data(), b.data(), size));
+    }
+}
+
+TEST(QuantizationTest, Int8BackendMatchesFloat) {
+    std::mt19937 generator(2);
+    auto x = std::make_shared<Node<Matrix<float>>>(RandomMatrix(8, 64, generator), false);
+    auto w = std::make_shared<Node<Matrix<float>>>(RandomMatrix(64, 32, generator), false);
+    auto b = std::make_shared<Node<Matrix<float>>>(RandomMatrix(8, 32, generator), false);
+    // one channel with a much larger range gets its own scale
+    for (size_t k = 0; k < 64; ++k) {
+        w->data(k, 0) *= 100;
+    }
+
+    const Matrix<float> expected = Linear<MatrixBackend<float>>(x, w, b)->data;
+    QuantizeWeights({w});
+    const auto quantized = Int8Backend::Quantized(w);
+    ASSERT_TRUE(quantized);
+    EXPECT_GT(quantized->scales[0], 50 * quantized->scales[1]);
+    const Matrix<float> actual = Linear<Int8Backend>(x, w, b)->data;
+
+    for (size_t j = 0; j < 32; ++j) {
+        double error = 0;
+        double norm = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            error += std::pow(actual(i, j) - expected(i, j), 2);
+            norm += std::pow(expected(i, j), 2);
+        }
+        EXPECT_LT(std::sqrt(error / norm), 0.03) << j;
+    }
+}
+
+TEST(QuantizationTest, MinMseIsNotWorseThanMaxAbs) {
+    std::mt19937 generator(3);
+    std::student_t_distribution<float> heavyTailed(2.0F);
+    Matrix<float> w(20000, 1);
+    for (float& value : w.values) {
+        value = heavyTailed(generator);
+    }
+    auto error = [&w](const auto_diff::QuantizedMatrix& q) {
+        double sum = 0;
+        for (size_t k = 0; k < w.rows; ++k) {
+            sum += std::pow(w(k, 0) - q.weights[k] * q.scales[0], 2);
+        }
+        return sum;
+    };
+    auto maxAbs = auto_diff::Quantize(w, {.calibration = CalibrationMethod::MAX_ABS});
+    auto minMse = auto_diff::Quantize(w, {.calibration = CalibrationMethod::MIN_MSE, .minClipFraction = 0.05F});
+    float largest = 0;
+    for (float value : w.values) {
+        largest = std::max(largest, std::abs(value));
+    }
+    EXPECT_FLOAT_EQ(maxAbs.scales[0], largest / 127);
+    // outliers of a heavy-tailed distribution are clipped for a finer resolution of the bulk
+    EXPECT_LT(minMse.scales[0], maxAbs.scales[0]);
+    EXPECT_LT(error(minMse), error(maxAbs));
+}
+
+TEST(QuantizationTest, BackwardThroughQuantizedWeightsThrows) {
+    std::mt19937 generator(4);
+    auto x = std::make_shared<Node<Matrix<float>>>(RandomMatrix(2, 4, generator));
+    auto w = std::make_shared<Node<Matrix<float>>>(RandomMatrix(4, 3, generator));
+    QuantizeWeights({w});
+    auto y = auto_diff::MatMul<Matrix<float>, Int8Backend>().Forward({x, w})[0];
+    EXPECT_THROW(y->Backward(), std::logic_error);
+}
+
+TEST(QuantizationTest, BatchedMatMulUsesQuantizedWeights) {
+    std::mt19937 generator(5);
+    auto w = std::make_shared<Node<Matrix<float>>>(RandomMatrix(4, 3, generator));
+    QuantizeWeights({w});
+    auto_diff::NodePtrVector<Matrix<float>> ys;
+    for (size_t rows = 1; rows <= 4; ++rows) {
+        auto x = std::make_shared<Node<Matrix<float>>>(RandomMatrix(rows, 4, generator), false);
+        ys.push_back(auto_diff::MatMul<Matrix<float>, Int8Backend>().Forward({x, w})[0]);
+    }
+    std::vector<Matrix<float>> expected;
+    for (const auto& y : ys) {
+        expected.push_back(y->data);
+    }
+
+    BatchExecutor<Matrix<float>> executor(ys);
+    EXPECT_EQ(executor.NumForwardCalls(), 1);
+    executor.Forward();
+    for (size_t i = 0; i < ys.size(); ++i) {
+        EXPECT_EQ(ys[i]->data.values, expected[i].values);
+    }
+}
+
+TEST(QuantizationTest, WeightsAreRequantizedExplicitly) {
+    std::mt19937 generator(6);
+    auto x = std::make_shared<Node<Matrix<float>>>(RandomMatrix(2, 4, generator), false);
+    auto w = std::make_shared<Node<Matrix<float>>>(RandomMatrix(4, 3, generator), false);
+    auto_diff::MatMul<Matrix<float>, Int8Backend> matMul;
+    QuantizeWeights({w});
+    const Matrix<float> before = matMul.Forward({x, w})[0]->data;
+
+    // the int8 copy is kept by the backend, writes to the float values don't reach it until the next QuantizeWeights
+    for (float& value : w->data.values) {
+        value *= 2;
+    }
+    EXPECT_EQ(matMul.Forward({x, w})[0]->data.values, before.values);
+    QuantizeWeights({w});
+    const Matrix<float> after = matMul.Forward({x, w})[0]->data;
+    for (size_t i = 0; i < after.values.size(); ++i) {
+        EXPECT_FLOAT_EQ(after.values[i], 2 * before.values[i]);
+    }
+
+    // a copy of the float values in another node is not quantized
+    auto copy = std::make_shared<Node<Matrix<float>>>(w->data, false);
+    EXPECT_EQ(Int8Backend::Quantized(copy), nullptr);
+}
+
+TEST(QuantizationTest, NonFiniteValues) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    EXPECT_THROW(static_cast<void>(auto_diff::Quantize(Matrix<float>(2, 1, {1, nan}))), std::invalid_argument);
+    EXPECT_THROW(static_cast<void>(auto_diff::Quantize(Matrix<float>(2, 1, {inf, 1}))), std::invalid_argument);
+
+    // a non-finite activation makes its row NaN as in float, the other rows are unaffected
+    const auto_diff::QuantizedMatrix w = auto_diff::Quantize(Matrix<float>(3, 1, {1, 1, 1}));
+    const Matrix<float> y = Int8Backend::Multiply(Matrix<float>(4, 3, {2, 1, -inf, nan, nan, nan, 2, 1, 0, 0, 0, 0}), w);
+    EXPECT_TRUE(std::isnan(y(0, 0)));
+    EXPECT_TRUE(std::isnan(y(1, 0)));
+    EXPECT_NEAR(y(2, 0), 3.0F, 0.05F);
+    EXPECT_EQ(y(3, 0), 0.0F);
+}
+
+TEST(QuantizationTest, WeightsAreRequantizedDuringInference) {
+    std::mt19937 generator(7);
+    auto x = std::make_shared<Node<Matrix<float>>>(RandomMatrix(2, 4, generator), false);
+    auto w = std::make_shared<Node<Matrix<float>>>(RandomMatrix(4, 3, generator), false);
+    auto other = std::make_shared<Node<Matrix<float>>>(RandomMatrix(4, 3, generator), false);
+    QuantizeWeights({w});
+    auto_diff::MatMul<Matrix<float>, Int8Backend> matMul;
+    const Matrix<float> expected = matMul.Forward({x, w})[0]->data;
+
+    std::thread quantizer([&other]() {
+        for (size_t i = 0; i < 100; ++i) {
+            QuantizeWeights({other});
+        }
+    });
+    for (size_t i = 0; i < 100; ++i) {
+        EXPECT_EQ(matMul.Forward({x, w})[0]->data.values, expected.values);
+    }
+    quantizer.join();
+}
+
+TEST(QuantizationTest, CopiesOfFreedWeightsAreErasedOnLookup) {
+    std::mt19937 generator(8);
+    auto kept = std::make_shared<Node<Matrix<float>>>(RandomMatrix(4, 3, generator), false);
+    auto freed = std::make_shared<Node<Matrix<float>>>(RandomMatrix(4, 3, generator), false);
+    QuantizeWeights({kept, freed});
+    const size_t count = Int8Backend::QuantizedCount();
+    freed.reset();
+    EXPECT_EQ(Int8Backend::QuantizedCount(), count);
+
+    for (size_t i = 0; i < Int8Backend::PRUNE_INTERVAL; ++i) {
+        EXPECT_NE(Int8Backend::Quantized(kept), nullptr);
+    }
+    EXPECT_EQ(Int8Backend::QuantizedCount(), count - 1);
+}
@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "Graph.hpp"
+#include "Matrix.hpp"
+#include "Modules.hpp"
+#include "SavedData.hpp"
+
+using auto_diff::CompressSaved;
+using auto_diff::HalfPrecisionCodec;
+using auto_diff::Int8Codec;
+using auto_diff::Matrix;
+using auto_diff::MatrixBackend;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+using auto_diff::PackSavedData;
+using auto_diff::SignMaskCodec;
+
+using Tensor = Matrix<float>;
+
+class ReluBackend : public MatrixBackend<float> {
+ public:
+    static auto ReluForward(const std::vector<NodePtr<Tensor>>& inputs, std::vector<NodePtr<Tensor>>& outputs) -> void {
+        Tensor y = inputs[0]->data;
+        for (float& value : y.values) {
+            value = std::max(value, 0.0F);
+        }
+        outputs.push_back(std::make_shared<Node<Tensor>>(y));
+    }
+    // reads only the sign of the input
+    static auto ReluBackward(const std::vector<NodePtr<Tensor>>& inputs, Node<Tensor>* output, [[maybe_unused]] size_t outputIdx)
+        -> void {
+        if (inputs[0]->requiresGrad) {
+            for (size_t i = 0; i < output->grad.values.size(); ++i) {
+                inputs[0]->grad.values[i] += inputs[0]->data.values[i] > 0 ? output->grad.values[i] : 0.0F;
+            }
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(Relu)
+}  // namespace auto_diff
+
+namespace {
+
+    auto RandomMatrix(size_t rows, size_t cols, std::mt19937& generator) -> Tensor {
+        std::normal_distribution<float> distribution;
+        Tensor m(rows, cols);
+        for (float& value : m.values) {
+            value = distribution(generator);
+        }
+        return m;
+    }
+
+    struct Network {
+        std::shared_ptr<auto_diff::IModule<Tensor>> hidden = std::make_shared<auto_diff::MatMul<Tensor, ReluBackend>>();
+        std::shared_ptr<auto_diff::IModule<Tensor>> relu = std::make_shared<auto_diff::Relu<Tensor, ReluBackend>>();
+        std::shared_ptr<auto_diff::IModule<Tensor>> output = std::make_shared<auto_diff::MatMul<Tensor, ReluBackend>>();
+
+        auto Forward(const NodePtr<Tensor>& x, const NodePtr<Tensor>& w1, const NodePtr<Tensor>& w2) {
+            auto h = hidden->Forward({x, w1})[0];
+            auto a = relu->Forward({h})[0];
+            return output->Forward({a, w2})[0];
+        }
+    };
+
+}  // namespace
+
+TEST(SavedDataTest, CompressedBackwardMatchesFullPrecision) {
+    std::mt19937 generator(1);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(16, 32, generator), false);
+    auto w1 = std::make_shared<Node<Tensor>>(RandomMatrix(32, 64, generator));
+    auto w2 = std::make_shared<Node<Tensor>>(RandomMatrix(64, 8, generator));
+
+    Network reference;
+    reference.Forward(x, w1, w2)->Backward();
+    const Tensor expectedW1 = w1->grad;
+    const Tensor expectedW2 = w2->grad;
+    w1->grad = 0;
+    w2->grad = 0;
+
+    Network compressed;
+    compressed.relu = std::make_shared<CompressSaved<Tensor>>(compressed.relu, std::make_shared<SignMaskCodec<float>>());
+    compressed.output = std::make_shared<CompressSaved<Tensor>>(compressed.output, std::make_shared<HalfPrecisionCodec<float>>());
+    compressed.hidden = std::make_shared<CompressSaved<Tensor>>(compressed.hidden, std::make_shared<Int8Codec<float>>());
+    auto y = compressed.Forward(x, w1, w2);
+    const Tensor expectedY = y->data;
+
+    // the hidden pre-activation is kept as a mask and the activation as fp16, the leaves x and w1 are not packed
+    EXPECT_EQ(PackSavedData<Tensor>({y}), 2);
+    EXPECT_EQ(x->data.values.size(), 16 * 32);
+    EXPECT_EQ(y->parents[0]->data.values.size(), 0);
+    EXPECT_EQ(y->parents[0]->parents[0]->data.values.size(), 0);
+    EXPECT_EQ(y->data.values, expectedY.values);
+
+    y->Backward();
+    // dL/dw1 depends on the hidden layer only through the mask
+    for (size_t i = 0; i < expectedW1.values.size(); ++i) {
+        EXPECT_FLOAT_EQ(w1->grad.values[i], expectedW1.values[i]);
+    }
+    for (size_t i = 0; i < expectedW2.values.size(); ++i) {
+        EXPECT_NEAR(w2->grad.values[i], expectedW2.values[i], 1e-3F * std::abs(expectedW2.values[i]) + 1e-3F);
+    }
+}
+
+TEST(SavedDataTest, Int8CodecRoundTrip) {
+    std::mt19937 generator(2);
+    Tensor data = RandomMatrix(7, 9, generator);
+    const Tensor original = data;
+    auto packed = Int8Codec<float>().Pack(data);
+    EXPECT_TRUE(data.values.empty());
+    packed.unpack(data);
+    ASSERT_EQ(data.rows, 7);
+    ASSERT_EQ(data.cols, 9);
+    const float maxAbs = std::abs(*std::ranges::max_element(original.values, {}, [](float v) { return std::abs(v); }));
+    for (size_t i = 0; i < data.values.size(); ++i) {
+        EXPECT_LE(std::abs(data.values[i] - original.values[i]), maxAbs / 254 * 1.0001F);
+    }
+}
+
+TEST(SavedDataTest, NodesWithFullPrecisionConsumersAreNotPacked) {
+    std::mt19937 generator(3);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(4, 4, generator));
+    auto fp16 = std::make_shared<HalfPrecisionCodec<float>>();
+    auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>> mult;
+    CompressSaved<Tensor> compressedMult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(), fp16);
+    CompressSaved<Tensor> int8Mult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(),
+                                   std::make_shared<Int8Codec<float>>());
+
+    auto a = mult.Forward({x, x})[0];
+    auto b = mult.Forward({x, x})[0];
+    // `a` is also read by a full precision consumer, `b` by consumers disagreeing on the codec
+    auto y1 = compressedMult.Forward({a, x})[0];
+    auto y2 = mult.Forward({a, x})[0];
+    auto y3 = compressedMult.Forward({b, x})[0];
+    auto y4 = int8Mult.Forward({b, x})[0];
+    EXPECT_EQ(PackSavedData<Tensor>({y1, y2, y3, y4}), 0);
+}
+
+TEST(SavedDataTest, NodesWithDeadCompressingConsumerAndPlainConsumerAreNotPacked) {
+    std::mt19937 generator(5);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(4, 4, generator));
+    auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>> mult;
+    CompressSaved<Tensor> compressedMult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(),
+                                         std::make_shared<HalfPrecisionCodec<float>>());
+
+    auto a = mult.Forward({x, x})[0];
+    // the output of the compressing consumer is discarded, the plain consumer must still read exact data
+    static_cast<void>(compressedMult.Forward({a, x}));
+    auto y = mult.Forward({a, x})[0];
+    EXPECT_EQ(PackSavedData<Tensor>({y}), 0);
+    EXPECT_FALSE(a->data.values.empty());
+}
+
+TEST(SavedDataTest, RecordedConsumersOutsideOfTheGraphAreRespected) {
+    auto_diff::ReplayRecordingScope recording;
+    std::mt19937 generator(6);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(4, 4, generator));
+    auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>> mult;
+    CompressSaved<Tensor> compressedMult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(),
+                                         std::make_shared<HalfPrecisionCodec<float>>());
+
+    auto a = mult.Forward({x, x})[0];
+    auto y1 = compressedMult.Forward({a, x})[0];
+    // not reachable from `y1`, known only from the recorded children of `a`
+    auto y2 = mult.Forward({a, x})[0];
+    EXPECT_EQ(PackSavedData<Tensor>({y1}), 0);
+}
+
+TEST(SavedDataTest, GraphReplayRestoresExactData) {
+    auto_diff::ReplayRecordingScope recording;
+    std::mt19937 generator(4);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(4, 4, generator));
+    auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>> mult;
+    CompressSaved<Tensor> compressedMult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(),
+                                         std::make_shared<Int8Codec<float>>());
+    auto a = compressedMult.Forward({x, x})[0];
+    auto y = compressedMult.Forward({a, a})[0];
+    const Tensor expected = a->data;
+
+    auto_diff::Graph<Tensor> graph({y});
+    ASSERT_EQ(PackSavedData<Tensor>({y}), 1);
+    EXPECT_TRUE(a->data.values.empty());
+    graph.Forward();
+    EXPECT_EQ(a->data.values, expected.values);
+}
+
+TEST(SavedDataTest, OutputsOfProducersReadingThemAreNotPacked) {
+    std::mt19937 generator(6);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(4, 4, generator));
+    auto d = std::make_shared<Node<Tensor>>(Tensor(4, 4, 2.5F));
+    auto_diff::ElemwiseDiv<Tensor, MatrixBackend<float>> div;
+    auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>> mult;
+    CompressSaved<Tensor> compressedMult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(),
+                                         std::make_shared<Int8Codec<float>>());
+
+    mult.Forward({div.Forward({x, d})[0], x})[0]->Backward();
+    const Tensor expectedX = x->grad;
+    const Tensor expectedD = d->grad;
+    x->grad = 0;
+    d->grad = 0;
+
+    // the backward of the division reads its output, so the exact quotient is kept
+    auto y = compressedMult.Forward({div.Forward({x, d})[0], x})[0];
+    EXPECT_EQ(PackSavedData<Tensor>({y}), 0);
+    y->Backward();
+    EXPECT_EQ(x->grad.values, expectedX.values);
+    EXPECT_EQ(d->grad.values, expectedD.values);
+}
+
+TEST(SavedDataTest, DeadConsumersAreForgotten) {
+    std::mt19937 generator(7);
+    auto x = std::make_shared<Node<Tensor>>(RandomMatrix(4, 4, generator));
+    auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>> mult;
+    auto fp16 = std::make_shared<HalfPrecisionCodec<float>>();
+    CompressSaved<Tensor> compressedMult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(), fp16);
+    CompressSaved<Tensor> int8Mult(std::make_shared<auto_diff::ElemwiseMult<Tensor, MatrixBackend<float>>>(),
+                                   std::make_shared<Int8Codec<float>>());
+    auto a = compressedMult.Forward({x, x})[0];
+    {
+        // consumers of one step disagree on the codec
+        auto y1 = compressedMult.Forward({a, x})[0];
+        auto y2 = int8Mult.Forward({a, x})[0];
+        EXPECT_EQ(a->savedDataCodec, nullptr);
+    }
+    for (size_t step = 0; step < 100; ++step) {
+        auto y = compressedMult.Forward({a, x})[0];
+        EXPECT_EQ(a->savedDataCodec, fp16);
+    }
+    // `x` is read twice by `a` and by the live `y`, dead consumers of the other steps are pruned
+    EXPECT_LE(x->compressingConsumers.size(), 8);
+    EXPECT_LE(a->compressingConsumers.size(), 2);
+}
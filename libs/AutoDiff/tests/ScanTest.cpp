@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "Graph.hpp"
+#include "IModule.hpp"
+#include "Scan.hpp"
+
+using auto_diff::Node;
+using auto_diff::NodePtr;
+using auto_diff::Scan;
+
+template <typename T>
+class StepBackend {
+ public:
+    static inline size_t forwardCalls = 0;
+
+    // x_{k+1} = w * sin(x_k) + x_k
+    static auto StepForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        ++forwardCalls;
+        const T& x = inputs[0]->data;
+        const T& w = inputs[1]->data;
+        outputs.push_back(std::make_shared<Node<T>>(w * std::sin(x) + x));
+    }
+    static auto StepBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        const T& x = inputs[0]->data;
+        const T& w = inputs[1]->data;
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * (w * std::cos(x) + 1);
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += output->grad * std::sin(x);
+        }
+    }
+
+    // (x, v)_{k+1} = (x_k + h * v_k, v_k - h * x_k)
+    static auto OscillatorForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        const T& x = inputs[0]->data;
+        const T& v = inputs[1]->data;
+        const T& h = inputs[2]->data;
+        outputs.push_back(std::make_shared<Node<T>>(x + h * v));
+        outputs.push_back(std::make_shared<Node<T>>(v - h * x));
+    }
+    static auto OscillatorBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, size_t outputIdx) -> void {
+        const T& x = inputs[0]->data;
+        const T& v = inputs[1]->data;
+        const T& h = inputs[2]->data;
+        const T sign = outputIdx == 0 ? 1 : -1;
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * (outputIdx == 0 ? 1 : -h);
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += output->grad * (outputIdx == 0 ? h : 1);
+        }
+        if (inputs[2]->requiresGrad) {
+            inputs[2]->grad += output->grad * sign * (outputIdx == 0 ? v : x);
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(Step)
+    DEFINE_MODULE(Oscillator)
+}  // namespace auto_diff
+
+using StepModule = auto_diff::Step<double, StepBackend<double>>;
+using OscillatorModule = auto_diff::Oscillator<double, StepBackend<double>>;
+
+struct Unrolled {
+    double value;
+    double xGrad;
+    double wGrad;
+};
+
+auto Unroll(double x0, double w0, size_t steps) -> Unrolled {
+    StepModule step;
+    auto x = std::make_shared<Node<double>>(x0);
+    auto w = std::make_shared<Node<double>>(w0);
+    NodePtr<double> state = x;
+    for (size_t i = 0; i < steps; ++i) {
+        state = step.Forward({state, w})[0];
+    }
+    state->Backward();
+    return {state->data, x->grad, w->grad};
+}
+
+TEST(ScanTest, ForwardRecordsOneNode) {
+    Scan<double> loop(std::make_shared<StepModule>(), 10);
+    auto x = std::make_shared<Node<double>>(0.5);
+    auto w = std::make_shared<Node<double>>(0.3);
+    auto outputs = loop.Forward({x, w});
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_EQ(outputs[0]->parents.size(), 1);
+    EXPECT_EQ(outputs[0]->parents[0]->parents.size(), 2);
+    EXPECT_NEAR(outputs[0]->data, Unroll(0.5, 0.3, 10).value, 1e-12);
+}
+
+TEST(ScanTest, StepsAreNotRecordedForReplay) {
+    auto_diff::ReplayRecordingScope recording;
+    Scan<double> loop(std::make_shared<StepModule>(), 10);
+    auto x = std::make_shared<Node<double>>(0.5);
+    auto w = std::make_shared<Node<double>>(0.3);
+    auto outputs = loop.Forward({x, w});
+    EXPECT_EQ(x->children.size(), 1);
+
+    StepModule step;
+    auto leaf = std::make_shared<Node<double>>(0.5, false);
+    static_cast<void>(auto_diff::Evaluate(step, {leaf, w}));
+    EXPECT_TRUE(leaf->children.empty());
+
+    auto_diff::Graph<double> graph({outputs[0]});
+    x->data = 0.7;
+    graph.Forward();
+    EXPECT_NEAR(outputs[0]->data, Unroll(0.7, 0.3, 10).value, 1e-12);
+}
+
+TEST(ScanTest, GradientsMatchUnrolledLoop) {
+    const size_t steps = 37;
+    const Unrolled expected = Unroll(0.5, 0.3, steps);
+    for (size_t checkpoints : {0, 1, 2, 3, 6, 100}) {
+        Scan<double> loop(std::make_shared<StepModule>(), steps, 1, checkpoints);
+        auto x = std::make_shared<Node<double>>(0.5);
+        auto w = std::make_shared<Node<double>>(0.3);
+        auto y = loop.Forward({x, w})[0];
+        y->Backward();
+        EXPECT_NEAR(x->grad, expected.xGrad, 1e-9) << checkpoints;
+        EXPECT_NEAR(w->grad, expected.wGrad, 1e-9) << checkpoints;
+    }
+}
+
+TEST(ScanTest, CheckpointingLimitsRecomputation) {
+    const size_t steps = 1000;
+    Scan<double> loop(std::make_shared<StepModule>(), steps);
+    auto x = std::make_shared<Node<double>>(0.5);
+    auto w = std::make_shared<Node<double>>(0.01);
+    auto y = loop.Forward({x, w})[0];
+    StepBackend<double>::forwardCalls = 0;
+    y->Backward();
+    // 10 checkpoints for 1000 steps need t = 4 repetitions: t * n - C(c + t, t - 1) advancing evaluations (Revolve bound),
+    // plus one evaluation per reversed step
+    EXPECT_EQ(StepBackend<double>::forwardCalls, 4 * steps - 364 + steps);
+    EXPECT_NEAR(x->grad, Unroll(0.5, 0.01, steps).xGrad, 1e-9);
+}
+
+TEST(ScanTest, SeveralStatesAreReversedTogether) {
+    const size_t steps = 20;
+    const double h = 0.1;
+    Scan<double> loop(std::make_shared<OscillatorModule>(), steps, 2);
+    auto x = std::make_shared<Node<double>>(1.0);
+    auto v = std::make_shared<Node<double>>(0.0);
+    auto step = std::make_shared<Node<double>>(h, false);
+    auto outputs = loop.Forward({x, v, step});
+    ASSERT_EQ(outputs.size(), 2);
+    outputs[0]->Backward();
+
+    OscillatorModule oscillator;
+    auto ux = std::make_shared<Node<double>>(1.0);
+    auto uv = std::make_shared<Node<double>>(0.0);
+    NodePtr<double> sx = ux;
+    NodePtr<double> sv = uv;
+    for (size_t i = 0; i < steps; ++i) {
+        auto next = oscillator.Forward({sx, sv, step});
+        sx = next[0];
+        sv = next[1];
+    }
+    sx->Backward();
+    EXPECT_NEAR(outputs[0]->data, sx->data, 1e-12);
+    EXPECT_NEAR(outputs[1]->data, sv->data, 1e-12);
+    EXPECT_NEAR(x->grad, ux->grad, 1e-12);
+    EXPECT_NEAR(v->grad, uv->grad, 1e-12);
+}
+
+TEST(ScanTest, TooFewInputsThrow) {
+    Scan<double> loop(std::make_shared<OscillatorModule>(), 3, 2);
+    auto x = std::make_shared<Node<double>>(1.0);
+    EXPECT_THROW(auto unused = loop.Forward({x}), std::invalid_argument);
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include "IModule.hpp"
+#include "SparseJacobian.hpp"
+
+using auto_diff::ColorRows;
+using auto_diff::Dual;
+using auto_diff::Node;
+using auto_diff::NodePtr;
+using auto_diff::NodePtrVector;
+using auto_diff::SparseHessian;
+using auto_diff::SparseJacobian;
+using auto_diff::SparsityPattern;
+
+template <typename T>
+class SparseBackend {
+ public:
+    static auto SparseMultForward(const std::vector<NodePtr<T>>& inputs, std::vector<NodePtr<T>>& outputs) -> void {
+        outputs.push_back(std::make_shared<Node<T>>(inputs[0]->data * inputs[1]->data));
+    }
+    static auto SparseMultBackward(const std::vector<NodePtr<T>>& inputs, Node<T>* output, [[maybe_unused]] size_t outputIdx) -> void {
+        if (inputs[0]->requiresGrad) {
+            inputs[0]->grad += output->grad * inputs[1]->data;
+        }
+        if (inputs[1]->requiresGrad) {
+            inputs[1]->grad += output->grad * inputs[0]->data;
+        }
+    }
+};
+
+namespace auto_diff {
+    DEFINE_MODULE(SparseMult)
+}  // namespace auto_diff
+
+using Mult = auto_diff::SparseMult<double, SparseBackend<double>>;
+using DualMult = auto_diff::SparseMult<Dual<double>, SparseBackend<Dual<double>>>;
+
+namespace {
+
+    /// Residuals `r_i = x_{i-1} * x_i * x_{i+1}` of a tridiagonal system.
+    auto Tridiagonal(Mult& mult, const NodePtrVector<double>& x) -> NodePtrVector<double> {
+        NodePtrVector<double> residuals;
+        for (size_t i = 0; i < x.size(); ++i) {
+            NodePtr<double> r = x[i];
+            if (i > 0) r = mult.Forward({x[i - 1], r})[0];
+            if (i + 1 < x.size()) r = mult.Forward({r, x[i + 1]})[0];
+            residuals.push_back(r);
+        }
+        return residuals;
+    }
+
+}  // namespace
+
+TEST(SparseJacobianTest, ColorRowsSharingNoColumn) {
+    // rows 0 and 2 are disjoint, row 1 overlaps both
+    SparsityPattern pattern{3, 4, {0, 2, 4, 5}, {0, 1, 1, 2, 3}};
+    auto colors = ColorRows(pattern);
+    EXPECT_EQ(colors, (std::vector<size_t>{0, 1, 0}));
+}
+
+TEST(SparseJacobianTest, TridiagonalNeedsThreeSweeps) {
+    Mult mult;
+    const size_t n = 50;
+    NodePtrVector<double> x;
+    for (size_t i = 0; i < n; ++i) {
+        x.push_back(std::make_shared<Node<double>>(1.0 + 0.1 * static_cast<double>(i)));
+    }
+    auto residuals = Tridiagonal(mult, x);
+
+    SparseJacobian<double> jacobian(residuals, x);
+    EXPECT_EQ(jacobian.Pattern().NonZeros(), 3 * n - 2);
+    EXPECT_EQ(jacobian.NumColors(), 3);
+
+    auto j = jacobian.Evaluate();
+    auto value = [&x, n](size_t k) { return k < n ? x[k]->data : 1.0; };
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < n; ++k) {
+            // r_i is the product of its neighbourhood, so dr_i/dx_k is the product of the other factors
+            double expected = 0;
+            if (k + 1 >= i && k <= i + 1) {
+                expected = value(i - 1) * value(i) * value(i + 1) / x[k]->data;
+            }
+            EXPECT_DOUBLE_EQ(j.At(i, k), expected) << i << ", " << k;
+        }
+    }
+}
+
+TEST(SparseJacobianTest, ConstantsDoNotAddNonZeros) {
+    Mult mult;
+    auto a = std::make_shared<Node<double>>(2.0);
+    auto b = std::make_shared<Node<double>>(3.0);
+    auto c = std::make_shared<Node<double>>(5.0, false);
+    auto r0 = mult.Forward({a, c})[0];
+    auto r1 = mult.Forward({b, b})[0];
+
+    SparseJacobian<double> jacobian({r0, r1}, {a, b});
+    EXPECT_EQ(jacobian.NumColors(), 1);
+    auto j = jacobian.Evaluate();
+    EXPECT_EQ(j.pattern.columns, (std::vector<size_t>{0, 1}));
+    EXPECT_DOUBLE_EQ(j.At(0, 0), 5.0);
+    EXPECT_DOUBLE_EQ(j.At(0, 1), 0.0);
+    EXPECT_DOUBLE_EQ(j.At(1, 1), 6.0);
+}
+
+TEST(SparseJacobianTest, InputsMustRequireGrad) {
+    auto a = std::make_shared<Node<double>>(2.0, false);
+    EXPECT_THROW(SparseJacobian<double>({a}, {a}), std::invalid_argument);
+}
+
+TEST(SparseHessianTest, NeighbourhoodProductsNeedFiveSweeps) {
+    auto_diff::ReplayRecordingScope recording;
+    DualMult mult;
+    const size_t n = 30;
+    NodePtrVector<Dual<double>> x;
+    for (size_t i = 0; i < n; ++i) {
+        x.push_back(std::make_shared<Node<Dual<double>>>(Dual<double>(1.0 + 0.1 * static_cast<double>(i))));
+    }
+    // e_i = x_{i-1} * x_i * x_{i+1}, so the Hessian of their sum is pentadiagonal with a zero diagonal
+    NodePtrVector<Dual<double>> elements;
+    for (size_t i = 0; i < n; ++i) {
+        NodePtr<Dual<double>> e = x[i];
+        if (i > 0) e = mult.Forward({x[i - 1], e})[0];
+        if (i + 1 < n) e = mult.Forward({e, x[i + 1]})[0];
+        elements.push_back(e);
+    }
+
+    SparseHessian<double> hessian(elements, x);
+    EXPECT_EQ(hessian.Pattern().NonZeros(), 5 * n - 6);
+    EXPECT_EQ(hessian.NumColors(), 5);
+
+    std::vector<std::vector<double>> expected(n, std::vector<double>(n));
+    for (size_t i = 0; i < n; ++i) {
+        std::vector<size_t> factors;
+        for (size_t k = i > 0 ? i - 1 : 0; k <= std::min(i + 1, n - 1); ++k) {
+            factors.push_back(k);
+        }
+        for (size_t a : factors) {
+            for (size_t b : factors) {
+                if (a == b) continue;
+                double product = 1;
+                for (size_t c : factors) {
+                    if (c != a && c != b) product *= x[c]->data.value;
+                }
+                expected[a][b] += product;
+            }
+        }
+    }
+
+    auto h = hessian.Evaluate();
+    for (size_t a = 0; a < n; ++a) {
+        for (size_t b = 0; b < n; ++b) {
+            EXPECT_DOUBLE_EQ(h.At(a, b), expected[a][b]) << a << ", " << b;
+        }
+        EXPECT_EQ(x[a]->data.tangent, 0.0);
+    }
+
+    // a second evaluation replays the graph at the new point
+    x[0]->data.value = 3.0;
+    EXPECT_DOUBLE_EQ(hessian.Evaluate().At(1, 2), 3.0 + x[3]->data.value);
+}
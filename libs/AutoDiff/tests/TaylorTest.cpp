@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "ElemwiseBackend.hpp"
+#include "Modules.hpp"
+#include "Taylor.hpp"
+
+using auto_diff::DirectionalDerivatives;
+using auto_diff::ElemwiseBackend;
+using auto_diff::Node;
+using auto_diff::Taylor;
+
+using T5 = Taylor<double, 5>;
+
+TEST(TaylorTest, ElementaryFunctions) {
+    const double x = 0.7;
+    const T5 t = T5::Variable(x, 1.0);
+
+    const T5 e = exp(t);
+    const T5 s = sin(t);
+    const T5 c = cos(t);
+    const T5 l = log(t);
+    const T5 r = sqrt(t);
+    const T5 p = pow(t, 2.5);
+    double factorial = 1;
+    for (size_t k = 0; k <= 5; ++k) {
+        if (k > 0) factorial *= static_cast<double>(k);
+        EXPECT_NEAR(e.Derivative(k), std::exp(x), 1e-12);
+        EXPECT_NEAR(s.Derivative(k), std::sin(x + static_cast<double>(k) * M_PI / 2), 1e-12);
+        EXPECT_NEAR(c.Derivative(k), std::cos(x + static_cast<double>(k) * M_PI / 2), 1e-12);
+
+        // d^k x^a = a (a - 1) ... (a - k + 1) x^(a - k)
+        auto power = [x, k](double a) {
+            double coefficient = 1;
+            for (size_t i = 0; i < k; ++i) coefficient *= a - static_cast<double>(i);
+            return coefficient * std::pow(x, a - static_cast<double>(k));
+        };
+        EXPECT_NEAR(r.Derivative(k), power(0.5), 1e-9);
+        EXPECT_NEAR(p.Derivative(k), power(2.5), 1e-9);
+        if (k > 0) {
+            // d^k log x = (-1)^(k-1) (k-1)! / x^k
+            EXPECT_NEAR(l.Derivative(k), (k % 2 ? 1 : -1) * factorial / static_cast<double>(k) / std::pow(x, k), 1e-9);
+        }
+    }
+
+    // tanh' = 1 - tanh^2, tanh'' = -2 tanh (1 - tanh^2)
+    const T5 th = tanh(t);
+    const double y = std::tanh(x);
+    EXPECT_NEAR(th.Derivative(1), 1 - y * y, 1e-12);
+    EXPECT_NEAR(th.Derivative(2), -2 * y * (1 - y * y), 1e-12);
+    EXPECT_NEAR(th.Derivative(3), (1 - y * y) * (6 * y * y - 2), 1e-12);
+}
+
+TEST(TaylorTest, DirectionalDerivativesThroughModules) {
+    auto_diff::ReplayRecordingScope recording;
+    auto_diff::ElemwiseMult<T5, ElemwiseBackend<T5>> mult;
+    auto_diff::ElemwiseDiv<T5, ElemwiseBackend<T5>> div;
+    auto_diff::ElemwiseAdd<T5, ElemwiseBackend<T5>> add;
+
+    // f(x, y) = x * x / (1 + y)
+    auto x = std::make_shared<Node<T5>>(T5(3.0));
+    auto y = std::make_shared<Node<T5>>(T5(1.0));
+    auto one = std::make_shared<Node<T5>>(T5(1.0), false);
+    auto f = div.Forward({mult.Forward({x, x})[0], add.Forward({one, y})[0]})[0];
+    DirectionalDerivatives<double, 5> derivatives(f, {x, y});
+
+    // along y: 9 / (2 + t), k-th derivative 9 (-1)^k k! / 2^(k+1)
+    auto alongY = derivatives.Apply({0.0, 1.0});
+    double factorial = 1;
+    for (size_t k = 0; k <= 5; ++k) {
+        if (k > 0) factorial *= static_cast<double>(k);
+        EXPECT_NEAR(alongY[k], 9.0 * (k % 2 ? -1 : 1) * factorial / std::pow(2.0, k + 1), 1e-12);
+    }
+
+    // along x: (3 + t)^2 / 2
+    auto alongX = derivatives.Apply({1.0, 0.0});
+    EXPECT_DOUBLE_EQ(alongX[0], 4.5);
+    EXPECT_DOUBLE_EQ(alongX[1], 3.0);
+    EXPECT_DOUBLE_EQ(alongX[2], 1.0);
+    EXPECT_DOUBLE_EQ(alongX[3], 0.0);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+
+namespace auto_diff::tests {
+
+    /// Path in the temporary directory removed at the end of the test.
+    class TemporaryPath {
+     public:
+        explicit TemporaryPath(const std::string& name)
+            : m_path(std::filesystem::temp_directory_path() / (name + "_" + std::to_string(::getpid()))) {}
+        ~TemporaryPath() { std::filesystem::remove(m_path); }
+        [[nodiscard]] auto Get() const -> const std::filesystem::path& { return m_path; }
+
+     private:
+        std::filesystem::path m_path;
+    };
+
+}  // namespace auto_diff::tests
@@ -0,0 +1,214 @@
+#include "BinaryLog.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace ai::detail {
+
+    namespace {
+
+        /// Decoded argument of a binary record. Integers are widened, they format the same way.
+        using Argument = std::variant<bool, char, int64_t, uint64_t, float, double, long double, std::string_view>;
+
+        auto RoundUpToPowerOfTwo(size_t capacity) -> size_t {
+            if (capacity == 0) {
+                throw std::invalid_argument("StagingBuffer: capacity must be positive");
+            }
+            return std::bit_ceil(capacity);
+        }
+
+        class RecordReader {
+         public:
+            RecordReader(const std::byte* data, size_t size) : m_data(data), m_size(size) {}
+
+            template <typename T>
+            auto Get() -> T {
+                T value;
+                std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+                return value;
+            }
+
+            auto GetString() -> std::string_view {
+                const auto length = Get<uint32_t>();
+                return {reinterpret_cast<const char*>(Take(length)), length};
+            }
+
+         private:
+            const std::byte* m_data;
+            size_t m_size;
+            size_t m_position{0};
+
+            auto Take(size_t bytes) -> const std::byte* {
+                if (m_size - m_position < bytes) {
+                    throw std::runtime_error("binary log record is truncated");
+                }
+                m_position += bytes;
+                return m_data + m_position - bytes;
+            }
+        };
+
+        auto DecodeArguments(std::string_view types, const std::byte* data, size_t size) -> std::vector<Argument> {
+            RecordReader reader(data, size);
+            std::vector<Argument> arguments;
+            arguments.reserve(types.size());
+            for (const char type : types) {
+                switch (type) {
+                    case 'b':
+                        arguments.emplace_back(reader.Get<bool>());
+                        break;
+                    case 'c':
+                        arguments.emplace_back(reader.Get<char>());
+                        break;
+                    case 'a':
+                        arguments.emplace_back(int64_t{reader.Get<int8_t>()});
+                        break;
+                    case 's':
+                        arguments.emplace_back(int64_t{reader.Get<int16_t>()});
+                        break;
+                    case 'i':
+                        arguments.emplace_back(int64_t{reader.Get<int32_t>()});
+                        break;
+                    case 'l':
+                        arguments.emplace_back(reader.Get<int64_t>());
+                        break;
+                    case 'A':
+                        arguments.emplace_back(uint64_t{reader.Get<uint8_t>()});
+                        break;
+                    case 'S':
+                        arguments.emplace_back(uint64_t{reader.Get<uint16_t>()});
+                        break;
+                    case 'I':
+                        arguments.emplace_back(uint64_t{reader.Get<uint32_t>()});
+                        break;
+                    case 'L':
+                        arguments.emplace_back(reader.Get<uint64_t>());
+                        break;
+                    case 'f':
+                        arguments.emplace_back(reader.Get<float>());
+                        break;
+                    case 'd':
+                        arguments.emplace_back(reader.Get<double>());
+                        break;
+                    case 'e':
+                        arguments.emplace_back(reader.Get<long double>());
+                        break;
+                    case 't':
+                        arguments.emplace_back(reader.GetString());
+                        break;
+                    default:
+                        throw std::runtime_error(std::string("unknown binary log argument type ") + type);
+                }
+            }
+            return arguments;
+        }
+
+        /// Resolves an argument id of a replacement field, automatic if `id` is empty.
+        auto ArgumentAt(const std::vector<Argument>& arguments, std::string_view id, size_t& nextArgument) -> const Argument& {
+            size_t index = nextArgument++;
+            if (!id.empty()) {
+                index = 0;
+                for (const char digit : id) {
+                    if (digit < '0' || digit > '9') {
+                        throw std::format_error("invalid argument id in format string");
+                    }
+                    index = index * 10 + static_cast<size_t>(digit - '0');
+                }
+            }
+            if (index >= arguments.size()) {
+                throw std::format_error("argument index out of range");
+            }
+            return arguments[index];
+        }
+
+        /// Replaces nested replacement fields of a format spec, e.g. the width in `{:{}}`, by the values of their arguments.
+        auto ResolveSpec(std::string_view spec, const std::vector<Argument>& arguments, size_t& nextArgument) -> std::string {
+            std::string resolved;
+            for (size_t i = 0; i < spec.size(); ++i) {
+                if (spec[i] != '{') {
+                    resolved += spec[i];
+                    continue;
+                }
+                const size_t close = spec.find('}', i);
+                if (close == std::string_view::npos) {
+                    throw std::format_error("unmatched '{' in format spec");
+                }
+                const Argument& argument = ArgumentAt(arguments, spec.substr(i + 1, close - i - 1), nextArgument);
+                if (const auto* value = std::get_if<int64_t>(&argument)) {
+                    resolved += std::to_string(*value);
+                } else if (const auto* unsignedValue = std::get_if<uint64_t>(&argument)) {
+                    resolved += std::to_string(*unsignedValue);
+                } else {
+                    throw std::format_error("width or precision argument is not an integer");
+                }
+                i = close;
+            }
+            return resolved;
+        }
+
+    }  // namespace
+
+    StagingBuffer::StagingBuffer(size_t capacity)
+        : m_mask(RoundUpToPowerOfTwo(capacity) - 1), m_data(std::make_unique<std::byte[]>(m_mask + 1)) {}
+
+    auto StagingBuffer::CopyIn(size_t position, const void* data, size_t bytes) noexcept -> void {
+        const size_t offset = position & m_mask;
+        const size_t first = std::min(bytes, Capacity() - offset);
+        std::memcpy(m_data.get() + offset, data, first);
+        std::memcpy(m_data.get(), static_cast<const std::byte*>(data) + first, bytes - first);
+    }
+
+    auto StagingBuffer::Read(size_t position, void* data, size_t bytes) const noexcept -> void {
+        const size_t offset = position & m_mask;
+        const size_t first = std::min(bytes, Capacity() - offset);
+        std::memcpy(data, m_data.get() + offset, first);
+        std::memcpy(static_cast<std::byte*>(data) + first, m_data.get(), bytes - first);
+    }
+
+    auto FormatBinaryArguments(std::string_view format, std::string_view types, const std::byte* data, size_t size) -> std::string {
+        const std::vector<Argument> arguments = DecodeArguments(types, data, size);
+        std::string result;
+        size_t nextArgument = 0;
+        for (size_t i = 0; i < format.size(); ++i) {
+            const char c = format[i];
+            if ((c == '{' || c == '}') && i + 1 < format.size() && format[i + 1] == c) {
+                result += c;
+                ++i;
+                continue;
+            }
+            if (c == '}') {
+                throw std::format_error("unmatched '}' in format string");
+            }
+            if (c != '{') {
+                result += c;
+                continue;
+            }
+            // the field ends at the first '}' that doesn't close a nested field of its spec
+            size_t close = i + 1;
+            for (int depth = 0; close < format.size() && (format[close] != '}' || depth > 0); ++close) {
+                depth += format[close] == '{' ? 1 : format[close] == '}' ? -1 : 0;
+            }
+            if (close == format.size()) {
+                throw std::format_error("unmatched '{' in format string");
+            }
+            const std::string_view field = format.substr(i + 1, close - i - 1);
+            const size_t colon = field.find(':');
+            const Argument& argument = ArgumentAt(arguments, field.substr(0, colon), nextArgument);
+            std::string spec = "{";
+            if (colon != std::string_view::npos) {
+                spec += ':';
+                spec += ResolveSpec(field.substr(colon + 1), arguments, nextArgument);
+            }
+            spec += '}';
+            std::visit([&](const auto& value) { result += std::vformat(spec, std::make_format_args(value)); }, argument);
+            i = close;
+        }
+        return result;
+    }
+
+}  // namespace ai::detail
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace ai::detail {
+
+    /**
+    @brief Per-thread single-producer single-consumer byte ring holding binary log records.
+
+    The owning thread writes a record with several Write calls and publishes it with Commit. The writer thread reads the
+    committed bytes and frees them with Release. Positions grow monotonically and are wrapped on access.
+    */
+    class StagingBuffer {
+     public:
+        /// @param capacity Size in bytes, rounded up to a power of two.
+        explicit StagingBuffer(size_t capacity);
+
+        StagingBuffer(const StagingBuffer&) = delete;
+        StagingBuffer& operator=(const StagingBuffer&) = delete;
+
+        [[nodiscard]] auto Capacity() const noexcept -> size_t { return m_mask + 1; }
+
+        /// Whether `bytes` more bytes fit. Producer only.
+        [[nodiscard]] auto HasRoom(size_t bytes) noexcept -> bool {
+            if (m_writePosition + bytes - m_cachedConsumed <= Capacity()) {
+                return true;
+            }
+            m_cachedConsumed = m_consumed.load(std::memory_order_acquire);
+            return m_writePosition + bytes - m_cachedConsumed <= Capacity();
+        }
+
+        /// Appends bytes to the record being written. Producer only, after HasRoom.
+        auto Write(const void* data, size_t bytes) noexcept -> void {
+            CopyIn(m_writePosition, data, bytes);
+            m_writePosition += bytes;
+        }
+
+        /// Publishes the bytes written so far. Producer only.
+        auto Commit() noexcept -> void { m_committed.store(m_writePosition, std::memory_order_release); }
+
+        /// End of the published bytes. Consumer only.
+        [[nodiscard]] auto Committed() const noexcept -> size_t { return m_committed.load(std::memory_order_acquire); }
+
+        /// Start of the bytes not yet released. Consumer only.
+        [[nodiscard]] auto Consumed() const noexcept -> size_t { return m_consumed.load(std::memory_order_relaxed); }
+
+        /// Copies published bytes starting at `position`. Consumer only.
+        auto Read(size_t position, void* data, size_t bytes) const noexcept -> void;
+
+        /// Frees the bytes before `position`. Consumer only.
+        auto Release(size_t position) noexcept -> void { m_consumed.store(position, std::memory_order_release); }
+
+        /// Set when the owning thread exits, the buffer is dropped once it is drained.
+        std::atomic<bool> retired{false};
+
+     private:
+        static constexpr size_t CACHE_LINE_SIZE = 64;
+
+        const size_t m_mask;
+        std::unique_ptr<std::byte[]> m_data;
+        alignas(CACHE_LINE_SIZE) size_t m_writePosition{0};
+        size_t m_cachedConsumed{0};
+        std::atomic<size_t> m_committed{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_consumed{0};
+
+        auto CopyIn(size_t position, const void* data, size_t bytes) noexcept -> void;
+    };
+
+    /// Fixed header of a binary record, followed by the encoded arguments.
+    struct RecordHeader {
+        /// Size of the whole record in bytes.
+        uint32_t size;
+        uint32_t callSite;
+        /// Nanoseconds since the epoch of std::chrono::system_clock.
+        int64_t time;
+    };
+
+    /**
+    @brief Encoding of one argument type of a binary log record.
+
+    Every encodable type has a one character tag which is stored with the call site, so records can be decoded without
+    the types, e.g. by another process. The primary template marks the type as not encodable, such arguments are
+    formatted on the logging thread.
+    */
+    template <typename T>
+    struct ArgumentCodec {};
+
+    template <typename T>
+    concept Encodable = requires { ArgumentCodec<T>::TAG; };
+
+    /// Type tags: b bool, c char, a/s/i/l signed and A/S/I/L unsigned integers of 1/2/4/8 bytes, f/d/e floating point, t text.
+    template <typename T>
+    consteval auto ArithmeticTag() -> char {
+        if constexpr (std::is_same_v<T, bool>) {
+            return 'b';
+        } else if constexpr (std::is_same_v<T, char>) {
+            return 'c';
+        } else if constexpr (std::is_same_v<T, float>) {
+            return 'f';
+        } else if constexpr (std::is_same_v<T, double>) {
+            return 'd';
+        } else if constexpr (std::is_same_v<T, long double>) {
+            return 'e';
+        } else {
+            constexpr std::string_view SIGNED_TAGS = "asil";
+            constexpr std::string_view UNSIGNED_TAGS = "ASIL";
+            constexpr size_t INDEX = std::countr_zero(sizeof(T));
+            return std::is_signed_v<T> ? SIGNED_TAGS[INDEX] : UNSIGNED_TAGS[INDEX];
+        }
+    }
+
+    /// Character types other than char, std::format can't write them to a char string.
+    template <typename T>
+    concept WideCharacter = std::same_as<T, wchar_t> || std::same_as<T, char8_t> || std::same_as<T, char16_t> || std::same_as<T, char32_t>;
+
+    template <typename T>
+        requires std::is_arithmetic_v<T> && (!WideCharacter<T>)
+    struct ArgumentCodec<T> {
+        static constexpr char TAG = ArithmeticTag<T>();
+        static auto Size(T /*value*/) noexcept -> size_t { return sizeof(T); }
+        static auto Encode(StagingBuffer& buffer, T value) noexcept -> void { buffer.Write(&value, sizeof(T)); }
+    };
+
+    /// Strings are stored as a 32-bit length followed by the characters.
+    struct StringCodec {
+        static constexpr char TAG = 't';
+        static auto Size(std::string_view value) noexcept -> size_t { return sizeof(uint32_t) + value.size(); }
+        static auto Encode(StagingBuffer& buffer, std::string_view value) noexcept -> void {
+            const auto length = static_cast<uint32_t>(value.size());
+            buffer.Write(&length, sizeof(length));
+            buffer.Write(value.data(), length);
+        }
+    };
+
+    template <>
+    struct ArgumentCodec<std::string> : StringCodec {};
+    template <>
+    struct ArgumentCodec<std::string_view> : StringCodec {};
+    template <>
+    struct ArgumentCodec<const char*> : StringCodec {};
+    template <>
+    struct ArgumentCodec<char*> : StringCodec {};
+    template <size_t N>
+    struct ArgumentCodec<char[N]> : StringCodec {};
+
+    template <typename... Args>
+    [[nodiscard]] auto TypeTags() -> std::string {
+        return std::string{ArgumentCodec<std::remove_cvref_t<Args>>::TAG...};
+    }
+
+    /**
+    @brief Formats the arguments of a binary record encoded with the types `types`.
+
+    Replacement fields are formatted one by one with the standard formatters, including nested width and precision
+    arguments. Throws std::format_error if the format doesn't match the arguments, std::runtime_error if the record is
+    truncated.
+    */
+    [[nodiscard]] auto FormatBinaryArguments(std::string_view format, std::string_view types, const std::byte* data, size_t size)
+        -> std::string;
+
+}  // namespace ai::detail
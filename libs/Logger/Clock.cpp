@@ -0,0 +1,90 @@
+#include "Clock.hpp"
+
+#include <ctime>
+#include <thread>
+
+#if defined(__x86_64__) && !defined(_M_X64)
+#include <cpuid.h>
+#endif
+
+namespace ai::detail {
+
+    namespace {
+
+        constexpr uint32_t INVARIANT_TSC_LEAF = 0x80000007;
+        constexpr uint32_t INVARIANT_TSC_BIT = 1U << 8;
+
+        auto WriteTwoDigits(char* output, int value) noexcept -> void {
+            output[0] = static_cast<char>('0' + value / 10);
+            output[1] = static_cast<char>('0' + value % 10);
+        }
+
+    }  // namespace
+
+    auto TimestampCache::RenderSecond(int64_t second) -> void {
+        const auto time = static_cast<std::time_t>(second);
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &time);
+#else
+        localtime_r(&time, &tm);
+#endif
+        WriteTwoDigits(&m_text[0], tm.tm_hour);
+        m_text[2] = ':';
+        WriteTwoDigits(&m_text[3], tm.tm_min);
+        m_text[5] = ':';
+        // a leap second is reported as 60
+        WriteTwoDigits(&m_text[6], tm.tm_sec);
+        m_text[8] = '.';
+        m_second = second;
+    }
+
+    TscClock::TscClock(std::chrono::milliseconds calibration) : m_usesTsc(HasInvariantTsc()) {
+        if (!m_usesTsc) {
+            return;
+        }
+        const auto start = std::chrono::system_clock::now();
+        m_startTicks = ReadTicks();
+        std::this_thread::sleep_for(calibration);
+        const uint64_t endTicks = ReadTicks();
+        const auto end = std::chrono::system_clock::now();
+        if (endTicks > m_startTicks) {
+            const auto nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+            m_nanosecondsPerTick = nanoseconds / static_cast<double>(endTicks - m_startTicks);
+        }
+        m_startNanoseconds.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count(),
+                                 std::memory_order_relaxed);
+    }
+
+    auto TscClock::Resync() noexcept -> void {
+        if (!m_usesTsc) {
+            return;
+        }
+        const auto now = std::chrono::system_clock::now();
+        const uint64_t ticks = ReadTicks();
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+        m_startNanoseconds.store(nanoseconds - ElapsedNanoseconds(ticks), std::memory_order_relaxed);
+    }
+
+    auto TscClock::HasInvariantTsc() noexcept -> bool {
+#if defined(_M_X64)
+        std::array<int, 4> registers{};
+        __cpuid(registers.data(), static_cast<int>(INVARIANT_TSC_LEAF & 0x80000000U));
+        if (static_cast<uint32_t>(registers[0]) < INVARIANT_TSC_LEAF) {
+            return false;
+        }
+        __cpuid(registers.data(), static_cast<int>(INVARIANT_TSC_LEAF));
+        return (static_cast<uint32_t>(registers[3]) & INVARIANT_TSC_BIT) != 0;
+#elif defined(__x86_64__)
+        // __get_cpuid fails if the leaf is above the highest supported one
+        unsigned int eax = 0;
+        unsigned int ebx = 0;
+        unsigned int ecx = 0;
+        unsigned int edx = 0;
+        return __get_cpuid(INVARIANT_TSC_LEAF, &eax, &ebx, &ecx, &edx) != 0 && (edx & INVARIANT_TSC_BIT) != 0;
+#else
+        return false;
+#endif
+    }
+
+}  // namespace ai::detail
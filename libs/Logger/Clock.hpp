@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(_M_X64)
+#include <intrin.h>
+#define AI_LOGGER_HAS_TSC 1
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#define AI_LOGGER_HAS_TSC 1
+#else
+#define AI_LOGGER_HAS_TSC 0
+#endif
+
+namespace ai::detail {
+
+    /**
+    @brief Renders local times as HH:MM:SS.mmm, converting to local time only when the second changes.
+
+    The text of the current second is kept and only the milliseconds are patched in, so most calls are a division and
+    three character stores. Not thread-safe, every thread keeps a cache of its own.
+    */
+    class TimestampCache {
+     public:
+        /// Text of `time`, valid until the next call.
+        [[nodiscard]] auto Format(std::chrono::system_clock::time_point time) -> std::string_view {
+            const auto milliseconds = std::chrono::floor<std::chrono::milliseconds>(time).time_since_epoch().count();
+            const int64_t second = FloorDivide(milliseconds, MILLISECONDS_PER_SECOND);
+            if (second != m_second) {
+                RenderSecond(second);
+            }
+            const auto millisecond = static_cast<int>(milliseconds - second * MILLISECONDS_PER_SECOND);
+            m_text[MILLISECONDS_OFFSET] = static_cast<char>('0' + millisecond / 100);
+            m_text[MILLISECONDS_OFFSET + 1] = static_cast<char>('0' + millisecond / 10 % 10);
+            m_text[MILLISECONDS_OFFSET + 2] = static_cast<char>('0' + millisecond % 10);
+            return {m_text.data(), m_text.size()};
+        }
+
+     private:
+        static constexpr int64_t MILLISECONDS_PER_SECOND = 1000;
+        static constexpr size_t MILLISECONDS_OFFSET = 9;
+
+        /// "HH:MM:SS." followed by the milliseconds.
+        std::array<char, 12> m_text{};
+        /// Seconds since the epoch rendered in m_text.
+        int64_t m_second{INT64_MIN};
+
+        static constexpr auto FloorDivide(int64_t value, int64_t divisor) noexcept -> int64_t {
+            return value / divisor - (value % divisor < 0 ? 1 : 0);
+        }
+
+        auto RenderSecond(int64_t second) -> void;
+    };
+
+    /**
+    @brief Clock reading the time stamp counter, mapped to std::chrono::system_clock.
+
+    The counter rate is calibrated against system_clock on construction, which takes about `calibration`. Reading it is
+    a single instruction instead of a clock_gettime call. The counter is used only if it is invariant, otherwise its rate
+    may change with the CPU frequency or it may stop in sleep states. Without an invariant counter, and on CPUs other
+    than x86-64, Now falls back to system_clock.
+
+    An error of the calibration is a rate error, e.g. 100 ns over 10 ms is 10 ppm, so the clock drifts away from
+    system_clock over time. Resync re-anchors it to system_clock, which bounds the drift to the rate error times the
+    time since the last Resync and picks up adjustments of the system clock. A Resync may step the clock back by the
+    accumulated drift. The asynchronous Logger calls it from the writer thread every RESYNC_INTERVAL.
+    */
+    class TscClock {
+     public:
+        /// How often the asynchronous Logger calls Resync, 10 us of drift at a rate error of 10 ppm.
+        static constexpr std::chrono::seconds RESYNC_INTERVAL{1};
+
+        explicit TscClock(std::chrono::milliseconds calibration = std::chrono::milliseconds(10));
+
+        [[nodiscard]] auto Now() const noexcept -> std::chrono::system_clock::time_point {
+            if (!m_usesTsc) {
+                return std::chrono::system_clock::now();
+            }
+            return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::nanoseconds(m_startNanoseconds.load(std::memory_order_relaxed) + ElapsedNanoseconds(ReadTicks()))));
+        }
+
+        /// Re-anchors the clock to the current system_clock time. Safe to call while other threads call Now.
+        auto Resync() noexcept -> void;
+
+        /// Whether the time stamp counter is used rather than system_clock.
+        [[nodiscard]] auto UsesTsc() const noexcept -> bool { return m_usesTsc; }
+
+        /// Whether CPUID reports an invariant time stamp counter, leaf 80000007H, EDX bit 8.
+        [[nodiscard]] static auto HasInvariantTsc() noexcept -> bool;
+
+     private:
+        bool m_usesTsc{false};
+        uint64_t m_startTicks{0};
+        double m_nanosecondsPerTick{1.0};
+        /// system_clock time at m_startTicks in nanoseconds since the epoch, moved by Resync.
+        std::atomic<int64_t> m_startNanoseconds{0};
+
+        [[nodiscard]] auto ElapsedNanoseconds(uint64_t ticks) const noexcept -> int64_t {
+            return static_cast<int64_t>(static_cast<double>(ticks - m_startTicks) * m_nanosecondsPerTick);
+        }
+
+        static auto ReadTicks() noexcept -> uint64_t {
+#if AI_LOGGER_HAS_TSC
+            return __rdtsc();
+#else
+            return 0;
+#endif
+        }
+    };
+
+}  // namespace ai::detail
@@ -1,25 +1,76 @@
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "Logger.hpp"
 
 namespace ai {
 
-    constexpr int MILLISECONDS_PER_SECOND = 1000;
+    /// Maximum number of messages written to the stream at once by the writer thread.
+    constexpr size_t MAX_BATCH_SIZE = 256;
 
-    auto Logger::GetCurrentTime() -> std::string {
-        auto now = std::chrono::system_clock::now();
-        auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % MILLISECONDS_PER_SECOND;
-        const std::time_t time = std::chrono::system_clock::to_time_t(now);
+    // Binary log stream: the file header, then call sites and records, each starting with its tag:
+    // call site: id (u32), level (u8), line (u32), then file, function, format and types as u32 length + characters;
+    // record: detail::RecordHeader followed by the encoded arguments.
+    constexpr std::string_view FILE_MAGIC = "AILOGBIN";
+    constexpr uint32_t FILE_VERSION = 2;
+    constexpr char CALL_SITE_TAG = 'S';
+    constexpr char RECORD_TAG = 'R';
 
-        // The GetCurrentTime method is called only inside the Log method, which has mutex lock, therefore it is thread-safe
-        // NOLINTNEXTLINE(concurrency-mt-unsafe)
-        const std::tm tm = *std::localtime(&time);
+    namespace {
 
-        std::ostringstream oss;
-        oss << std::put_time(&tm, "%H:%M:%S") << '.' << std::setfill('0') << std::setw(3) << milliseconds.count();
-        return oss.str();
+        /// Staging buffer of a thread, marked as retired when the thread exits.
+        struct StagingBufferSlot {
+            std::shared_ptr<detail::StagingBuffer> buffer;
+            uint64_t epoch{0};
+
+            StagingBufferSlot() = default;
+            StagingBufferSlot(const StagingBufferSlot&) = delete;
+            StagingBufferSlot& operator=(const StagingBufferSlot&) = delete;
+
+            ~StagingBufferSlot() {
+                if (buffer) {
+                    buffer->retired.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local StagingBufferSlot stagingBufferSlot;
+
+        auto AppendBytes(std::string& output, const void* data, size_t bytes) -> void {
+            output.append(static_cast<const char*>(data), bytes);
+        }
+
+        auto AppendString(std::string& output, std::string_view value) -> void {
+            const auto length = static_cast<uint32_t>(value.size());
+            AppendBytes(output, &length, sizeof(length));
+            output += value;
+        }
+
+        auto AppendFileHeader(std::string& output) -> void {
+            output += FILE_MAGIC;
+            AppendBytes(output, &FILE_VERSION, sizeof(FILE_VERSION));
+        }
+
+        auto ToTimePoint(int64_t nanoseconds) -> std::chrono::system_clock::time_point {
+            return std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+        }
+
+    }  // namespace
+
+    auto Logger::FormatTime(std::chrono::system_clock::time_point now) -> std::string_view {
+        // local time conversion is the expensive part, every thread redoes it only when the second changes
+        thread_local detail::TimestampCache cache;
+        return cache.Format(now);
     }
 
     auto Logger::GetInstance() noexcept -> Logger& {
@@ -30,17 +81,377 @@ namespace ai {
     auto Logger::SetOutputStream(std::ostream* stream) noexcept -> void {
         const std::lock_guard<std::mutex> lock(m_mutex);
         m_outputStream = stream;
+        ++m_streamGeneration;
     }
 
     auto Logger::SetBuferization(bool buferization) noexcept -> void {
         m_buferization = buferization;
     }
 
-    auto Logger::BuildPrefix(Level level, std::source_location location) -> std::string {
+    Logger::~Logger() {
+        DisableAsync();
+    }
+
+    auto Logger::EnableAsync(const AsyncLoggingOptions& options) -> void {
+        DisableAsync();
+        m_recordFormat = options.recordFormat;
+        m_binaryRecords = options.recordFormat != RecordFormat::TEXT;
+        if (!m_binaryRecords) {
+            m_ring = std::make_unique<RingBuffer<Record>>(options.capacity);
+            m_popped = 0;
+        }
+        m_stagingBufferSize = options.stagingBufferSize;
+        m_epoch.fetch_add(1, std::memory_order_relaxed);
+        m_overflowPolicy = options.overflowPolicy;
+        m_flushInterval = options.flushInterval;
+        if (options.clock == ClockSource::TSC) {
+            m_tscClock.emplace();
+        }
+        m_reportedDropped = m_dropped.load(std::memory_order_relaxed);
+        {
+            const std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_streamGeneration;
+        }
+        m_stopWriter = false;
+        m_writer = std::thread([this]() { RunWriter(); });
+    }
+
+    auto Logger::DisableAsync() -> void {
+        if (!m_writer.joinable()) {
+            return;
+        }
+        {
+            const std::lock_guard<std::mutex> lock(m_writerMutex);
+            m_stopWriter = true;
+        }
+        m_writerWakeup.notify_one();
+        m_writer.join();
+        m_ring.reset();
+        m_tscClock.reset();
+        m_binaryRecords = false;
+        const std::lock_guard<std::mutex> lock(m_stagingMutex);
+        m_stagingBuffers.clear();
+    }
+
+    auto Logger::Flush() -> void {
+        if (!m_writer.joinable()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_writerMutex);
+        // a pass started after this call writes everything logged before it
+        const uint64_t target = m_passesStarted + 1;
+        m_flushRequested = true;
+        m_writerWakeup.notify_one();
+        m_passCompleted.wait(lock, [&]() { return m_passesCompleted >= target; });
+    }
+
+    auto Logger::Push(const CallSite& site, std::chrono::system_clock::time_point time, std::string& message) -> void {
+        // swapping can't throw, unlike a copy into the cell
+        auto fill = [&](Record& record) noexcept {
+            record.site = &site;
+            record.time = time;
+            record.message.swap(message);
+        };
+        while (!m_ring->TryPush(fill)) {
+            if (m_overflowPolicy != OverflowPolicy::BLOCK) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            m_writerWakeup.notify_one();
+            std::this_thread::yield();
+        }
+    }
+
+    auto Logger::RegisterCallSite(Level level, std::source_location location, std::string_view format) -> CallSite& {
+        const std::lock_guard<std::mutex> lock(m_callSitesMutex);
+        CallSite& site = m_callSites.emplace_back();
+        site.id = static_cast<uint32_t>(m_callSites.size() - 1);
+        site.level = level;
+        site.line = location.line();
+        site.file = location.file_name();
+        site.function = location.function_name();
+        site.format = format;
+        RenderPrefix(site);
+        return site;
+    }
+
+    auto Logger::ReserveStagingBuffer(size_t bytes) -> detail::StagingBuffer* {
+        StagingBufferSlot& slot = stagingBufferSlot;
+        const uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+        if (slot.epoch != epoch) {
+            slot.buffer = std::make_shared<detail::StagingBuffer>(m_stagingBufferSize);
+            slot.epoch = epoch;
+            const std::lock_guard<std::mutex> lock(m_stagingMutex);
+            m_stagingBuffers.push_back(slot.buffer);
+        }
+        detail::StagingBuffer& buffer = *slot.buffer;
+        while (!buffer.HasRoom(bytes)) {
+            if (m_overflowPolicy != OverflowPolicy::BLOCK || bytes > buffer.Capacity()) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            m_writerWakeup.notify_one();
+            std::this_thread::yield();
+        }
+        return &buffer;
+    }
+
+    auto Logger::RunWriter() -> void {
+        auto lastResync = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(m_writerMutex);
+        while (true) {
+            const bool stop = m_stopWriter;
+            const uint64_t pass = ++m_passesStarted;
+            m_flushRequested = false;
+            lock.unlock();
+            if (m_tscClock && std::chrono::steady_clock::now() - lastResync >= detail::TscClock::RESYNC_INTERVAL) {
+                m_tscClock->Resync();
+                lastResync = std::chrono::steady_clock::now();
+            }
+            if (m_binaryRecords) {
+                WriteBinaryRecords();
+            } else {
+                WriteTextRecords();
+            }
+            lock.lock();
+            m_passesCompleted = pass;
+            m_passCompleted.notify_all();
+            if (stop) {
+                return;
+            }
+            m_writerWakeup.wait_for(lock, m_flushInterval, [this]() { return m_stopWriter || m_flushRequested; });
+        }
+    }
+
+    auto Logger::WriteTextRecords() -> void {
+        const uint64_t target = m_ring->PushedCount();
+        ReportDropped();
+        while (m_popped < target) {
+            size_t count = 0;
+            while (count < MAX_BATCH_SIZE && m_ring->TryPop([this](Record& record) {
+                AppendPrefix(m_batch, *record.site, record.time);
+                m_batch += record.message;
+                m_batch += '\n';
+            })) {
+                ++count;
+            }
+            if (count == 0) {
+                // a logging thread is still filling the next cell
+                std::this_thread::yield();
+                continue;
+            }
+            m_popped += count;
+            WriteBatch();
+        }
+        WriteBatch();
+    }
+
+    auto Logger::WriteBinaryRecords() -> void {
+        std::vector<std::shared_ptr<detail::StagingBuffer>> buffers;
+        {
+            const std::lock_guard<std::mutex> lock(m_stagingMutex);
+            std::erase_if(m_stagingBuffers, [](const auto& buffer) {
+                return buffer->retired.load(std::memory_order_acquire) && buffer->Consumed() == buffer->Committed();
+            });
+            buffers = m_stagingBuffers;
+        }
+        ReportDropped();
+        size_t count = 0;
+        for (const auto& buffer : buffers) {
+            size_t position = buffer->Consumed();
+            const size_t end = buffer->Committed();
+            while (position < end) {
+                detail::RecordHeader header{};
+                buffer->Read(position, &header, sizeof(header));
+                m_record.resize(header.size - sizeof(header));
+                buffer->Read(position + sizeof(header), m_record.data(), m_record.size());
+                position += header.size;
+                AppendBinaryRecord(header, m_record.data());
+                if (++count % MAX_BATCH_SIZE == 0) {
+                    buffer->Release(position);
+                    WriteBatch();
+                }
+            }
+            buffer->Release(position);
+        }
+        WriteBatch();
+    }
+
+    auto Logger::AppendBinaryRecord(const detail::RecordHeader& header, const std::byte* arguments) -> void {
+        const CallSite& site = GetCallSite(header.callSite);
+        const size_t size = header.size - sizeof(header);
+        if (m_recordFormat == RecordFormat::BINARY) {
+            if (m_callSitesInStream.size() <= header.callSite) {
+                m_callSitesInStream.resize(header.callSite + 1, false);
+            }
+            if (!m_callSitesInStream[header.callSite]) {
+                AppendCallSite(m_batch, site);
+                m_callSitesInStream[header.callSite] = true;
+            }
+            m_batch += RECORD_TAG;
+            AppendBytes(m_batch, &header, sizeof(header));
+            AppendBytes(m_batch, arguments, size);
+            return;
+        }
+        AppendPrefix(m_batch, site, ToTimePoint(header.time));
+        m_batch += FormatRecord(site, arguments, size);
+        m_batch += '\n';
+    }
+
+    auto Logger::ReportDropped() -> void {
+        static CallSite& droppedSite =
+            RegisterCallSite(Level::WARNING, std::source_location::current(), "{} messages were dropped, the buffer is full");
+        std::call_once(droppedSite.typesRegistered, []() { droppedSite.types = detail::TypeTags<uint64_t>(); });
+        const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (m_overflowPolicy != OverflowPolicy::COUNT || dropped == m_reportedDropped) {
+            return;
+        }
+        const uint64_t count = dropped - m_reportedDropped;
+        m_reportedDropped = dropped;
+
+        const auto now = Now();
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+        const detail::RecordHeader header{
+            .size = sizeof(detail::RecordHeader) + sizeof(count), .callSite = droppedSite.id, .time = nanoseconds};
+        AppendBinaryRecord(header, reinterpret_cast<const std::byte*>(&count));
+    }
+
+    auto Logger::WriteBatch() -> void {
+        if (m_batch.empty()) {
+            return;
+        }
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_outputStream) {
+            if (m_recordFormat == RecordFormat::BINARY && m_writerStreamGeneration != m_streamGeneration) {
+                // a new stream starts with the header and the call sites written to the previous one
+                std::string header;
+                AppendFileHeader(header);
+                for (size_t id = 0; id < m_callSitesInStream.size(); ++id) {
+                    if (m_callSitesInStream[id]) {
+                        AppendCallSite(header, *m_writerCallSites[id]);
+                    }
+                }
+                (*m_outputStream) << header;
+                m_writerStreamGeneration = m_streamGeneration;
+            }
+            (*m_outputStream) << m_batch;
+            if (m_buferization) {
+                (*m_outputStream) << std::flush;
+            }
+        }
+        m_batch.clear();
+    }
+
+    auto Logger::GetCallSite(uint32_t id) -> const CallSite& {
+        if (id >= m_writerCallSites.size()) {
+            const std::lock_guard<std::mutex> lock(m_callSitesMutex);
+            for (size_t i = m_writerCallSites.size(); i < m_callSites.size(); ++i) {
+                m_writerCallSites.push_back(&m_callSites[i]);
+            }
+        }
+        return *m_writerCallSites.at(id);
+    }
+
+    auto Logger::AppendCallSite(std::string& output, const CallSite& site) -> void {
+        const auto level = static_cast<uint8_t>(site.level);
+        const auto line = static_cast<uint32_t>(site.line);
+        output += CALL_SITE_TAG;
+        AppendBytes(output, &site.id, sizeof(site.id));
+        AppendBytes(output, &level, sizeof(level));
+        AppendBytes(output, &line, sizeof(line));
+        AppendString(output, site.file);
+        AppendString(output, site.function);
+        AppendString(output, site.preformatted ? "{}" : site.format);
+        AppendString(output, site.types);
+    }
+
+    auto Logger::FormatRecord(const CallSite& site, const std::byte* arguments, size_t size) -> std::string {
+        try {
+            return detail::FormatBinaryArguments(site.preformatted ? "{}" : site.format, site.types, arguments, size);
+        } catch (const std::exception& error) {
+            return std::string("[format error: ") + error.what() + "] " + site.format;
+        }
+    }
+
+    auto Logger::DecodeBinaryLog(std::istream& input, std::ostream& output) -> size_t {
+        auto read = [&input](void* data, size_t bytes) {
+            if (!input.read(static_cast<char*>(data), static_cast<std::streamsize>(bytes))) {
+                throw std::runtime_error("DecodeBinaryLog: the binary log is truncated");
+            }
+        };
+        auto readString = [&read]() {
+            uint32_t length = 0;
+            read(&length, sizeof(length));
+            std::string value(length, '\0');
+            read(value.data(), length);
+            return value;
+        };
+
+        std::map<uint32_t, CallSite> callSites;
+        std::vector<std::byte> arguments;
+        size_t count = 0;
+        bool first = true;
+        for (char tag = 0; input.get(tag); first = false) {
+            if (tag == FILE_MAGIC[0]) {
+                // the header is repeated if logging to the same stream was restarted
+                std::string magic(FILE_MAGIC.size(), '\0');
+                magic[0] = tag;
+                read(magic.data() + 1, magic.size() - 1);
+                uint32_t version = 0;
+                read(&version, sizeof(version));
+                if (magic != FILE_MAGIC || version != FILE_VERSION) {
+                    throw std::runtime_error("DecodeBinaryLog: unsupported binary log version");
+                }
+            } else if (first) {
+                throw std::runtime_error("DecodeBinaryLog: the stream is not a binary log");
+            } else if (tag == CALL_SITE_TAG) {
+                uint32_t id = 0;
+                uint8_t level = 0;
+                uint32_t line = 0;
+                read(&id, sizeof(id));
+                read(&level, sizeof(level));
+                read(&line, sizeof(line));
+                CallSite& site = callSites[id];
+                site.id = id;
+                site.level = static_cast<Level>(level);
+                site.line = line;
+                site.file = readString();
+                site.function = readString();
+                site.format = readString();
+                site.types = readString();
+                RenderPrefix(site);
+            } else if (tag == RECORD_TAG) {
+                detail::RecordHeader header{};
+                read(&header, sizeof(header));
+                const auto found = callSites.find(header.callSite);
+                if (found == callSites.end() || header.size < sizeof(header)) {
+                    throw std::runtime_error("DecodeBinaryLog: record of an unknown call site");
+                }
+                arguments.resize(header.size - sizeof(header));
+                read(arguments.data(), arguments.size());
+                const CallSite& site = found->second;
+                std::string line;
+                AppendPrefix(line, site, ToTimePoint(header.time));
+                output << line << FormatRecord(site, arguments.data(), arguments.size()) << '\n';
+                ++count;
+            } else {
+                throw std::runtime_error("DecodeBinaryLog: corrupted binary log");
+            }
+        }
+        return count;
+    }
+
+    auto Logger::RenderPrefix(CallSite& site) -> void {
         std::ostringstream oss;
-        oss << "[" << LevelToString(level) << "]\t" << "[" << GetCurrentTime() << "]\t" << "[" << location.function_name() << ", "
-            << location.file_name() << ":" << location.line() << "]\t";
-        return oss.str();
+        oss << "]\t" << "[" << site.function << ", " << site.file << ":" << site.line << "]\t";
+        site.levelPrefix = "[" + LevelToString(site.level) + "]\t[";
+        site.locationSuffix = oss.str();
+    }
+
+    auto Logger::AppendPrefix(std::string& output, const CallSite& site, std::chrono::system_clock::time_point time) -> void {
+        output += site.levelPrefix;
+        output += FormatTime(time);
+        output += site.locationSuffix;
     }
 
     auto Logger::LevelToString(Level level) noexcept -> std::string {
@@ -1,20 +1,91 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <format>
 #include <iomanip>
 #include <iostream>
+#include <istream>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <source_location>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "BinaryLog.hpp"
+#include "Clock.hpp"
+#include "RingBuffer.hpp"
 
 namespace ai {
 
+    /// What an asynchronous Logger does with a message when its ring buffer is full.
+    enum class OverflowPolicy {
+        /// The logging thread waits until the writer thread frees a cell.
+        BLOCK,
+        /// The message is discarded.
+        DROP,
+        /// The message is discarded and the writer thread logs how many messages were lost.
+        COUNT
+    };
+
+    /**
+    @brief How an asynchronous Logger passes messages to the writer thread.
+
+    TEXT pays for formatting on the logging thread, the binary formats only copy the arguments. Both allocate until
+    every cell of the ring or of the staging buffer has been used once, benchmarks/LatencyBenchmark.cpp measures the
+    steady state after that.
+
+    TEXT is the MPSC ring path: its call latency is dominated by the formatting and it is not held to a latency target.
+    It is kept for arguments that must be formatted at the call site.
+    */
+    enum class RecordFormat {
+        /// Messages are formatted on the logging thread.
+        TEXT,
+        /**
+        Binary records with the raw arguments are formatted by the writer thread. Held to a p99 below 100 ns per call when
+        the writer thread has a core of its own, checked by the logger_latency_benchmark test.
+        */
+        DEFERRED,
+        /// Binary records are written to the output stream as they are, see Logger::DecodeBinaryLog.
+        BINARY
+    };
+
+    /// Clock an asynchronous Logger stamps messages with.
+    enum class ClockSource {
+        /// std::chrono::system_clock.
+        SYSTEM,
+        /// The time stamp counter calibrated against system_clock, see detail::TscClock. EnableAsync calibrates it for 10 ms,
+        /// the writer thread re-anchors it to system_clock every second.
+        TSC
+    };
+
+    struct AsyncLoggingOptions {
+        /// Number of messages in flight, rounded up to a power of two.
+        size_t capacity{size_t{1} << 14};
+        OverflowPolicy overflowPolicy{OverflowPolicy::BLOCK};
+        RecordFormat recordFormat{RecordFormat::TEXT};
+        /// Size of the per-thread buffers of binary records in bytes, rounded up to a power of two.
+        size_t stagingBufferSize{size_t{1} << 20};
+        /// How long the writer thread sleeps when the ring buffer is empty.
+        std::chrono::milliseconds flushInterval{1};
+        ClockSource clock{ClockSource::SYSTEM};
+    };
+
     /**
     @brief Static class for logging.
 
     Based on the singleton pattern, thread safety.
     The default stream is std::cout.
-    It uses std::vformat for formating.
+    It uses std::format for formating, format strings are checked at compile time.
     For custom classes logging you need to implement specialization of std::formatter for your class.
 
     Setting output stream:
@@ -43,15 +114,79 @@ namespace ai {
         // [INFO]	[18:06:52.588]	[file.cpp, int main(), 23]	Let me log pi=  3.141593, str hi, e=2.72 and my class [42, 42] here!
 
         \endcode
+
+    Asynchronous mode: the logging thread only formats the message and pushes it with its level, location and time into
+    a lock-free ring buffer. A writer thread renders the prefixes and writes the messages in batches, so logging threads
+    don't serialize on the stream.
+    \code
+        Logger::GetInstance().EnableAsync({.overflowPolicy = OverflowPolicy::COUNT});
+        ...
+        Logger::GetInstance().Flush();  // waits until the messages logged so far are written
+    \endcode
+    EnableAsync and DisableAsync must not be called while other threads are logging.
+
+    Binary records (RecordFormat::DEFERRED and RecordFormat::BINARY): the logging thread doesn't format at all, it copies
+    the id of the call site, the time and the raw arguments into a buffer of its own. The format string, location and
+    argument types are registered once per call site. Arithmetic and string arguments are copied, arguments of other
+    types are formatted on the logging thread. The writer thread either formats the records or writes them to the output
+    stream for offline decoding:
+    \code
+        std::ofstream file("log.bin", std::ios::binary);
+        Logger::GetInstance().SetOutputStream(&file);
+        Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::BINARY});
+        ...
+        // later, e.g. with the log_decoder tool
+        Logger::DecodeBinaryLog(input, std::cout);
+    \endcode
+    Messages of one thread keep their order, messages of different threads are ordered per batch.
+
+    Levels are filtered twice: messages below LOG_MIN_LEVEL (DEBUG by default, e.g. -DLOG_MIN_LEVEL=INFO) are removed
+    at compile time, messages below SetMinimumLevel are skipped at run time with a relaxed atomic load. In both cases the
+    arguments are not evaluated:
+    \code
+        Logger::SetMinimumLevel(Logger::Level::WARNING);
+        LOG_DEBUG("loss {}", ComputeLoss());  // ComputeLoss is not called
+    \endcode
+
+    Every LOG_* statement registers its CallSite once, the level, location and format string are not passed again and
+    the parts of the prefix that don't change are rendered on registration. The time is converted to local time once per
+    second and thread, only the milliseconds are rendered per message. Asynchronous loggers can stamp messages with the
+    time stamp counter instead of calling the system clock:
+    \code
+        Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::DEFERRED, .clock = ClockSource::TSC});
+    \endcode
     */
     class Logger {
      public:
-        /// Log level.
+        /// Log level, in increasing severity.
         enum class Level {
+            DEBUG,
             INFO,
             WARNING,
-            ERROR,
-            DEBUG
+            ERROR
+        };
+
+        /**
+        @brief Static metadata of a logging call site, registered once by the LOG_* macros and owned by the Logger.
+
+        Binary records refer to it by its id.
+        */
+        struct CallSite {
+            uint32_t id{0};
+            Level level{};
+            uint_least32_t line{0};
+            std::string file;
+            std::string function;
+            std::string format;
+            /// Prefix up to the time, "[LEVEL]\t[".
+            std::string levelPrefix;
+            /// Prefix after the time, "]\t[function, file:line]\t".
+            std::string locationSuffix;
+            /// Type tags of the arguments of binary records, see detail::ArgumentCodec. Set on the first binary record.
+            std::string types;
+            /// Whether binary records hold the message formatted on the logging thread instead of the arguments.
+            bool preformatted{false};
+            std::once_flag typesRegistered;
         };
 
         static auto GetInstance() noexcept -> Logger&;
@@ -62,16 +197,63 @@ namespace ai {
         /// Sets the buferization flag.
         auto SetBuferization(bool buferization) noexcept -> void;
 
-        /// Logging with variadic arguments
+        /// Messages below `level` are skipped by the LOG_* macros before their arguments are evaluated.
+        static auto SetMinimumLevel(Level level) noexcept -> void { s_minimumLevel.store(level, std::memory_order_relaxed); }
+
+        [[nodiscard]] static auto GetMinimumLevel() noexcept -> Level { return s_minimumLevel.load(std::memory_order_relaxed); }
+
+        /// Whether messages of `level` are logged, checked by the LOG_* macros.
+        [[nodiscard]] static auto IsEnabled(Level level) noexcept -> bool {
+            return level >= s_minimumLevel.load(std::memory_order_relaxed);
+        }
+
+        /// Starts the writer thread, messages are written by it from now on.
+        auto EnableAsync(const AsyncLoggingOptions& options = {}) -> void;
+
+        /// Writes the pending messages, stops the writer thread and returns to synchronous logging.
+        auto DisableAsync() -> void;
+
+        /// Waits until the messages logged so far are written. Does nothing in synchronous mode.
+        auto Flush() -> void;
+
+        /// Number of messages discarded because the ring buffer was full.
+        [[nodiscard]] auto GetDroppedCount() const noexcept -> uint64_t { return m_dropped.load(std::memory_order_relaxed); }
+
+        /**
+        @brief Decodes a stream written with RecordFormat::BINARY into text lines, as they would have been logged.
+
+        Returns the number of messages. Throws std::runtime_error if the stream is not a binary log or is corrupted.
+        */
+        static auto DecodeBinaryLog(std::istream& input, std::ostream& output) -> size_t;
+
+        /// Registers a call site, the returned metadata lives as long as the Logger. Used by the LOG_* macros.
+        auto RegisterCallSite(Level level, std::source_location location, std::string_view format) -> CallSite&;
+
+        /// Logging with variadic arguments, `format` must be the format string `site` was registered with.
         template <typename... Args>
-        auto Log(Level level, std::source_location location, const std::string& message, Args&&... args) -> void {
+        auto Log(CallSite& site, std::format_string<Args...> format, Args&&... args) -> void {
+            if (m_binaryRecords) {
+                LogBinary(site, format, std::forward<Args>(args)...);
+                return;
+            }
+            if (m_ring) {
+                const auto time = Now();
+                // exchanged with the string of a ring cell by Push, see there
+                thread_local std::string buffer;
+                buffer.clear();
+                std::format_to(std::back_inserter(buffer), format, std::forward<Args>(args)...);
+                Push(site, time, buffer);
+                return;
+            }
+
             std::lock_guard<std::mutex> lock(m_mutex);
 
             if (!m_outputStream) {
                 return;
             }
-            std::string prefix = BuildPrefix(level, location);
-            std::string formattedMessage = std::vformat(prefix + message, std::make_format_args(args...));
+            std::string formattedMessage;
+            AppendPrefix(formattedMessage, site, std::chrono::system_clock::now());
+            std::format_to(std::back_inserter(formattedMessage), format, std::forward<Args>(args)...);
             (*m_outputStream) << formattedMessage << "\n";
             if (m_buferization) {
                 (*m_outputStream) << std::flush;
@@ -79,33 +261,179 @@ namespace ai {
         }
 
      private:
+        /// Static, so the check in the LOG_* macros doesn't go through GetInstance.
+        static inline std::atomic<Level> s_minimumLevel{Level::DEBUG};
+
+        /// Message waiting for the writer thread.
+        struct Record {
+            const CallSite* site{nullptr};
+            std::chrono::system_clock::time_point time;
+            std::string message;
+        };
+
         std::ostream* m_outputStream = &std::cout;
         std::mutex m_mutex;
         bool m_buferization{false};
 
+        std::unique_ptr<RingBuffer<Record>> m_ring;
+        uint64_t m_popped{0};
+        OverflowPolicy m_overflowPolicy{OverflowPolicy::BLOCK};
+        RecordFormat m_recordFormat{RecordFormat::TEXT};
+        bool m_binaryRecords{false};
+        std::chrono::milliseconds m_flushInterval{1};
+        /// Set under ClockSource::TSC.
+        std::optional<detail::TscClock> m_tscClock;
+        std::atomic<uint64_t> m_dropped{0};
+        uint64_t m_reportedDropped{0};
+        /// Batch rendered by the writer thread, reused across batches.
+        std::string m_batch;
+        std::thread m_writer;
+        std::mutex m_writerMutex;
+        std::condition_variable m_writerWakeup;
+        std::condition_variable m_passCompleted;
+        uint64_t m_passesStarted{0};
+        uint64_t m_passesCompleted{0};
+        bool m_flushRequested{false};
+        bool m_stopWriter{false};
+
+        std::mutex m_callSitesMutex;
+        std::deque<CallSite> m_callSites;
+        /// Call sites known to the writer thread, looked up without locking.
+        std::vector<const CallSite*> m_writerCallSites;
+        /// Which call sites the writer thread has written to the output stream in RecordFormat::BINARY.
+        std::vector<bool> m_callSitesInStream;
+        /// Incremented when the output stream changes, guarded by m_mutex.
+        uint64_t m_streamGeneration{0};
+        /// Generation of the stream the writer thread has written the binary header to.
+        uint64_t m_writerStreamGeneration{0};
+        std::mutex m_stagingMutex;
+        std::vector<std::shared_ptr<detail::StagingBuffer>> m_stagingBuffers;
+        size_t m_stagingBufferSize{0};
+        /// Incremented by EnableAsync, threads replace staging buffers of an earlier epoch.
+        std::atomic<uint64_t> m_epoch{0};
+        /// Arguments of the binary record being processed by the writer thread.
+        std::vector<std::byte> m_record;
+
         Logger() = default;
-        ~Logger() = default;
+        ~Logger();
 
         Logger(const Logger&) = delete;
         Logger& operator=(const Logger&) = delete;
 
-        static auto BuildPrefix(Level level, std::source_location location) -> std::string;
+        /// Time stamp of an asynchronous message.
+        [[nodiscard]] auto Now() const noexcept -> std::chrono::system_clock::time_point {
+            return m_tscClock ? m_tscClock->Now() : std::chrono::system_clock::now();
+        }
+
+        /**
+        @brief Moves a formatted message into the ring buffer, handling overflow according to the policy.
+
+        `message` is swapped with the string of the cell, so it receives the buffer of an earlier message. The buffers
+        circulate between the cells and the logging threads, and once every cell has held a message the steady state
+        doesn't allocate.
+        */
+        auto Push(const CallSite& site, std::chrono::system_clock::time_point time, std::string& message) -> void;
+
+        template <typename... Args>
+        auto LogBinary(CallSite& site, std::format_string<Args...> format, Args&&... args) -> void {
+            const auto time = Now();
+            if constexpr ((detail::Encodable<std::remove_cvref_t<Args>> && ...)) {
+                std::call_once(site.typesRegistered, [&site]() { site.types = detail::TypeTags<Args...>(); });
+                PushBinary(site.id, time, args...);
+            } else {
+                // arguments without a binary encoding are formatted here and the message is stored as text
+                std::call_once(site.typesRegistered, [&site]() {
+                    site.types = detail::TypeTags<std::string_view>();
+                    site.preformatted = true;
+                });
+                thread_local std::string buffer;
+                buffer.clear();
+                std::format_to(std::back_inserter(buffer), format, std::forward<Args>(args)...);
+                PushBinary(site.id, time, std::string_view(buffer));
+            }
+        }
+
+        /// Copies a binary record into the staging buffer of the calling thread.
+        template <typename... Args>
+        auto PushBinary(uint32_t callSite, std::chrono::system_clock::time_point time, const Args&... args) -> void {
+            const size_t argumentsSize = (size_t{0} + ... + detail::ArgumentCodec<std::remove_cvref_t<Args>>::Size(args));
+            const size_t size = sizeof(detail::RecordHeader) + argumentsSize;
+            detail::StagingBuffer* buffer = ReserveStagingBuffer(size);
+            if (buffer == nullptr) {
+                return;
+            }
+            const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+            const detail::RecordHeader header{.size = static_cast<uint32_t>(size), .callSite = callSite, .time = nanoseconds};
+            buffer->Write(&header, sizeof(header));
+            (detail::ArgumentCodec<std::remove_cvref_t<Args>>::Encode(*buffer, args), ...);
+            buffer->Commit();
+        }
+
+        /// Staging buffer of the calling thread with room for `bytes`, or nullptr if the record is dropped.
+        auto ReserveStagingBuffer(size_t bytes) -> detail::StagingBuffer*;
+
+        auto RunWriter() -> void;
+
+        /// Writes the messages pushed to the ring buffer so far.
+        auto WriteTextRecords() -> void;
+
+        /// Writes the binary records committed to the staging buffers so far.
+        auto WriteBinaryRecords() -> void;
+
+        /// Formats a binary record, or copies it in RecordFormat::BINARY, into the batch.
+        auto AppendBinaryRecord(const detail::RecordHeader& header, const std::byte* arguments) -> void;
+
+        /// Adds a message about dropped messages to the batch under OverflowPolicy::COUNT.
+        auto ReportDropped() -> void;
+
+        /// Writes the batch to the output stream.
+        auto WriteBatch() -> void;
+
+        /// Call site of a binary record, as seen by the writer thread.
+        auto GetCallSite(uint32_t id) -> const CallSite&;
+
+        /// Appends the description of a call site for the decoder in RecordFormat::BINARY.
+        static auto AppendCallSite(std::string& output, const CallSite& site) -> void;
+
+        /// Formats the arguments of a binary record, a format error is reported in the message.
+        static auto FormatRecord(const CallSite& site, const std::byte* arguments, size_t size) -> std::string;
+
+        /// Renders the parts of the prefix that don't change between calls.
+        static auto RenderPrefix(CallSite& site) -> void;
+
+        /// Appends "[LEVEL]\t[HH:MM:SS.mmm]\t[function, file:line]\t".
+        static auto AppendPrefix(std::string& output, const CallSite& site, std::chrono::system_clock::time_point time) -> void;
 
         static auto LevelToString(Level level) noexcept -> std::string;
 
-        /// Returns the current time in string format HH:MM:SS.mmm
-        static auto GetCurrentTime() -> std::string;
+        /// Returns the time in string format HH:MM:SS.mmm, valid until the next call on the same thread.
+        static auto FormatTime(std::chrono::system_clock::time_point time) -> std::string_view;
     };
 
 }  // namespace ai
 
+/// Minimum level compiled in, one of DEBUG, INFO, WARNING and ERROR.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG
+#endif
+
 #ifdef USE_ANDROID_LOGGING
 #include <android/log.h>
 #define LOG_TAG PROJECT_NAME
-#define LOG_INFO(fmt, ...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "%s", std::format(fmt, __VA_ARGS__).c_str())
-#define LOG_WARNING(fmt, ...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "%s", std::format(fmt, __VA_ARGS__).c_str())
-#define LOG_DEBUG(fmt, ...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "%s", std::format(fmt, __VA_ARGS__).c_str())
-#define LOG_ERROR(fmt, ...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "%s", std::format(fmt, __VA_ARGS__).c_str())
+/// Passes the message to `__android_log_print`, levels are filtered as by LOG_MESSAGE.
+#define LOG_ANDROID_MESSAGE(level, priority, fmt, ...)                                                             \
+    do {                                                                                                           \
+        if constexpr ((level) >= ai::Logger::Level::LOG_MIN_LEVEL) {                                               \
+            if (ai::Logger::IsEnabled(level)) {                                                                    \
+                const std::string message = std::format(fmt __VA_OPT__(, ) __VA_ARGS__);                           \
+                __android_log_print(priority, LOG_TAG, "%s", message.c_str());                                     \
+            }                                                                                                      \
+        }                                                                                                          \
+    } while (false)
+#define LOG_INFO(fmt, ...) LOG_ANDROID_MESSAGE(ai::Logger::Level::INFO, ANDROID_LOG_INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_WARNING(fmt, ...) LOG_ANDROID_MESSAGE(ai::Logger::Level::WARNING, ANDROID_LOG_WARN, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_ANDROID_MESSAGE(ai::Logger::Level::DEBUG, ANDROID_LOG_DEBUG, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_ERROR(fmt, ...) LOG_ANDROID_MESSAGE(ai::Logger::Level::ERROR, ANDROID_LOG_ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
 #else
 /*!
  * @def LOG_INFO(fmt, ...)
@@ -124,11 +452,33 @@ namespace ai {
  * - `LOG_DEBUG` — отладочные сообщения.
  * - `LOG_ERROR` — сообщения об ошибках.
  *
- * @param fmt Форматная строка (аналог `printf`).
+ * Сообщения уровня ниже `LOG_MIN_LEVEL` удаляются при компиляции, ниже `Logger::SetMinimumLevel` — пропускаются
+ * во время выполнения. В обоих случаях аргументы не вычисляются.
+ *
+ * @param fmt Форматная строка (аналог `printf`), проверяется на этапе компиляции.
  * @param ... Аргументы для подстановки в форматную строку.
  */
-#define LOG_INFO(...) ai::Logger::GetInstance().Log(ai::Logger::Level::INFO, std::source_location::current(), __VA_ARGS__)
-#define LOG_WARNING(...) ai::Logger::GetInstance().Log(ai::Logger::Level::WARNING, std::source_location::current(), __VA_ARGS__)
-#define LOG_ERROR(...) ai::Logger::GetInstance().Log(ai::Logger::Level::ERROR, std::source_location::current(), __VA_ARGS__)
-#define LOG_DEBUG(...) ai::Logger::GetInstance().Log(ai::Logger::Level::DEBUG, std::source_location::current(), __VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG_MESSAGE(ai::Logger::Level::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_WARNING(fmt, ...) LOG_MESSAGE(ai::Logger::Level::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_ERROR(fmt, ...) LOG_MESSAGE(ai::Logger::Level::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_MESSAGE(ai::Logger::Level::DEBUG, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+/**
+ * Registers the call site on its first execution and logs with its metadata, the location is the one of the caller.
+ * Disabled levels are discarded statements: they are still compiled, but generate no code.
+ */
+#define LOG_MESSAGE(level, fmt, ...)                                                                               \
+    do {                                                                                                           \
+        if constexpr ((level) >= ai::Logger::Level::LOG_MIN_LEVEL) {                                               \
+            if (ai::Logger::IsEnabled(level)) {                                                                    \
+                ai::Logger::GetInstance().Log(                                                                     \
+                    [](std::source_location location = std::source_location::current()) -> ai::Logger::CallSite& { \
+                        static ai::Logger::CallSite& site =                                                        \
+                            ai::Logger::GetInstance().RegisterCallSite(level, location, fmt);                      \
+                        return site;                                                                               \
+                    }(),                                                                                           \
+                    fmt __VA_OPT__(, ) __VA_ARGS__);                                                               \
+            }                                                                                                      \
+        }                                                                                                          \
+    } while (false)
 #endif
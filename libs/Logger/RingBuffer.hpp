@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace ai {
+
+    /**
+    @brief Bounded lock-free multi-producer single-consumer ring buffer.
+
+    Based on the bounded queue of Dmitry Vyukov: every cell has a sequence number telling whether it is free for the
+    producer of a given position or published for the consumer. A producer claims a position with one CAS, fills the
+    cell in place and publishes it with a release store, so producers never wait for each other or for the consumer.
+
+    Elements are filled and consumed in place and never destroyed until the ring is, so elements owning memory (e.g.
+    std::string) keep their capacity and the steady state doesn't allocate.
+    */
+    template <typename T>
+    class RingBuffer {
+     public:
+        /// @param capacity Number of cells, rounded up to a power of two.
+        explicit RingBuffer(size_t capacity) : m_mask(RoundUpToPowerOfTwo(capacity) - 1), m_cells(new Cell[m_mask + 1]) {
+            for (size_t i = 0; i <= m_mask; ++i) {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+
+        [[nodiscard]] auto Capacity() const noexcept -> size_t { return m_mask + 1; }
+
+        /// Number of elements pushed so far.
+        [[nodiscard]] auto PushedCount() const noexcept -> uint64_t { return m_enqueuePosition.load(std::memory_order_acquire); }
+
+        /**
+        @brief Claims a free cell and calls `fill(T&)` on it. Safe to call from any thread.
+
+        `fill` must not throw. Returns false without calling `fill` if the ring is full.
+        */
+        template <typename Fill>
+        auto TryPush(Fill&& fill) noexcept -> bool {
+            size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+            Cell* cell = nullptr;
+            while (true) {
+                cell = &m_cells[position & m_mask];
+                const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0) {
+                    if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = m_enqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+            fill(cell->value);
+            cell->sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+        @brief Calls `consume(T&)` on the oldest published element and frees its cell. Only one thread may pop.
+
+        Returns false if there is no published element.
+        */
+        template <typename Consume>
+        auto TryPop(Consume&& consume) -> bool {
+            Cell& cell = m_cells[m_dequeuePosition & m_mask];
+            if (cell.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1) {
+                return false;
+            }
+            consume(cell.value);
+            cell.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+            ++m_dequeuePosition;
+            return true;
+        }
+
+     private:
+        static constexpr size_t CACHE_LINE_SIZE = 64;
+
+        struct alignas(CACHE_LINE_SIZE) Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        static auto RoundUpToPowerOfTwo(size_t capacity) -> size_t {
+            if (capacity == 0) {
+                throw std::invalid_argument("RingBuffer: capacity must be positive");
+            }
+            size_t result = 1;
+            while (result < capacity) {
+                result <<= 1;
+            }
+            return result;
+        }
+
+        const size_t m_mask;
+        std::unique_ptr<Cell[]> m_cells;
+        // producers and the consumer update their positions on separate cache lines
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_enqueuePosition{0};
+        alignas(CACHE_LINE_SIZE) size_t m_dequeuePosition{0};
+    };
+
+}  // namespace ai
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Logger.hpp"
+
+using ai::Logger;
+using ai::RecordFormat;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+    constexpr size_t NUM_CALLS = 100000;
+    constexpr size_t RING_CAPACITY = size_t{1} << 20;
+    // the string of a ring cell keeps its capacity, so only calls after the first lap of the ring show the steady state
+    constexpr size_t NUM_WARMUP_CALLS = RING_CAPACITY;
+    constexpr double PERCENTILES[] = {0.5, 0.9, 0.99, 0.999};
+    /// Acceptance target of DEFERRED, TEXT formats on the logging thread and isn't held to it.
+    constexpr double P99_TARGET_NS = 100;
+    /// The logging threads of the largest series and the writer thread each need a core of their own.
+    constexpr size_t REQUIRED_CORES = 5;
+    /// Exit code ctest reports as a skipped test, see SKIP_RETURN_CODE in CMakeLists.txt.
+    constexpr int SKIPPED = 77;
+
+    /// Latency of single `log(i, t)` calls on each of `numThreads` threads, sorted, in nanoseconds.
+    template <typename Log>
+    auto MeasureLatencies(size_t numThreads, const Log& log) -> std::vector<double> {
+        std::vector<std::vector<double>> latencies(numThreads);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; ++t) {
+            threads.emplace_back([t, numThreads, &latencies, &log]() {
+                for (size_t i = 0; i < NUM_WARMUP_CALLS / numThreads; ++i) {
+                    log(i, t);
+                }
+                Logger::GetInstance().Flush();
+                latencies[t].reserve(NUM_CALLS);
+                for (size_t i = 0; i < NUM_CALLS; ++i) {
+                    const auto start = Clock::now();
+                    log(i, t);
+                    const auto stop = Clock::now();
+                    latencies[t].push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        std::vector<double> all;
+        for (const auto& threadLatencies : latencies) {
+            all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+        }
+        std::sort(all.begin(), all.end());
+        return all;
+    }
+
+    /// Cost of the two clock reads around a call, subtracted from the measurements.
+    auto MeasureTimerOverhead() -> double {
+        std::vector<double> overheads(NUM_CALLS);
+        for (auto& overhead : overheads) {
+            const auto start = Clock::now();
+            const auto stop = Clock::now();
+            overhead = std::chrono::duration<double, std::nano>(stop - start).count();
+        }
+        std::nth_element(overheads.begin(), overheads.begin() + NUM_CALLS / 2, overheads.end());
+        return overheads[NUM_CALLS / 2];
+    }
+
+}  // namespace
+
+/**
+ * Reports percentiles of the LOG_INFO call latency in the asynchronous modes, the messages are written to /dev/null.
+ * Exits with 1 if the p99 of a DEFERRED series is above `P99_TARGET_NS`, and with `SKIPPED` on a machine with fewer than
+ * `REQUIRED_CORES` cores, where the target can't be checked.
+ */
+auto main() -> int {
+    std::ofstream sink("/dev/null");
+    Logger::GetInstance().SetOutputStream(&sink);
+
+    const double overhead = MeasureTimerOverhead();
+    std::cout << "timer overhead " << overhead << " ns, subtracted\n";
+    auto percentile = [overhead](const std::vector<double>& latencies, double fraction) {
+        const auto index = static_cast<size_t>(fraction * static_cast<double>(latencies.size() - 1));
+        return std::max(0.0, latencies[index] - overhead);
+    };
+    double worstDeferredP99 = 0;
+    auto report = [&](const std::string& name, RecordFormat format, size_t numThreads, const std::vector<double>& latencies) {
+        std::cout << name << ", " << numThreads << " thread(s):";
+        for (const double fraction : PERCENTILES) {
+            std::cout << " p" << fraction * 100 << "=" << percentile(latencies, fraction) << "ns";
+        }
+        std::cout << "\n";
+        if (format == RecordFormat::DEFERRED) {
+            worstDeferredP99 = std::max(worstDeferredP99, percentile(latencies, 0.99));
+        }
+        Logger::GetInstance().Flush();
+    };
+    for (const auto& [formatName, format] : {std::pair{"text", RecordFormat::TEXT}, std::pair{"deferred", RecordFormat::DEFERRED}}) {
+        Logger::GetInstance().EnableAsync({.capacity = RING_CAPACITY, .recordFormat = format, .stagingBufferSize = size_t{1} << 26});
+        for (const size_t numThreads : {size_t{1}, size_t{4}}) {
+            report(std::string(formatName) + " constant message", format, numThreads,
+                   MeasureLatencies(numThreads, [](size_t, size_t) { LOG_INFO("constant message"); }));
+            report(std::string(formatName) + " formatted message", format, numThreads,
+                   MeasureLatencies(numThreads, [](size_t i, size_t t) {
+                       LOG_INFO("iteration {} of thread {}, value {:.3f}", i, t, static_cast<double>(i) * 0.5);
+                   }));
+        }
+    }
+
+    Logger::GetInstance().DisableAsync();
+    Logger::GetInstance().SetOutputStream(&std::cout);
+
+    std::cout << "deferred p99 " << worstDeferredP99 << " ns, target " << P99_TARGET_NS << " ns\n";
+    if (std::thread::hardware_concurrency() < REQUIRED_CORES) {
+        // the writer thread takes CPU time from the logging threads, which shows up in the tail latency
+        std::cout << "fewer than " << REQUIRED_CORES << " cores, the target is not checked\n";
+        return SKIPPED;
+    }
+    return worstDeferredP99 <= P99_TARGET_NS ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+// Levels below LOG_MIN_LEVEL are removed at compile time, whatever the build defines.
+#undef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL WARNING
+
+#include <gmock/gmock-matchers.h>
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <sstream>
+
+#include "Logger.hpp"
+
+using ai::Logger;
+
+TEST(CompileTimeLevelTests, LevelsBelowMinimumAreCompiledOut) {
+    std::ostringstream output;
+    Logger::GetInstance().SetOutputStream(&output);
+    int evaluations = 0;
+    auto count = [&evaluations] { return ++evaluations; };
+    LOG_DEBUG("compiled out {}", count());
+    LOG_INFO("compiled out {}", count());
+    LOG_WARNING("compiled in {}", count());
+    EXPECT_EQ(evaluations, 1);
+    EXPECT_THAT(output.str(), ::testing::Not(::testing::HasSubstr("compiled out")));
+    EXPECT_THAT(output.str(), ::testing::HasSubstr("compiled in 1"));
+    Logger::GetInstance().SetOutputStream(&std::cout);
+}
@@ -1,9 +1,28 @@
+// The tests count messages of every level, whatever LOG_MIN_LEVEL the build defines.
+#undef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG
+
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <source_location>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Clock.hpp"
 #include "Logger.hpp"
+#include "RingBuffer.hpp"
 
+using ai::ClockSource;
 using ai::Logger;
+using ai::OverflowPolicy;
+using ai::RecordFormat;
 
 const float pi = 3.14f;
 
@@ -11,7 +30,10 @@ class LoggerTests : public testing::Test {
  protected:
     void SetUp() override { Logger::GetInstance().SetOutputStream(&m_output); }
 
-    void TearDown() override { m_output.clear(); }
+    void TearDown() override {
+        Logger::SetMinimumLevel(Logger::Level::DEBUG);
+        m_output.clear();
+    }
 
     auto GetOutput() -> std::string { return m_output.str(); }
 
@@ -46,11 +68,275 @@ TEST_F(LoggerTests, LogFloatingPoints) {
     EXPECT_THAT(GetOutput(), ::testing::HasSubstr("   3.14000,3.140"));
 }
 
-TEST_F(LoggerTests, ToManyBracketsIsNotOK) {
-    EXPECT_THROW(LOG_INFO("{} {}", "hello"), std::format_error);
+// Too many brackets are rejected at compile time, see ToManyBrackets.cpp and the logger_too_many_brackets test.
+
+TEST_F(LoggerTests, PrefixHasLevelAndLocation) {
+    const auto location = std::source_location::current();
+    LOG_ERROR("located");
+    const std::string line = std::to_string(location.line() + 1);
+    const std::string expected = std::string(location.function_name()) + ", " + location.file_name() + ":" + line;
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("[ERROR]\t["));
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("]\t[" + expected + "]\tlocated"));
+}
+
+TEST_F(LoggerTests, CallSiteIsRegisteredOnce) {
+    std::vector<const Logger::CallSite*> sites;
+    for (int i = 0; i < 3; ++i) {
+        sites.push_back(&Logger::GetInstance().RegisterCallSite(Logger::Level::INFO, std::source_location::current(), "{}"));
+    }
+    EXPECT_NE(sites[0], sites[1]);
+    EXPECT_EQ(sites[0]->format, "{}");
+    EXPECT_EQ(sites[1]->id, sites[0]->id + 1);
+    for (int i = 0; i < 3; ++i) {
+        LOG_INFO("iteration {}", i);
+    }
+    const Logger::CallSite& next = Logger::GetInstance().RegisterCallSite(Logger::Level::INFO, std::source_location::current(), "{}");
+    EXPECT_EQ(next.id, sites[2]->id + 2);
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("iteration 2"));
 }
 
 TEST_F(LoggerTests, ToManyArgsIsOK) {
     LOG_INFO("{}", "hello", "world");
     EXPECT_THAT(GetOutput(), ::testing::HasSubstr("hello"));
 }
+
+TEST_F(LoggerTests, MinimumLevelSkipsMessagesWithoutEvaluatingArguments) {
+    int evaluations = 0;
+    auto count = [&evaluations] { return ++evaluations; };
+    Logger::SetMinimumLevel(Logger::Level::WARNING);
+    EXPECT_FALSE(Logger::IsEnabled(Logger::Level::INFO));
+    LOG_INFO("skipped {}", count());
+    LOG_ERROR("written {}", count());
+    EXPECT_EQ(evaluations, 1);
+    EXPECT_THAT(GetOutput(), ::testing::Not(::testing::HasSubstr("skipped")));
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("written 1"));
+}
+
+class AsyncLoggerTests : public testing::Test {
+ protected:
+    void SetUp() override { Logger::GetInstance().SetOutputStream(&m_output); }
+
+    void TearDown() override {
+        Logger::GetInstance().DisableAsync();
+        Logger::GetInstance().SetOutputStream(&std::cout);
+    }
+
+    auto GetOutput() -> std::string { return m_output.str(); }
+
+    auto CountLines(const std::string& text) -> size_t {
+        const std::string output = GetOutput();
+        size_t count = 0;
+        for (size_t position = output.find(text); position != std::string::npos; position = output.find(text, position + 1)) {
+            ++count;
+        }
+        return count;
+    }
+
+ private:
+    std::ostringstream m_output;
+};
+
+TEST(RingBufferTests, PopsInPushOrderAndReportsFull) {
+    ai::RingBuffer<int> ring(3);
+    EXPECT_EQ(ring.Capacity(), 4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.TryPush([i](int& value) noexcept { value = i; }));
+    }
+    EXPECT_FALSE(ring.TryPush([](int& value) noexcept { value = -1; }));
+    for (int i = 0; i < 4; ++i) {
+        int popped = -1;
+        EXPECT_TRUE(ring.TryPop([&popped](int& value) { popped = value; }));
+        EXPECT_EQ(popped, i);
+    }
+    EXPECT_FALSE(ring.TryPop([](int&) {}));
+    EXPECT_EQ(ring.PushedCount(), 4);
+}
+
+TEST_F(AsyncLoggerTests, FlushWritesMessages) {
+    Logger::GetInstance().EnableAsync();
+    LOG_WARNING("Hello, {}!", "world");
+    Logger::GetInstance().Flush();
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("Hello, world!"));
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("WARNING"));
+}
+
+TEST_F(AsyncLoggerTests, DisableAsyncWritesPendingMessages) {
+    Logger::GetInstance().EnableAsync({.flushInterval = std::chrono::hours(1)});
+    LOG_INFO("pending message");
+    Logger::GetInstance().DisableAsync();
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("pending message"));
+}
+
+TEST_F(AsyncLoggerTests, KeepsOrderOfOneThread) {
+    Logger::GetInstance().EnableAsync({.capacity = 16});
+    for (int i = 0; i < 1000; ++i) {
+        LOG_INFO("message #{}#", i);
+    }
+    Logger::GetInstance().Flush();
+    const std::string output = GetOutput();
+    size_t previous = 0;
+    for (int i = 0; i < 1000; ++i) {
+        const size_t position = output.find("message #" + std::to_string(i) + "#");
+        ASSERT_NE(position, std::string::npos);
+        EXPECT_GE(position, previous);
+        previous = position;
+    }
+}
+
+TEST_F(AsyncLoggerTests, BlockPolicyWritesMessagesOfAllThreads) {
+    Logger::GetInstance().EnableAsync({.capacity = 64, .overflowPolicy = OverflowPolicy::BLOCK});
+    const uint64_t droppedBefore = Logger::GetInstance().GetDroppedCount();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 500; ++i) {
+                LOG_DEBUG("thread {} message {}", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Logger::GetInstance().Flush();
+    EXPECT_EQ(CountLines("DEBUG"), 8 * 500);
+    EXPECT_EQ(Logger::GetInstance().GetDroppedCount(), droppedBefore);
+}
+
+TEST_F(AsyncLoggerTests, CountPolicyReportsDroppedMessages) {
+    Logger::GetInstance().EnableAsync({.capacity = 4, .overflowPolicy = OverflowPolicy::COUNT, .flushInterval = std::chrono::hours(1)});
+    const uint64_t droppedBefore = Logger::GetInstance().GetDroppedCount();
+    for (int i = 0; i < 1000; ++i) {
+        LOG_ERROR("message {}", i);
+    }
+    Logger::GetInstance().Flush();
+    const uint64_t dropped = Logger::GetInstance().GetDroppedCount() - droppedBefore;
+    EXPECT_GT(dropped, 0);
+    EXPECT_EQ(CountLines("[ERROR]") + dropped, 1000);
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("messages were dropped"));
+}
+
+TEST_F(AsyncLoggerTests, DeferredFormattingFormatsOnWriterThread) {
+    Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::DEFERRED});
+    const std::string name = "world";
+    LOG_INFO("Hello, {}! {},{:5},{:*<5},{:*>5},{:*^6}", name, 42, 42U, int64_t{42}, short{42}, uint8_t{42});
+    LOG_INFO("{:10.5f},{:.3f},{:{}.{}f} {} {} {{}}", pi, 3.14, 2.718, 6, 2, true, 'x');
+    LOG_WARNING("{1} {0}", std::string_view("first"), "second");
+    Logger::GetInstance().Flush();
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("Hello, world! 42,   42,42***,***42,**42**"));
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("   3.14000,3.140,  2.72 true x {}"));
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("second first"));
+}
+
+TEST_F(AsyncLoggerTests, DeferredFormattingFormatsOtherTypesOnLoggingThread) {
+    Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::DEFERRED});
+    const void* pointer = nullptr;
+    LOG_INFO("pointer {} and {}", pointer, 1);
+    Logger::GetInstance().Flush();
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("pointer 0x0 and 1"));
+}
+
+TEST_F(AsyncLoggerTests, DeferredFormattingWritesMessagesOfExitedThreads) {
+    Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::DEFERRED, .stagingBufferSize = 1024});
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 500; ++i) {
+                LOG_DEBUG("thread {} message {}", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Logger::GetInstance().Flush();
+    EXPECT_EQ(CountLines("DEBUG"), 4 * 500);
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("thread 3 message 499"));
+}
+
+TEST_F(AsyncLoggerTests, BinaryLogIsDecodedOffline) {
+    Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::BINARY});
+    LOG_ERROR("value {:.2f} of {}", 0.125, "binary");
+    for (int i = 0; i < 300; ++i) {
+        LOG_INFO("message {}", i);
+    }
+    Logger::GetInstance().DisableAsync();
+    const std::string binary = GetOutput();
+    EXPECT_THAT(binary, ::testing::StartsWith("AILOGBIN"));
+    EXPECT_THAT(binary, ::testing::Not(::testing::HasSubstr("value 0.12 of binary")));
+
+    std::istringstream input(binary);
+    std::ostringstream decoded;
+    EXPECT_EQ(Logger::DecodeBinaryLog(input, decoded), 301);
+    EXPECT_THAT(decoded.str(), ::testing::HasSubstr("[ERROR]"));
+    EXPECT_THAT(decoded.str(), ::testing::HasSubstr("value 0.12 of binary"));
+    EXPECT_THAT(decoded.str(), ::testing::HasSubstr("message 299"));
+}
+
+TEST_F(AsyncLoggerTests, DecodingReportsRecordsNotMatchingTheirCallSite) {
+    Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::BINARY});
+    LOG_INFO("pair {} and {}", 1, 2);
+    Logger::GetInstance().DisableAsync();
+    std::string binary = GetOutput();
+
+    // every copy of the call site now declares a single argument, so the second field of the format has none
+    const std::string format = "pair {} and {}";
+    for (size_t position = binary.find(format); position != std::string::npos; position = binary.find(format, position + 1)) {
+        const size_t types = position + format.size();
+        ASSERT_EQ(binary.compare(types, 6, std::string("\x02\0\0\0ii", 6)), 0);
+        binary.replace(types, 6, std::string("\x01\0\0\0i", 5));
+    }
+
+    std::istringstream input(binary);
+    std::ostringstream decoded;
+    EXPECT_EQ(Logger::DecodeBinaryLog(input, decoded), 1);
+    EXPECT_THAT(decoded.str(), ::testing::HasSubstr("[format error: "));
+    EXPECT_THAT(decoded.str(), ::testing::HasSubstr("] pair {} and {}"));
+}
+
+TEST_F(AsyncLoggerTests, TscClockStampsMessages) {
+    Logger::GetInstance().EnableAsync({.recordFormat = RecordFormat::DEFERRED, .clock = ClockSource::TSC});
+    LOG_INFO("stamped {}", 1);
+    Logger::GetInstance().Flush();
+    EXPECT_THAT(GetOutput(), ::testing::ContainsRegex("\\[[0-9][0-9]:[0-9][0-9]:[0-9][0-9]\\.[0-9][0-9][0-9]\\]"));
+    EXPECT_THAT(GetOutput(), ::testing::HasSubstr("stamped 1"));
+}
+
+TEST(ClockTests, TimestampCacheMatchesLocalTime) {
+    using namespace std::chrono_literals;
+    ai::detail::TimestampCache cache;
+    const auto start = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+    for (const auto offset : {0ms, 7ms, 999ms, 1000ms, 1042ms, 61'500ms, 3'600'001ms, 7ms}) {
+        const auto time = start + offset;
+        const std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+        const auto milliseconds = std::chrono::floor<std::chrono::milliseconds>(time).time_since_epoch().count() % 1000;
+        std::ostringstream expected;
+        // NOLINTNEXTLINE(concurrency-mt-unsafe)
+        expected << std::put_time(std::localtime(&seconds), "%H:%M:%S") << '.' << std::setfill('0') << std::setw(3) << milliseconds;
+        EXPECT_EQ(cache.Format(time), expected.str());
+    }
+}
+
+TEST(ClockTests, TscClockFollowsSystemClock) {
+    const ai::detail::TscClock clock(std::chrono::milliseconds(5));
+    EXPECT_EQ(clock.UsesTsc(), ai::detail::TscClock::HasInvariantTsc());
+    const auto first = clock.Now();
+    const auto second = clock.Now();
+    EXPECT_LE(first, second);
+    const auto difference = std::chrono::abs(clock.Now() - std::chrono::system_clock::now());
+    EXPECT_LT(difference, std::chrono::milliseconds(50));
+}
+
+TEST(ClockTests, TscClockResyncsToSystemClock) {
+    // a short calibration has a large rate error, Resync removes the offset it has accumulated
+    ai::detail::TscClock clock(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    clock.Resync();
+    const auto difference = std::chrono::abs(clock.Now() - std::chrono::system_clock::now());
+    EXPECT_LT(difference, std::chrono::milliseconds(5));
+}
+
+TEST(BinaryLogTests, DecodingRejectsOtherStreams) {
+    std::istringstream input("[INFO] text log");
+    std::ostringstream output;
+    EXPECT_THROW(Logger::DecodeBinaryLog(input, output), std::runtime_error);
+}
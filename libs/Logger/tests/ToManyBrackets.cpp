@@ -0,0 +1,7 @@
+#include "Logger.hpp"
+
+// Must not compile: the format string has more replacement fields than arguments.
+auto main() -> int {
+    LOG_INFO("{} {}", "hello");
+    return 0;
+}
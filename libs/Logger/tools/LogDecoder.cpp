@@ -0,0 +1,25 @@
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+#include "Logger.hpp"
+
+/// Prints a log written with ai::RecordFormat::BINARY as text: log_decoder <binary log>
+auto main(int argc, char* argv[]) -> int {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <binary log>\n";
+        return 1;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input) {
+        std::cerr << "can't open " << argv[1] << '\n';
+        return 1;
+    }
+    try {
+        ai::Logger::DecodeBinaryLog(input, std::cout);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}